@@ -0,0 +1,152 @@
+// Compares the fused Spo2Window<100, 500> kernel with maxim_heart_rate_and_oxygen_saturation
+// on synthetic windows: checks that both give identical results and times them.
+//
+//   ./build-host/algo_bench [--repeat N]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "sensor_spo2_algorithm.h"
+#include "sensor_spo2_window.h"
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr uint32_t kSampleRate = FS;
+    constexpr uint32_t kLength = BUFFER_SIZE;
+
+    using Fused = Spo2Window<kSampleRate, kLength>;
+
+    struct Window
+    {
+        std::vector<uint32_t> ir;
+        std::vector<uint32_t> red;
+    };
+
+    struct Result
+    {
+        int32_t spo2;
+        int8_t spo2Valid;
+        int32_t heartRate;
+        int8_t heartRateValid;
+
+        bool operator==(const Result &other) const
+        {
+            return spo2 == other.spo2 && spo2Valid == other.spo2Valid &&
+                   heartRate == other.heartRate && heartRateValid == other.heartRateValid;
+        }
+    };
+
+    std::vector<Window> makeWindows()
+    {
+        std::vector<Window> windows;
+        for (double bpm = 40.0; bpm < 190.0; bpm += 5.0)
+        {
+            for (uint32_t level = 0; level < 4; level++)
+            {
+                uint32_t seed = 0x9E3779B9U * (level + 1U) + static_cast<uint32_t>(bpm);
+                double ratio = 0.4 + 0.1 * level;
+                Window window;
+                for (uint32_t n = 0; n < kLength; n++)
+                {
+                    seed = seed * 1664525U + 1013904223U;
+                    double noise = ((seed >> 8) / 16777216.0 - 0.5) * 40.0 * level;
+                    double t = static_cast<double>(n) / kSampleRate;
+                    double phase = 2 * kPi * t * bpm / 60.0;
+                    double pulse = 0.6 * sin(phase) + 0.25 * sin(2 * phase) + 0.1 * sin(3 * phase);
+                    double wander = 1.0 + 0.002 * level * sin(2 * kPi * 0.2 * t);
+                    window.ir.push_back(static_cast<uint32_t>(120000.0 * wander * (1.0 - 0.01 * pulse) + noise));
+                    window.red.push_back(static_cast<uint32_t>(100000.0 * wander * (1.0 - 0.01 * ratio * pulse) + noise));
+                }
+                windows.push_back(std::move(window));
+            }
+        }
+        return windows;
+    }
+
+    Result runOriginal(maxim_spo2_context_t &context, Window &window)
+    {
+        Result r{};
+        maxim_heart_rate_and_oxygen_saturation_r(&context, window.ir.data(), kLength, window.red.data(),
+                                                  &r.spo2, &r.spo2Valid, &r.heartRate, &r.heartRateValid);
+        return r;
+    }
+
+    Result runFused(Spo2WindowContext<kLength> &context, Window &window)
+    {
+        Result r{};
+        Fused::calculate(context, window.ir.data(), window.red.data(),
+                         &r.spo2, &r.spo2Valid, &r.heartRate, &r.heartRateValid);
+        return r;
+    }
+
+    template <typename Run>
+    double nsPerWindow(std::vector<Window> &windows, unsigned repeat, Run run)
+    {
+        volatile int32_t sink = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (unsigned r = 0; r < repeat; r++)
+        {
+            for (Window &window : windows)
+            {
+                sink = sink + run(window).heartRate;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - begin).count() / (repeat * windows.size());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned repeat = 50;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = static_cast<unsigned>(atoi(argv[++i]));
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--repeat N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Window> windows = makeWindows();
+    auto original = std::make_unique<maxim_spo2_context_t>();
+    auto fused = std::make_unique<Spo2WindowContext<kLength>>();
+
+    unsigned mismatches = 0;
+    for (Window &window : windows)
+    {
+        Result a = runOriginal(*original, window);
+        Result b = runFused(*fused, window);
+        if (!(a == b))
+        {
+            mismatches++;
+            printf("mismatch: original hr %ld/%d spo2 %ld/%d, fused hr %ld/%d spo2 %ld/%d\n",
+                   (long)a.heartRate, a.heartRateValid, (long)a.spo2, a.spo2Valid,
+                   (long)b.heartRate, b.heartRateValid, (long)b.spo2, b.spo2Valid);
+        }
+    }
+
+    double originalNs = nsPerWindow(windows, repeat, [&original](Window &w)
+                                    { return runOriginal(*original, w); });
+    double fusedNs = nsPerWindow(windows, repeat, [&fused](Window &w)
+                                 { return runFused(*fused, w); });
+
+    printf("%zu windows of %lu samples at %lu Hz, mismatches: %u\n",
+           windows.size(), (unsigned long)kLength, (unsigned long)kSampleRate, mismatches);
+    printf("%-10s %12s %12s %14s\n", "kernel", "ns/window", "ns/sample", "scratch bytes");
+    printf("%-10s %12.0f %12.2f %14zu\n", "original", originalNs, originalNs / kLength, sizeof(maxim_spo2_context_t));
+    printf("%-10s %12.0f %12.2f %14zu\n", "fused", fusedNs, fusedNs / kLength, sizeof(Spo2WindowContext<kLength>));
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+// Drives the connection table (ble_connections.h) together with the subscription table
+// from a fake GAP event source: centrals connect while advertising runs, exchange MTUs,
+// update parameters, subscribe and leave, the way bleprph_gap_event sees it. Checks that
+// advertising runs exactly while a slot is free, that MTU and parameters are kept per
+// connection, and that one packet packed for the smallest MTU goes to every subscriber.
+// A long random event sequence checks the same invariants.
+//
+//   ./build-host/ble_connection_check
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ble_connections.h"
+#include "ble_subscriptions.h"
+
+namespace
+{
+    // value handles NimBLE assigns to heartrate and the raw stream
+    constexpr uint16_t kHeartrate = 12U;
+    constexpr uint16_t kRaw = 24U;
+
+    unsigned failures = 0;
+
+    void expect(bool condition, const char *what)
+    {
+        if (!condition)
+        {
+            printf("FAIL: %s\n", what);
+            failures++;
+        }
+    }
+
+    // bleprph_gap_event and gatt_svr_* with the NimBLE calls replaced by counters
+    struct FakeGap
+    {
+        ble_conn_table conns;
+        ble_sub_table subs;
+        bool advertising = false;
+        size_t encodes = 0;
+        std::vector<uint16_t> sent;
+
+        FakeGap()
+        {
+            ble_conn_init(&conns);
+            ble_sub_init(&subs);
+            advertiseIfFree();
+        }
+
+        void advertiseIfFree()
+        {
+            if (ble_conn_slot_free(&conns) && !advertising)
+            {
+                advertising = true;
+            }
+        }
+
+        // BLE_GAP_EVENT_CONNECT, only possible while advertising, which it stops
+        bool connect(uint16_t conn, uint16_t itvl = 24U)
+        {
+            if (!advertising)
+            {
+                return false;
+            }
+            advertising = false;
+            expect(ble_conn_on_connect(&conns, conn, itvl, 0U, 400U) == 0, "the controller never exceeds the table");
+            advertiseIfFree();
+            return true;
+        }
+
+        void disconnect(uint16_t conn)
+        {
+            ble_sub_on_disconnect(&subs, conn);
+            ble_conn_on_disconnect(&conns, conn);
+            advertiseIfFree();
+        }
+
+        // what main.cpp does with a raw chunk: pack once for the smallest MTU, send to all
+        uint16_t publishRaw()
+        {
+            uint16_t peers[BLE_SUB_MAX_CONNECTIONS];
+            size_t count = ble_sub_peers(&subs, kRaw, peers, BLE_SUB_MAX_CONNECTIONS);
+            uint16_t mtu = ble_conn_min_mtu(&conns, peers, count);
+            if (mtu == 0)
+            {
+                return 0;
+            }
+            encodes++;
+            ble_sub_target targets[BLE_SUB_MAX_CONNECTIONS];
+            count = ble_sub_collect(&subs, kRaw, targets, BLE_SUB_MAX_CONNECTIONS);
+            for (size_t i = 0; i < count; i++)
+            {
+                sent.push_back(targets[i].conn_handle);
+            }
+            return mtu;
+        }
+    };
+
+    void checkAdvertising()
+    {
+        FakeGap gap;
+        expect(gap.advertising, "advertising starts with every slot free");
+
+        // bedside display and gateway
+        expect(gap.connect(1) && gap.advertising, "advertising resumes after the first central");
+        expect(gap.connect(2), "a second central can connect");
+        for (uint16_t conn = 3; conn <= BLE_CONN_MAX; conn++)
+        {
+            gap.connect(conn);
+        }
+        expect(ble_conn_count(&gap.conns) == BLE_CONN_MAX, "every slot is taken");
+        expect(!gap.advertising, "advertising stays off with every slot taken");
+        expect(!gap.connect(99), "no central gets in while not advertising");
+
+        gap.disconnect(2);
+        expect(gap.advertising, "a central leaving frees a slot and advertising resumes");
+        expect(ble_conn_find(&gap.conns, 2) == nullptr, "the closed connection is forgotten");
+        expect(gap.connect(7) && ble_conn_find(&gap.conns, 7) != nullptr, "the free slot is reused");
+    }
+
+    void checkPerConnection()
+    {
+        FakeGap gap;
+        gap.connect(1, 24U);
+        gap.connect(2, 6U);
+        expect(ble_conn_find(&gap.conns, 1)->mtu == BLE_CONN_DEFAULT_MTU, "MTU is 23 until the exchange");
+
+        ble_conn_on_mtu(&gap.conns, 2, 247U);
+        ble_conn_on_update(&gap.conns, 1, 80U, 4U, 600U);
+        const ble_conn_entry *display = ble_conn_find(&gap.conns, 1);
+        const ble_conn_entry *gateway = ble_conn_find(&gap.conns, 2);
+        expect(display->mtu == BLE_CONN_DEFAULT_MTU && gateway->mtu == 247U, "MTU is kept per connection");
+        expect(display->itvl == 80U && display->latency == 4U && display->supervision_timeout == 600U,
+               "updated parameters are kept");
+        expect(gateway->itvl == 6U && gateway->latency == 0U, "other connections keep their parameters");
+
+        // a reused handle starts over
+        gap.disconnect(2);
+        gap.connect(2);
+        expect(ble_conn_find(&gap.conns, 2)->mtu == BLE_CONN_DEFAULT_MTU, "a reused handle inherits no MTU");
+        ble_conn_on_mtu(&gap.conns, 42, 100U);
+        expect(ble_conn_find(&gap.conns, 42) == nullptr, "events of unknown handles are ignored");
+    }
+
+    void checkFanOut()
+    {
+        FakeGap gap;
+        gap.connect(1);
+        gap.connect(2);
+        gap.connect(3);
+        ble_conn_on_mtu(&gap.conns, 1, 185U);
+        ble_conn_on_mtu(&gap.conns, 2, 247U);
+        ble_conn_on_mtu(&gap.conns, 3, 256U);
+
+        expect(gap.publishRaw() == 0 && gap.encodes == 0U, "nothing is packed without subscribers");
+
+        ble_sub_on_subscribe(&gap.subs, 2, kRaw, true, false);
+        ble_sub_on_subscribe(&gap.subs, 3, kRaw, true, false);
+        ble_sub_on_subscribe(&gap.subs, 1, kHeartrate, true, false);
+        expect(gap.publishRaw() == 247U, "packets fit the smallest MTU of the raw subscribers");
+
+        ble_sub_on_subscribe(&gap.subs, 1, kRaw, true, false);
+        gap.sent.clear();
+        gap.encodes = 0;
+        expect(gap.publishRaw() == 185U, "a new subscriber with a smaller MTU shrinks the packets");
+        expect(gap.encodes == 1U && gap.sent.size() == 3U, "packed once, sent to every subscriber");
+
+        gap.disconnect(1);
+        expect(gap.publishRaw() == 247U, "the packets grow again when it leaves");
+    }
+
+    // random connects, MTU exchanges, subscriptions and disconnects
+    void checkRandom()
+    {
+        FakeGap gap;
+        uint32_t seed = 0x2468ACE1U;
+        auto next = [&seed]()
+        {
+            seed = seed * 1664525U + 1013904223U;
+            return seed >> 16;
+        };
+
+        std::vector<std::pair<uint16_t, uint16_t>> open;
+        uint16_t nextHandle = 0;
+        size_t events = 0;
+        size_t maxOpen = 0;
+        for (; events < 100000U; events++)
+        {
+            switch (next() % 4U)
+            {
+            case 0:
+                if (gap.connect(nextHandle))
+                {
+                    open.emplace_back(nextHandle, BLE_CONN_DEFAULT_MTU);
+                }
+                nextHandle = static_cast<uint16_t>((nextHandle + 1U) % 64U);
+                break;
+            case 1:
+                if (!open.empty())
+                {
+                    size_t i = next() % open.size();
+                    gap.disconnect(open[i].first);
+                    open.erase(open.begin() + static_cast<long>(i));
+                }
+                break;
+            case 2:
+                if (!open.empty())
+                {
+                    auto &conn = open[next() % open.size()];
+                    conn.second = static_cast<uint16_t>(23U + next() % 490U);
+                    ble_conn_on_mtu(&gap.conns, conn.first, conn.second);
+                }
+                break;
+            default:
+                if (!open.empty())
+                {
+                    uint16_t conn = open[next() % open.size()].first;
+                    ble_sub_on_subscribe(&gap.subs, conn, kRaw, (next() & 1U) != 0, false);
+                }
+                break;
+            }
+
+            maxOpen = std::max(maxOpen, open.size());
+            bool ok = ble_conn_count(&gap.conns) == open.size() && open.size() <= BLE_CONN_MAX;
+            ok &= gap.advertising == (open.size() < BLE_CONN_MAX);
+
+            uint16_t peers[BLE_SUB_MAX_CONNECTIONS];
+            size_t count = ble_sub_peers(&gap.subs, kRaw, peers, BLE_SUB_MAX_CONNECTIONS);
+            uint16_t expected = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                auto it = std::find_if(open.begin(), open.end(), [&](const auto &c) { return c.first == peers[i]; });
+                ok &= it != open.end();
+                if (it != open.end() && (expected == 0 || it->second < expected))
+                {
+                    expected = it->second;
+                }
+            }
+            ok &= ble_conn_min_mtu(&gap.conns, peers, count) == expected;
+            if (!ok)
+            {
+                expect(false, "random event sequence keeps the tables consistent");
+                break;
+            }
+        }
+        printf("%zu random GAP events, up to %zu of %d centrals connected at once\n", events, maxOpen, BLE_CONN_MAX);
+    }
+}
+
+int main()
+{
+    checkAdvertising();
+    checkPerConnection();
+    checkFanOut();
+    checkRandom();
+    printf("%s\n", failures == 0 ? "all connection checks passed" : "connection checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
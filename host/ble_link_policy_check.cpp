@@ -0,0 +1,219 @@
+// Drives the link policy (ble_link_policy.h) with sensor runs, raw stream subscriptions and
+// the CONN_UPDATE answers of a fake central, on a simulated millisecond clock. Checks that
+// streaming connections get the short interval, data length and 2M PHY at once, that idle
+// ones fall back to the long interval only after the hold time, that one request is in
+// flight per connection and that a refused mode is not asked for again. Reports the
+// connection events per second each mode costs the radio.
+//
+//   ./build-host/ble_link_policy_check
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "ble_link_policy.h"
+
+namespace
+{
+    unsigned failures = 0;
+
+    void expect(bool condition, const char *what)
+    {
+        if (!condition)
+        {
+            printf("FAIL: %s\n", what);
+            failures++;
+        }
+    }
+
+    // what bleprph_apply_link_action would have asked the central for
+    struct FakeCentral
+    {
+        ble_link_policy policy;
+        uint32_t now = 0;
+        std::vector<ble_link_action> actions;
+
+        explicit FakeCentral(bool phy2m = true)
+        {
+            ble_link_init(&policy, phy2m);
+        }
+
+        // main loop iterations until ms later
+        size_t run(uint32_t ms, bool running)
+        {
+            size_t before = actions.size();
+            for (uint32_t t = 0; t < ms; t += 10U)
+            {
+                ble_link_set_sensor_running(&policy, running);
+                ble_link_action out[BLE_CONN_MAX];
+                size_t count = ble_link_poll(&policy, now, out, BLE_CONN_MAX);
+                actions.insert(actions.end(), out, out + count);
+                now += 10U;
+            }
+            return actions.size() - before;
+        }
+
+        // the central answers the last parameter request
+        void answer(uint16_t conn, bool accept)
+        {
+            const ble_link_action *last = nullptr;
+            for (const ble_link_action &a : actions)
+            {
+                if (a.conn_handle == conn && (a.flags & BLE_LINK_ACTION_PARAMS))
+                {
+                    last = &a;
+                }
+            }
+            uint16_t itvl = (last != nullptr) ? last->params.itvl_max : 0U;
+            uint16_t latency = (last != nullptr) ? last->params.latency : 0U;
+            ble_link_on_conn_update(&policy, conn, accept ? 0 : 1, itvl, latency);
+        }
+
+        size_t requests(uint16_t conn, uint8_t flag, uint16_t itvlMax = 0) const
+        {
+            size_t count = 0;
+            for (const ble_link_action &a : actions)
+            {
+                count += (a.conn_handle == conn && (a.flags & flag) &&
+                          (itvlMax == 0 || a.params.itvl_max == itvlMax))
+                             ? 1U
+                             : 0U;
+            }
+            return count;
+        }
+    };
+
+    const uint16_t kFast = ble_link_params_for(BLE_LINK_MODE_STREAMING).itvl_max;
+    const uint16_t kSlow = ble_link_params_for(BLE_LINK_MODE_IDLE).itvl_max;
+
+    void checkIdleAfterConnect()
+    {
+        FakeCentral central;
+        ble_link_on_connect(&central.policy, 1, central.now);
+        expect(central.run(BLE_LINK_IDLE_HOLD_MS - 100U, false) == 0U,
+               "the central keeps its parameters for the discovery after connecting");
+        central.run(200U, false);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kSlow) == 1U, "idle interval after the hold time");
+        expect(central.requests(1, BLE_LINK_ACTION_PHY_2M | BLE_LINK_ACTION_DATA_LEN) == 0U,
+               "no PHY or data length while idle");
+        expect(central.run(1000U, false) == 0U, "nothing more while the request is in flight");
+        central.answer(1, true);
+        expect(central.run(10000U, false) == 0U, "nothing more once idle");
+    }
+
+    void checkRunAndStop()
+    {
+        FakeCentral central;
+        ble_link_on_connect(&central.policy, 1, central.now);
+        central.run(20U, true);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kFast) == 1U, "a sensor run asks for the short interval at once");
+        expect(central.requests(1, BLE_LINK_ACTION_PHY_2M) == 1U && central.requests(1, BLE_LINK_ACTION_DATA_LEN) == 1U,
+               "2M PHY and data length with it");
+        central.answer(1, true);
+        central.run(3000U, true);
+
+        // a stop and a quick restart leave the link alone
+        central.run(2000U, false);
+        central.run(1000U, true);
+        central.run(BLE_LINK_IDLE_HOLD_MS - 100U, false);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS) == 1U, "no flapping inside the hold time");
+
+        central.run(200U, false);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kSlow) == 1U, "idle once the sensor stays stopped");
+        central.answer(1, true);
+        central.run(20U, true);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kFast) == 2U, "the next run streams again");
+        expect(central.requests(1, BLE_LINK_ACTION_PHY_2M | BLE_LINK_ACTION_DATA_LEN) == 1U,
+               "PHY and data length are asked for once per connection");
+    }
+
+    void checkInFlight()
+    {
+        FakeCentral central;
+        ble_link_on_connect(&central.policy, 1, central.now);
+        central.run(BLE_LINK_IDLE_HOLD_MS + 100U, false);
+        // the run starts while the idle request is still open
+        central.run(500U, true);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kFast) == 0U, "one request in flight per connection");
+        central.answer(1, true);
+        central.run(20U, true);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kFast) == 1U, "the wanted mode follows the answer");
+    }
+
+    void checkRefused()
+    {
+        FakeCentral central;
+        ble_link_on_connect(&central.policy, 1, central.now);
+        central.run(20U, true);
+        central.answer(1, false);
+        central.run(10000U, true);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kFast) == 1U, "a refused mode is not asked again");
+
+        central.run(BLE_LINK_IDLE_HOLD_MS + 100U, false);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kSlow) == 1U, "the other mode is still asked for");
+        central.answer(1, true);
+        central.run(20U, true);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kFast) == 2U, "and the refused one after the mode changed");
+
+        // the central picks parameters of its own that fit neither mode
+        central.answer(1, true);
+        ble_link_on_conn_update(&central.policy, 1, 0, 40U, 0U);
+        expect(central.run(10000U, true) == 0U, "no argument over the central's own choice");
+    }
+
+    void checkRawStream()
+    {
+        FakeCentral central(false);
+        ble_link_on_connect(&central.policy, 1, central.now);
+        ble_link_on_connect(&central.policy, 2, central.now);
+        ble_link_set_streams_raw(&central.policy, 2, true);
+        central.run(BLE_LINK_IDLE_HOLD_MS + 100U, false);
+        expect(central.requests(2, BLE_LINK_ACTION_PARAMS, kFast) == 1U, "a raw stream subscriber streams while stopped");
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kSlow) == 1U, "the display next to it idles");
+        expect(central.requests(2, BLE_LINK_ACTION_PHY_2M) == 0U && central.requests(2, BLE_LINK_ACTION_DATA_LEN) == 1U,
+               "no 2M PHY without controller support");
+
+        ble_link_on_disconnect(&central.policy, 2);
+        ble_link_on_connect(&central.policy, 2, central.now);
+        central.run(20U, true);
+        expect(central.requests(2, BLE_LINK_ACTION_DATA_LEN) == 2U, "a new connection starts over");
+        ble_link_on_conn_update(&central.policy, 9, 0, 6U, 0U);
+        expect(central.run(20U, true) == 0U, "events of unknown handles change nothing");
+    }
+
+    void checkClockWrap()
+    {
+        FakeCentral central;
+        central.now = 0xFFFFFFFFU - 1000U;
+        ble_link_on_connect(&central.policy, 1, central.now);
+        central.run(BLE_LINK_IDLE_HOLD_MS - 100U, false);
+        expect(central.actions.empty(), "the hold time survives the clock wrap");
+        central.run(200U, false);
+        expect(central.requests(1, BLE_LINK_ACTION_PARAMS, kSlow) == 1U, "idle after the wrap");
+    }
+
+    // connection events per second the radio wakes up for
+    void printCost()
+    {
+        const ble_link_params fast = ble_link_params_for(BLE_LINK_MODE_STREAMING);
+        const ble_link_params slow = ble_link_params_for(BLE_LINK_MODE_IDLE);
+        printf("%-28s %10s %14s\n", "link", "itvl_ms", "events_per_s");
+        printf("%-28s %10.1f %14.1f\n", "central default (50 ms)", 50.0, 20.0);
+        printf("%-28s %10.1f %14.1f\n", "streaming, worst case", fast.itvl_max * 1.25, 1000.0 / (fast.itvl_max * 1.25));
+        printf("%-28s %10.1f %14.1f\n", "idle, with latency", slow.itvl_max * 1.25,
+               1000.0 / (slow.itvl_max * 1.25 * (1U + slow.latency)));
+    }
+}
+
+int main()
+{
+    checkIdleAfterConnect();
+    checkRunAndStop();
+    checkInFlight();
+    checkRefused();
+    checkRawStream();
+    checkClockWrap();
+    printCost();
+    printf("%s\n", failures == 0 ? "all link policy checks passed" : "link policy checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+// Drives the GATT subscription table (ble_subscriptions.h) with the GAP event sequences
+// NimBLE produces and a fake stack in place of ble_gatts_notify_custom and
+// ble_gatts_indicate_custom, which confirms indications when told to. Checks who gets
+// which value, that indications are opt-in and one per connection, and counts the values
+// a polling client would have to read for the same results.
+//
+//   ./build-host/ble_subscription_check
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "ble_subscriptions.h"
+
+namespace
+{
+    // the value handles NimBLE assigns to heartrate, spo2, quality
+    constexpr uint16_t kHeartrate = 12U;
+    constexpr uint16_t kSpo2 = 15U;
+    constexpr uint16_t kQuality = 18U;
+
+    unsigned failures = 0;
+
+    void expect(bool condition, const char *what)
+    {
+        if (!condition)
+        {
+            printf("FAIL: %s\n", what);
+            failures++;
+        }
+    }
+
+    // what gatt_svr_send would have handed to NimBLE
+    struct FakeStack
+    {
+        ble_sub_table table;
+        std::vector<ble_sub_target> sent;
+        // the next sends the stack turns down
+        unsigned failSends = 0;
+
+        FakeStack()
+        {
+            ble_sub_init(&table);
+        }
+
+        // gatt_svr_send: a failed indication is followed by the next pending one
+        void send(ble_sub_target target)
+        {
+            for (;;)
+            {
+                if (failSends == 0)
+                {
+                    sent.push_back(target);
+                    return;
+                }
+                failSends--;
+                if (!target.indicate || !ble_sub_on_indicate_done(&table, target.conn_handle, &target))
+                {
+                    return;
+                }
+            }
+        }
+
+        void publish(uint16_t attr)
+        {
+            ble_sub_target targets[BLE_SUB_MAX_CONNECTIONS];
+            size_t count = ble_sub_collect(&table, attr, targets, BLE_SUB_MAX_CONNECTIONS);
+            for (size_t i = 0; i < count; i++)
+            {
+                send(targets[i]);
+            }
+        }
+
+        // BLE_GAP_EVENT_NOTIFY_TX with the confirmation
+        void confirm(uint16_t conn)
+        {
+            ble_sub_target next;
+            if (ble_sub_on_indicate_done(&table, conn, &next))
+            {
+                send(next);
+            }
+        }
+
+        size_t sentTo(uint16_t conn, uint16_t attr, bool indicate) const
+        {
+            size_t count = 0;
+            for (const ble_sub_target &t : sent)
+            {
+                count += (t.conn_handle == conn && t.attr_handle == attr && t.indicate == indicate) ? 1U : 0U;
+            }
+            return count;
+        }
+    };
+
+    void checkNotify()
+    {
+        FakeStack stack;
+        stack.publish(kHeartrate);
+        expect(stack.sent.empty(), "nothing is sent without subscribers");
+
+        ble_sub_on_subscribe(&stack.table, 1, kHeartrate, true, false);
+        stack.publish(kHeartrate);
+        stack.publish(kSpo2);
+        expect(stack.sentTo(1, kHeartrate, false) == 1U, "notify subscriber gets the value");
+        expect(stack.sent.size() == 1U, "other characteristics are not sent");
+
+        // notifications need no confirmation, every result goes out
+        stack.publish(kHeartrate);
+        stack.publish(kHeartrate);
+        expect(stack.sentTo(1, kHeartrate, false) == 3U, "notifications do not wait");
+
+        ble_sub_on_subscribe(&stack.table, 1, kHeartrate, false, false);
+        stack.publish(kHeartrate);
+        expect(stack.sent.size() == 3U, "unsubscribed peer gets nothing");
+        expect(ble_sub_count(&stack.table, kHeartrate) == 0U, "unsubscribe frees the entry");
+    }
+
+    void checkIndicate()
+    {
+        FakeStack stack;
+        // both enabled: the cheaper notification wins, indications are opt-in
+        ble_sub_on_subscribe(&stack.table, 2, kSpo2, true, true);
+        stack.publish(kSpo2);
+        expect(stack.sentTo(2, kSpo2, false) == 1U && stack.sentTo(2, kSpo2, true) == 0U,
+               "notify is preferred when both are enabled");
+
+        ble_sub_on_subscribe(&stack.table, 3, kSpo2, false, true);
+        ble_sub_on_subscribe(&stack.table, 3, kQuality, false, true);
+        stack.sent.clear();
+        stack.publish(kSpo2);
+        expect(stack.sentTo(3, kSpo2, true) == 1U, "indicate only peer gets an indication");
+
+        // one indication per connection: later values wait for the confirmation
+        stack.publish(kSpo2);
+        stack.publish(kQuality);
+        stack.publish(kSpo2);
+        expect(stack.sentTo(3, kSpo2, true) == 1U && stack.sentTo(3, kQuality, true) == 0U,
+               "nothing more while an indication is in flight");
+        expect(stack.sentTo(2, kSpo2, false) == 3U, "other connections are not held up");
+
+        stack.confirm(3);
+        stack.confirm(3);
+        stack.confirm(3);
+        expect(stack.sentTo(3, kSpo2, true) + stack.sentTo(3, kQuality, true) == 3U,
+               "each pending value is sent once after the confirmations");
+        stack.confirm(3);
+        expect(stack.sentTo(3, kSpo2, true) + stack.sentTo(3, kQuality, true) == 3U,
+               "no resend without a new value");
+
+        // switching to notify drops what was waiting for an indication
+        stack.publish(kQuality);
+        stack.publish(kQuality);
+        ble_sub_on_subscribe(&stack.table, 3, kQuality, true, false);
+        stack.confirm(3);
+        expect(stack.sentTo(3, kQuality, true) == 2U, "pending indication dropped on switch to notify");
+    }
+
+    void checkIndicateFailure()
+    {
+        FakeStack stack;
+        ble_sub_on_subscribe(&stack.table, 6, kHeartrate, false, true);
+        ble_sub_on_subscribe(&stack.table, 6, kSpo2, false, true);
+        ble_sub_on_subscribe(&stack.table, 6, kQuality, false, true);
+        stack.publish(kHeartrate);
+        stack.publish(kSpo2);
+        stack.publish(kQuality);
+        expect(stack.sent.size() == 1U, "spo2 and quality wait behind the heartrate indication");
+
+        // the confirmation promotes spo2, whose send fails: quality takes its place
+        stack.failSends = 1;
+        stack.confirm(6);
+        expect(stack.sentTo(6, kQuality, true) == 1U, "the next pending value goes out after a failed send");
+        stack.confirm(6);
+        stack.publish(kHeartrate);
+        expect(stack.sentTo(6, kHeartrate, true) == 2U, "the connection does not stall");
+
+        // every send fails: nothing stays in flight without being sent
+        stack.publish(kSpo2);
+        stack.publish(kQuality);
+        stack.failSends = 2;
+        stack.confirm(6);
+        size_t before = stack.sent.size();
+        stack.publish(kSpo2);
+        expect(stack.sent.size() == before + 1U && stack.sentTo(6, kSpo2, true) == 1U,
+               "an indication goes out after all pending sends failed");
+
+        // a failed first send of a new value
+        stack.confirm(6);
+        stack.failSends = 1;
+        stack.publish(kQuality);
+        stack.publish(kQuality);
+        expect(stack.sentTo(6, kQuality, true) == 2U, "a failed indication does not block the next one");
+    }
+
+    void checkDisconnect()
+    {
+        FakeStack stack;
+        ble_sub_on_subscribe(&stack.table, 4, kHeartrate, true, false);
+        ble_sub_on_subscribe(&stack.table, 4, kSpo2, false, true);
+        ble_sub_on_subscribe(&stack.table, 5, kHeartrate, true, false);
+        stack.publish(kSpo2);
+        ble_sub_on_disconnect(&stack.table, 4);
+        expect(ble_sub_count(&stack.table, kHeartrate) == 1U, "disconnect drops the connection");
+        expect(ble_sub_count(&stack.table, kSpo2) == 0U, "disconnect drops indications in flight");
+
+        // the handle is reused by the next central, which starts unsubscribed
+        stack.sent.clear();
+        stack.confirm(4);
+        stack.publish(kSpo2);
+        stack.publish(kHeartrate);
+        expect(stack.sent.size() == 1U && stack.sentTo(5, kHeartrate, false) == 1U,
+               "a reused handle inherits nothing");
+    }
+
+    void checkFull()
+    {
+        FakeStack stack;
+        int rc = 0;
+        for (uint16_t i = 0; i < BLE_SUB_MAX_ENTRIES; i++)
+        {
+            rc |= ble_sub_on_subscribe(&stack.table, i / BLE_SUB_MAX_ATTRS, 100 + i % BLE_SUB_MAX_ATTRS, true, false);
+        }
+        expect(rc == 0, "every connection can subscribe to every characteristic");
+        expect(ble_sub_on_subscribe(&stack.table, 99, kHeartrate, true, false) != 0, "a full table is reported");
+        // updating an existing entry needs no free one
+        expect(ble_sub_on_subscribe(&stack.table, 0, 100, false, true) == 0, "existing entries update when full");
+    }
+
+    // one result every 2.5 s over a minute, a gateway that polls the three values every second
+    void compareWithPolling()
+    {
+        FakeStack stack;
+        ble_sub_on_subscribe(&stack.table, 1, kHeartrate, true, false);
+        ble_sub_on_subscribe(&stack.table, 1, kSpo2, true, false);
+        ble_sub_on_subscribe(&stack.table, 1, kQuality, true, false);
+
+        const unsigned results = 24U;
+        for (unsigned i = 0; i < results; i++)
+        {
+            stack.publish(kHeartrate);
+            stack.publish(kSpo2);
+            stack.publish(kQuality);
+        }
+        const unsigned polls = 60U * 3U;
+        printf("%-26s %8s %12s\n", "one minute, 24 results", "att_pdus", "latency_ms");
+        // a read is a request and a response, a notification one PDU
+        printf("%-26s %8u %12s\n", "polling once a second", polls * 2U, "0..1000");
+        printf("%-26s %8zu %12s\n", "notifications", stack.sent.size(), "0");
+    }
+}
+
+int main()
+{
+    checkNotify();
+    checkIndicate();
+    checkIndicateFailure();
+    checkDisconnect();
+    checkFull();
+    compareWithPolling();
+    printf("%s\n", failures == 0 ? "all subscription checks passed" : "subscription checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
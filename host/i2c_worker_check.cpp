@@ -0,0 +1,202 @@
+// Drives the queued transactions of I2CHelper (i2c_submit) against the simulated bus and
+// MAX30102 model: writes and reads come back in submission order with their status, the
+// completion callback and semaphore follow each transfer, a FIFO_DATA burst drains the
+// samples the model holds, and stopping the worker leaves a task notification pending for
+// the caller (the FIFO interrupt) untouched.
+//
+//   ./build-host/i2c_worker_check
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "sim_i2c.h"
+#include "sim_max30102.h"
+// after the standard headers, the algorithm header defines min()
+#include "i2c_helper.h"
+#include "sensor.h"
+
+namespace
+{
+    unsigned failures = 0;
+
+    void expect(bool condition, const char *what)
+    {
+        if (!condition)
+        {
+            printf("FAIL: %s\n", what);
+            failures++;
+        }
+    }
+
+    // half of the worker queue, so submitting never waits for a free slot
+    constexpr size_t kBatch = 4U;
+
+    struct Completion
+    {
+        std::vector<size_t> *order;
+        size_t index;
+    };
+
+    void recordCompletion(esp_err_t err, void *arg)
+    {
+        Completion *completion = static_cast<Completion *>(arg);
+        completion->order->push_back(err == ESP_OK ? completion->index : SIZE_MAX);
+    }
+
+    I2CTransaction makeTransaction(i2c_master_dev_handle_t dev, I2CTransactionType type, SensRegs::Regs reg,
+                                   uint8_t *data, size_t size, SemaphoreHandle_t done)
+    {
+        I2CTransaction transaction{};
+        transaction.dev_handle = dev;
+        transaction.type = type;
+        transaction.registerNum = reg;
+        transaction.data = data;
+        transaction.dataAmount = size;
+        transaction.done = done;
+        return transaction;
+    }
+
+    // write a register and read it back, kBatch times per round, all queued at once. A binary
+    // semaphore does not count, so only the last transaction of a round gives it.
+    void checkOrder(I2CHelper &helper, i2c_master_dev_handle_t dev, SemaphoreHandle_t done)
+    {
+        std::vector<size_t> order;
+        bool valuesOk = true;
+        bool resultsOk = true;
+
+        for (size_t round = 0; round < 16U; round++)
+        {
+            uint8_t written[kBatch];
+            uint8_t read[kBatch];
+            esp_err_t results[2 * kBatch];
+            Completion completions[2 * kBatch];
+
+            for (size_t i = 0; i < kBatch; i++)
+            {
+                written[i] = static_cast<uint8_t>(round * kBatch + i);
+                read[i] = 0xFFU;
+                for (size_t k = 0; k < 2U; k++)
+                {
+                    size_t index = 2U * i + k;
+                    results[index] = ESP_FAIL;
+                    completions[index] = Completion{&order, round * 2U * kBatch + index};
+                    I2CTransaction transaction = makeTransaction(
+                        dev, (k == 0) ? I2CTransactionType::I2C_TRANSACTION_WRITE : I2CTransactionType::I2C_TRANSACTION_READ,
+                        SensRegs::Regs::LED1_PA, (k == 0) ? &written[i] : &read[i], 1U,
+                        (index == 2U * kBatch - 1U) ? done : nullptr);
+                    transaction.callback = recordCompletion;
+                    transaction.callbackArg = &completions[index];
+                    transaction.result = &results[index];
+                    resultsOk &= helper.i2c_submit(transaction) == ESP_OK;
+                }
+            }
+            // the buffers live on this stack frame until every transfer is done
+            resultsOk &= xSemaphoreTake(done, pdMS_TO_TICKS(1000U)) == pdTRUE;
+            for (size_t i = 0; i < kBatch; i++)
+            {
+                valuesOk &= read[i] == written[i];
+                resultsOk &= results[2U * i] == ESP_OK && results[2U * i + 1U] == ESP_OK;
+            }
+        }
+
+        bool inOrder = order.size() == 16U * 2U * kBatch;
+        for (size_t i = 0; inOrder && i < order.size(); i++)
+        {
+            inOrder = order[i] == i;
+        }
+        expect(resultsOk, "every transaction completes with ESP_OK");
+        expect(valuesOk, "each read sees the write queued before it");
+        expect(inOrder, "callbacks run once per transaction, in submission order");
+    }
+
+    void checkOversizedWrite(I2CHelper &helper, i2c_master_dev_handle_t dev)
+    {
+        uint8_t data[64] = {0};
+        I2CTransaction transaction = makeTransaction(dev, I2CTransactionType::I2C_TRANSACTION_WRITE,
+                                                     SensRegs::Regs::LED1_PA, data, sizeof(data), nullptr);
+        expect(helper.i2c_submit(transaction) == ESP_ERR_INVALID_SIZE, "writes beyond the copy buffer are refused");
+    }
+
+    StatusSnapshot readStatus(I2CHelper &helper, i2c_master_dev_handle_t dev)
+    {
+        uint8_t raw[StatusSnapshot::kSize] = {0};
+        helper.i2c_read_mult_register(dev, SensRegs::Regs::ISR_STAT1, raw, sizeof(raw));
+        return StatusSnapshot::decode(raw);
+    }
+
+    // the burst Max30102::readData submits every cycle
+    void checkFifoBurst(I2CHelper &helper, i2c_master_dev_handle_t dev, SimMax30102 &model, SemaphoreHandle_t done)
+    {
+        const Max30102::StartImage image = Max30102::makeStartImage(SensorConfigStruct());
+        expect(helper.i2c_write_register_sequence(dev, image.data(), image.size()) == ESP_OK, "start image written");
+        vTaskDelay(pdMS_TO_TICKS(400U));
+
+        StatusSnapshot before = readStatus(helper, dev);
+        size_t available = before.available();
+        uint64_t drainedBefore = model.stats().drained;
+
+        uint8_t data[32U * 6U];
+        esp_err_t result = ESP_FAIL;
+        I2CTransaction transaction = makeTransaction(dev, I2CTransactionType::I2C_TRANSACTION_READ,
+                                                     SensRegs::Regs::FIFO_DATA, data, available * 6U, done);
+        transaction.result = &result;
+        expect(available != 0 && helper.i2c_submit(transaction) == ESP_OK, "FIFO_DATA burst queued");
+        expect(xSemaphoreTake(done, pdMS_TO_TICKS(1000U)) == pdTRUE && result == ESP_OK, "FIFO_DATA burst completes");
+
+        StatusSnapshot after = readStatus(helper, dev);
+        expect(model.stats().drained - drainedBefore == available, "the burst drains every sample it asked for");
+        expect(((after.readPtr - before.readPtr) & 0x1FU) == (available & 0x1FU), "FIFO_RD_PTR moved past the burst");
+        printf("FIFO_DATA burst through the worker: %zu samples\n", available);
+    }
+
+    void checkStop(I2CHelper &helper, i2c_master_dev_handle_t dev, SemaphoreHandle_t done)
+    {
+        // a FIFO interrupt notification the task has not taken yet
+        TaskHandle_t self = xTaskGetCurrentTaskHandle();
+        xTaskNotifyGive(self);
+
+        uint8_t value = 0;
+        I2CTransaction transaction = makeTransaction(dev, I2CTransactionType::I2C_TRANSACTION_READ,
+                                                     SensRegs::Regs::LED1_PA, &value, 1U, done);
+        expect(helper.i2c_submit(transaction) == ESP_OK, "read queued before the stop");
+        helper.i2c_stop_worker();
+        expect(xSemaphoreTake(done, 0) == pdTRUE, "the worker finishes the queue before it exits");
+        expect(ulTaskNotifyTake(pdTRUE, 0) == 1U, "stopping the worker leaves the task notification alone");
+
+        // a stopped worker starts again on the next submit
+        expect(helper.i2c_submit(transaction) == ESP_OK && xSemaphoreTake(done, pdMS_TO_TICKS(1000U)) == pdTRUE,
+               "the worker restarts after a stop");
+        helper.i2c_stop_worker();
+        helper.i2c_stop_worker();
+        expect(ulTaskNotifyTake(pdTRUE, 0) == 0U, "no notification appears from a stop");
+    }
+}
+
+int main()
+{
+    SimMax30102 model;
+    SimI2cBus::instance().attach(SimMax30102::kAddress, &model);
+
+    {
+        I2CHelper helper;
+        i2c_master_dev_handle_t dev = helper.get_handler(SimMax30102::kAddress);
+        SemaphoreHandle_t done = xSemaphoreCreateBinary();
+
+        checkOrder(helper, dev, done);
+        checkOversizedWrite(helper, dev);
+        checkFifoBurst(helper, dev, model, done);
+        checkStop(helper, dev, done);
+
+        vSemaphoreDelete(done);
+    }
+    SimI2cBus::instance().detach(SimMax30102::kAddress);
+
+    printf("%s\n", failures == 0 ? "all i2c worker checks passed" : "i2c worker checks FAILED");
+
+    return failures == 0 ? 0 : 1;
+}
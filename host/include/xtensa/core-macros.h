@@ -0,0 +1,6 @@
+#ifndef HOST_XTENSA_CORE_MACROS_H
+#define HOST_XTENSA_CORE_MACROS_H
+
+// No cycle counter on the host, the header only has to exist
+
+#endif
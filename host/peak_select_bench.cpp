@@ -0,0 +1,166 @@
+// Checks maxim_remove_close_peaks and maxim_sort_ratios against the original insertion
+// sort versions on random peak sets, and times both.
+//
+//   ./build-host/peak_select_bench [--sets N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "sensor_spo2_algorithm.h"
+
+namespace
+{
+    constexpr int32_t kSignalLength = BUFFER_SIZE;
+
+    uint32_t seed = 0x2545F491U;
+
+    uint32_t next(uint32_t range)
+    {
+        seed = seed * 1664525U + 1013904223U;
+        return (seed >> 8) % range;
+    }
+
+    struct PeakSet
+    {
+        std::vector<int32_t> x;
+        int32_t locs[MAX_PEAKS + 10];
+        int32_t npks;
+        int32_t minDistance;
+    };
+
+    // peaks in ascending order as maxim_peaks_above_min_height reports them, or shuffled
+    // and longer to exercise the reference path
+    PeakSet makeSet(bool ordered)
+    {
+        PeakSet set;
+        set.x.resize(kSignalLength);
+        // a few distinct heights give plenty of ties
+        uint32_t levels = 1U + next(2) * 400U + next(8);
+        for (int32_t &v : set.x)
+        {
+            v = static_cast<int32_t>(next(levels));
+        }
+        set.minDistance = 1 + static_cast<int32_t>(next(40));
+
+        int32_t count = ordered ? static_cast<int32_t>(next(MAX_PEAKS + 1)) : static_cast<int32_t>(next(MAX_PEAKS + 10));
+        int32_t loc = 0;
+        set.npks = 0;
+        for (int32_t i = 0; i < count; i++)
+        {
+            loc += 1 + static_cast<int32_t>(next(ordered ? 60 : 20));
+            if (loc >= kSignalLength)
+            {
+                break;
+            }
+            set.locs[set.npks++] = loc;
+        }
+        if (!ordered)
+        {
+            for (int32_t i = set.npks - 1; i > 0; i--)
+            {
+                int32_t j = static_cast<int32_t>(next(i + 1));
+                int32_t t = set.locs[i];
+                set.locs[i] = set.locs[j];
+                set.locs[j] = t;
+            }
+        }
+        return set;
+    }
+
+    bool samePeaks(PeakSet set)
+    {
+        PeakSet ref = set;
+        maxim_remove_close_peaks(set.locs, &set.npks, set.x.data(), set.minDistance);
+        maxim_remove_close_peaks_ref(ref.locs, &ref.npks, ref.x.data(), ref.minDistance);
+        return set.npks == ref.npks && memcmp(set.locs, ref.locs, set.npks * sizeof(set.locs[0])) == 0;
+    }
+
+    bool sameRatios()
+    {
+        int32_t a[MAX_RATIOS];
+        int32_t b[MAX_RATIOS];
+        int32_t n = static_cast<int32_t>(next(MAX_RATIOS + 1));
+        for (int32_t i = 0; i < MAX_RATIOS; i++)
+        {
+            a[i] = b[i] = static_cast<int32_t>(next(8)) - 2; // ties and negatives
+        }
+        maxim_sort_ratios(a, n);
+        maxim_sort_ascend(b, n);
+        return memcmp(a, b, sizeof(a)) == 0;
+    }
+
+    template <typename Run>
+    double nsPerCall(std::vector<PeakSet> &sets, Run run)
+    {
+        std::vector<PeakSet> work = sets;
+        auto begin = std::chrono::steady_clock::now();
+        for (PeakSet &set : work)
+        {
+            run(set);
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - begin).count() / work.size();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned sets = 20000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--sets") == 0 && i + 1 < argc)
+        {
+            sets = static_cast<unsigned>(atoi(argv[++i]));
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--sets N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    unsigned peakMismatches = 0;
+    unsigned fallbackMismatches = 0;
+    unsigned ratioMismatches = 0;
+    std::vector<PeakSet> ordered;
+    for (unsigned i = 0; i < sets; i++)
+    {
+        ordered.push_back(makeSet(true));
+        peakMismatches += samePeaks(ordered.back()) ? 0U : 1U;
+        fallbackMismatches += samePeaks(makeSet(false)) ? 0U : 1U;
+        ratioMismatches += sameRatios() ? 0U : 1U;
+    }
+
+    // only the ascending sets, the cost of the search inside one window
+    std::vector<PeakSet> full;
+    for (const PeakSet &set : ordered)
+    {
+        if (set.npks == MAX_PEAKS)
+        {
+            full.push_back(set);
+        }
+    }
+
+    printf("%u peak sets, mismatches: %u ascending, %u shuffled, %u ratio sorts\n",
+           sets, peakMismatches, fallbackMismatches, ratioMismatches);
+    printf("%-22s %12s %12s\n", "ns per call", "reference", "bounded");
+    printf("%-22s %12.0f %12.0f\n", "remove_close_peaks",
+           nsPerCall(ordered, [](PeakSet &s)
+                     { maxim_remove_close_peaks_ref(s.locs, &s.npks, s.x.data(), s.minDistance); }),
+           nsPerCall(ordered, [](PeakSet &s)
+                     { maxim_remove_close_peaks(s.locs, &s.npks, s.x.data(), s.minDistance); }));
+    if (!full.empty())
+    {
+        printf("%-22s %12.0f %12.0f\n", "  with 15 peaks",
+               nsPerCall(full, [](PeakSet &s)
+                         { maxim_remove_close_peaks_ref(s.locs, &s.npks, s.x.data(), s.minDistance); }),
+               nsPerCall(full, [](PeakSet &s)
+                         { maxim_remove_close_peaks(s.locs, &s.npks, s.x.data(), s.minDistance); }));
+    }
+    return (peakMismatches | fallbackMismatches | ratioMismatches) == 0 ? 0 : 1;
+}
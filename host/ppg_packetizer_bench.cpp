@@ -0,0 +1,201 @@
+// Checks the raw stream packetizer (ble_ppg_packetizer.h) and measures its throughput.
+// Random FIFO bursts with lost samples in between are packed at several ATT MTUs, every
+// packet is parsed again and the frames are compared with the source by sample index.
+// Per MTU it reports frames per packet, the share of the link layer payload that is
+// sample data, the notifications per second at 400 and 3200 sps, and ns per frame.
+//
+//   ./build-host/ppg_packetizer_bench [--frames N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "ble_ppg_packetizer.h"
+
+namespace
+{
+    // L2CAP header in front of every ATT PDU
+    constexpr size_t kL2capHeader = 4U;
+    constexpr size_t kBurst = 32U;
+
+    uint32_t seed = 0x13579BDFU;
+
+    uint32_t next()
+    {
+        seed = seed * 1664525U + 1013904223U;
+        return seed;
+    }
+
+    // FIFO_DATA bytes of sample i, 18 bits per channel
+    void makeFrame(uint32_t i, uint8_t *out)
+    {
+        uint32_t red = (i * 2654435761U) & 0x3FFFFU;
+        uint32_t ir = (i * 40503U + 7U) & 0x3FFFFU;
+        out[0] = static_cast<uint8_t>(red >> 16);
+        out[1] = static_cast<uint8_t>(red >> 8);
+        out[2] = static_cast<uint8_t>(red);
+        out[3] = static_cast<uint8_t>(ir >> 16);
+        out[4] = static_cast<uint8_t>(ir >> 8);
+        out[5] = static_cast<uint8_t>(ir);
+    }
+
+    struct CheckResult
+    {
+        bool ok = true;
+        size_t packets = 0;
+        size_t frames = 0;
+        size_t gaps = 0;
+    };
+
+    // what main.cpp does with the queued bursts, and a receiver checking each packet
+    CheckResult check(uint16_t mtu, size_t totalFrames)
+    {
+        CheckResult result;
+        PpgPacketizer packetizer(mtu);
+        const size_t maxPayload = (mtu - PpgPacketizer::kAttOverhead < PpgPacketizer::kMaxPayload)
+                                      ? mtu - PpgPacketizer::kAttOverhead
+                                      : PpgPacketizer::kMaxPayload;
+        uint16_t expectedSequence = 0;
+        uint32_t expectedIndex = 0;
+        bool shortPacket = false;
+
+        auto receive = [&]()
+        {
+            uint16_t sequence = 0;
+            uint32_t firstIndex = 0;
+            size_t numFrames = 0;
+            bool parsed = PpgPacketizer::parse(packetizer.data(), packetizer.size(), sequence, firstIndex, numFrames);
+            result.ok &= parsed && packetizer.size() <= maxPayload && sequence == expectedSequence;
+            if (result.packets != 0 && firstIndex != expectedIndex)
+            {
+                result.gaps++;
+            }
+            else
+            {
+                // a packet is full unless lost samples follow it
+                result.ok &= !shortPacket;
+            }
+            shortPacket = numFrames != packetizer.framesPerPacket();
+            for (size_t f = 0; f < numFrames; f++)
+            {
+                uint8_t frame[PpgPacketizer::kFrameSize];
+                makeFrame(firstIndex + static_cast<uint32_t>(f), frame);
+                result.ok &= memcmp(frame, packetizer.data() + PpgPacketizer::kHeaderSize + f * PpgPacketizer::kFrameSize,
+                                    sizeof(frame)) == 0;
+            }
+            result.packets++;
+            result.frames += numFrames;
+            expectedSequence++;
+            expectedIndex = firstIndex + static_cast<uint32_t>(numFrames);
+            packetizer.take();
+        };
+
+        uint32_t index = 0;
+        size_t produced = 0;
+        uint8_t burst[kBurst * PpgPacketizer::kFrameSize];
+        while (produced < totalFrames)
+        {
+            // now and then the FIFO overflows and samples are lost
+            if ((next() >> 16) % 64U == 0)
+            {
+                uint32_t skipped = 1U + (next() >> 16) % 16U;
+                index += skipped;
+            }
+            size_t count = 1U + (next() >> 16) % kBurst;
+            for (size_t f = 0; f < count; f++)
+            {
+                makeFrame(index + static_cast<uint32_t>(f), burst + f * PpgPacketizer::kFrameSize);
+            }
+            size_t done = 0;
+            while (done < count)
+            {
+                done += packetizer.append(index + static_cast<uint32_t>(done),
+                                          burst + done * PpgPacketizer::kFrameSize, count - done);
+                if (packetizer.ready())
+                {
+                    receive();
+                }
+            }
+            index += static_cast<uint32_t>(count);
+            produced += count;
+        }
+        if (packetizer.flush())
+        {
+            receive();
+        }
+        result.ok &= (result.frames == produced) && (expectedIndex == index);
+        return result;
+    }
+
+    double nsPerFrame(uint16_t mtu, size_t totalFrames)
+    {
+        PpgPacketizer packetizer(mtu);
+        uint8_t burst[24U * PpgPacketizer::kFrameSize];
+        for (size_t f = 0; f < 24U; f++)
+        {
+            makeFrame(static_cast<uint32_t>(f), burst + f * PpgPacketizer::kFrameSize);
+        }
+        volatile uint8_t sink = 0;
+        auto begin = std::chrono::steady_clock::now();
+        uint32_t index = 0;
+        for (size_t produced = 0; produced < totalFrames; produced += 24U)
+        {
+            size_t done = 0;
+            while (done < 24U)
+            {
+                done += packetizer.append(index + static_cast<uint32_t>(done),
+                                          burst + done * PpgPacketizer::kFrameSize, 24U - done);
+                if (packetizer.ready())
+                {
+                    sink = sink + packetizer.data()[packetizer.size() - 1];
+                    packetizer.take();
+                }
+            }
+            index += 24U;
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - begin).count() / totalFrames;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t frames = 2000000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = static_cast<size_t>(atol(argv[++i]));
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--frames N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    static constexpr uint16_t kMtus[] = {23U, 64U, 185U, 247U, 256U, 517U};
+    unsigned failures = 0;
+
+    printf("%5s %7s %8s %8s %7s %10s %11s %7s %7s\n", "mtu", "frames", "payload", "data%", "exact", "pkts@400", "pkts@3200",
+           "gaps", "ns/frm");
+    for (uint16_t mtu : kMtus)
+    {
+        CheckResult r = check(mtu, frames / 10U);
+        failures += r.ok ? 0U : 1U;
+
+        PpgPacketizer packetizer(mtu);
+        size_t perPacket = packetizer.framesPerPacket();
+        size_t payload = PpgPacketizer::kHeaderSize + perPacket * PpgPacketizer::kFrameSize;
+        double dataShare = 100.0 * perPacket * PpgPacketizer::kFrameSize /
+                           (payload + PpgPacketizer::kAttOverhead + kL2capHeader);
+        printf("%5u %7zu %8zu %8.1f %7s %10.1f %11.1f %7zu %7.2f\n", mtu, perPacket, payload, dataShare,
+               r.ok ? "yes" : "NO", 400.0 / perPacket, 3200.0 / perPacket, r.gaps, nsPerFrame(mtu, frames));
+    }
+    printf("frames: per packet; data%%: sample bytes of the L2CAP frame; exact: every frame back at its index,\n");
+    printf("sequence without holes, packets full unless lost samples follow; gaps: lost sample runs found\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+// Compares the Rice coded raw stream (ble_ppg_rice.h) with the plain one (ble_ppg_packetizer.h).
+// A synthetic PPG per rate and noise level goes through both packetizers at one ATT MTU; every
+// Rice packet is decoded again and compared with the source by sample index. Reports frames
+// per notification for both, the gain, bits per frame, and encode and decode ns per sample
+// (one red or ir value). Random full scale frames and lost samples check the escape path and
+// the gap handling.
+//
+//   ./build-host/ppg_rice_bench [--mtu N] [--noise LIST] [--seconds N]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "ble_ppg_packetizer.h"
+#include "ble_ppg_rice.h"
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr uint32_t kSampleMask = 0x3FFFFU;
+    constexpr size_t kBurst = 24U;
+
+    uint32_t seed = 0x0BADF00DU;
+
+    uint32_t next()
+    {
+        seed = seed * 1664525U + 1013904223U;
+        return seed;
+    }
+
+    double gaussian(double sigma)
+    {
+        double sum = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            sum += (next() >> 8) / 16777216.0 - 0.5;
+        }
+        return sum * sigma * 1.7320508;
+    }
+
+    void put(uint8_t *out, uint32_t value)
+    {
+        out[0] = static_cast<uint8_t>(value >> 16);
+        out[1] = static_cast<uint8_t>(value >> 8);
+        out[2] = static_cast<uint8_t>(value);
+    }
+
+    uint32_t clampSample(double v)
+    {
+        return (v < 0) ? 0U : ((v > kSampleMask) ? kSampleMask : static_cast<uint32_t>(v));
+    }
+
+    // FIFO_DATA bytes of a PPG like the simulator's: 72 bpm, 2 % perfusion, additive noise
+    std::vector<uint8_t> synthesize(uint32_t rate, double noise, size_t frames)
+    {
+        std::vector<uint8_t> raw(frames * PpgPacketizer::kFrameSize);
+        for (size_t i = 0; i < frames; i++)
+        {
+            double phase = 2 * kPi * 1.2 * i / rate;
+            double pulse = 0.6 * sin(phase) + 0.25 * sin(2 * phase) + 0.1 * sin(3 * phase);
+            put(&raw[i * 6], clampSample(100000.0 * (1.0 - 0.01 * 0.6 * pulse) + gaussian(noise)));
+            put(&raw[i * 6 + 3], clampSample(120000.0 * (1.0 - 0.01 * pulse) + gaussian(noise)));
+        }
+        return raw;
+    }
+
+    struct Packed
+    {
+        std::vector<std::vector<uint8_t>> packets;
+        size_t bytes = 0;
+        double ns = 0;
+    };
+
+    // bursts as the sensor task queues them, with an optional lost sample run before some
+    template <typename Packetizer>
+    Packed pack(const std::vector<uint8_t> &raw, uint16_t mtu, bool gaps)
+    {
+        Packed result;
+        Packetizer packetizer(mtu);
+        const size_t frames = raw.size() / PpgPacketizer::kFrameSize;
+        uint32_t index = 0;
+
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t pos = 0; pos < frames; pos += kBurst)
+        {
+            size_t count = (frames - pos < kBurst) ? frames - pos : kBurst;
+            if (gaps && (next() >> 16) % 8U == 0)
+            {
+                index += 1U + (next() >> 16) % 8U;
+            }
+            size_t done = 0;
+            while (done < count)
+            {
+                done += packetizer.append(index + static_cast<uint32_t>(done),
+                                          &raw[(pos + done) * PpgPacketizer::kFrameSize], count - done);
+                if (packetizer.ready())
+                {
+                    result.packets.emplace_back(packetizer.data(), packetizer.data() + packetizer.size());
+                    result.bytes += packetizer.size();
+                    packetizer.take();
+                }
+            }
+            index += static_cast<uint32_t>(count);
+        }
+        if (packetizer.flush())
+        {
+            result.packets.emplace_back(packetizer.data(), packetizer.data() + packetizer.size());
+            result.bytes += packetizer.size();
+        }
+        auto end = std::chrono::steady_clock::now();
+        result.ns = std::chrono::duration<double, std::nano>(end - begin).count();
+        return result;
+    }
+
+    // decodes every packet, places the frames by sample index and compares with the source
+    bool roundTrip(const std::vector<uint8_t> &raw, const Packed &packed, uint16_t mtu, double &decodeNs)
+    {
+        const size_t frames = raw.size() / PpgPacketizer::kFrameSize;
+        const size_t maxPayload = (mtu > PpgPacketizer::kMaxMtu) ? PpgPacketizer::kMaxPayload : mtu - PpgPacketizer::kAttOverhead;
+        std::vector<uint8_t> decoded;
+        std::vector<uint8_t> out(PpgRicePacketizer::kMaxFrames * PpgPacketizer::kFrameSize);
+        uint16_t expectedSequence = 0;
+        bool ok = true;
+
+        auto begin = std::chrono::steady_clock::now();
+        for (const std::vector<uint8_t> &packet : packed.packets)
+        {
+            uint16_t sequence = 0;
+            uint32_t firstIndex = 0;
+            size_t numFrames = 0;
+            ok &= packet.size() <= maxPayload;
+            ok &= PpgRicePacketizer::decode(packet.data(), packet.size(), sequence, firstIndex, out.data(),
+                                            PpgRicePacketizer::kMaxFrames, numFrames);
+            ok &= sequence == expectedSequence++;
+            decoded.insert(decoded.end(), out.begin(), out.begin() + numFrames * PpgPacketizer::kFrameSize);
+        }
+        auto end = std::chrono::steady_clock::now();
+        decodeNs = std::chrono::duration<double, std::nano>(end - begin).count();
+
+        // the index only matters for gaps, the frames themselves come in order
+        ok &= decoded.size() == frames * PpgPacketizer::kFrameSize;
+        for (size_t i = 0; ok && i < frames * 2U; i++)
+        {
+            const uint8_t *a = &raw[i * 3];
+            const uint8_t *b = &decoded[i * 3];
+            uint32_t va = ((uint32_t(a[0]) << 16) | (uint32_t(a[1]) << 8) | a[2]) & kSampleMask;
+            uint32_t vb = ((uint32_t(b[0]) << 16) | (uint32_t(b[1]) << 8) | b[2]) & kSampleMask;
+            ok &= va == vb;
+        }
+        return ok;
+    }
+
+    std::vector<double> parseList(const char *text)
+    {
+        std::vector<double> values;
+        const char *p = text;
+        while (*p != '\0')
+        {
+            char *end = nullptr;
+            values.push_back(strtod(p, &end));
+            p = (*end == ',') ? end + 1 : end;
+            if (end == p && *p != '\0')
+            {
+                break;
+            }
+        }
+        return values;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t mtu = 256U;
+    std::vector<double> noises = {5.0, 20.0, 80.0};
+    double seconds = 60.0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--mtu") == 0 && i + 1 < argc)
+        {
+            mtu = static_cast<uint16_t>(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc)
+        {
+            noises = parseList(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            seconds = atof(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--mtu N] [--noise LIST] [--seconds N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    static constexpr uint32_t kRates[] = {50U, 100U, 200U, 400U, 800U, 1600U, 3200U};
+    unsigned failures = 0;
+
+    printf("mtu %u, frames per notification and bits per frame (plain: 48)\n", mtu);
+    printf("%6s %6s %7s %7s %6s %9s %6s %9s %9s\n", "rate", "noise", "plain", "rice", "gain", "bits/frm", "exact",
+           "enc_ns/s", "dec_ns/s");
+    for (double noise : noises)
+    {
+        for (uint32_t rate : kRates)
+        {
+            std::vector<uint8_t> raw = synthesize(rate, noise, static_cast<size_t>(rate * seconds));
+            const size_t frames = raw.size() / PpgPacketizer::kFrameSize;
+
+            Packed plain = pack<PpgPacketizer>(raw, mtu, false);
+            Packed rice = pack<PpgRicePacketizer>(raw, mtu, false);
+            double decodeNs = 0;
+            bool exact = roundTrip(raw, rice, mtu, decodeNs);
+            failures += exact ? 0U : 1U;
+
+            double plainPerPacket = static_cast<double>(frames) / plain.packets.size();
+            double ricePerPacket = static_cast<double>(frames) / rice.packets.size();
+            size_t streamBytes = rice.bytes - rice.packets.size() * (PpgRicePacketizer::kHeaderSize + PpgRicePacketizer::kKeyframeSize);
+            printf("%6u %6.0f %7.1f %7.1f %6.2f %9.2f %6s %9.2f %9.2f\n", rate, noise, plainPerPacket, ricePerPacket,
+                   ricePerPacket / plainPerPacket, 8.0 * streamBytes / (frames - rice.packets.size()),
+                   exact ? "yes" : "NO", rice.ns / (2.0 * frames), decodeNs / (2.0 * frames));
+        }
+    }
+
+    // the escape path: random full scale frames, and lost sample runs between bursts
+    {
+        std::vector<uint8_t> raw(100000U * PpgPacketizer::kFrameSize);
+        for (size_t i = 0; i < raw.size() / 3U; i++)
+        {
+            put(&raw[i * 3], (next() >> 8) & kSampleMask);
+        }
+        Packed rice = pack<PpgRicePacketizer>(raw, mtu, false);
+        double decodeNs = 0;
+        bool exact = roundTrip(raw, rice, mtu, decodeNs);
+        failures += exact ? 0U : 1U;
+        printf("full scale noise: %.1f frames per notification, exact %s\n",
+               static_cast<double>(raw.size() / PpgPacketizer::kFrameSize) / rice.packets.size(), exact ? "yes" : "NO");
+
+        std::vector<uint8_t> ppg = synthesize(400U, 20.0, 200000U);
+        Packed gapped = pack<PpgRicePacketizer>(ppg, mtu, true);
+        exact = roundTrip(ppg, gapped, mtu, decodeNs);
+        failures += exact ? 0U : 1U;
+        printf("lost samples between bursts: %zu packets, exact %s\n", gapped.packets.size(), exact ? "yes" : "NO");
+    }
+
+    printf("gain: rice over plain frames per notification; ns/s: per red or ir sample\n");
+    return failures == 0 ? 0 : 1;
+}
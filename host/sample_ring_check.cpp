@@ -0,0 +1,204 @@
+// Stress test of the SPSC sample ring (sample_ring.h): a producer thread pushes frames
+// carrying a running sequence number in random batch sizes, a consumer thread pops them in
+// other random batch sizes through both pop variants, and every frame has to arrive once
+// and in order. Small rings wrap the free running indices many times and run full often;
+// the test fails when a ring was never seen full. Single threaded cases check the edges:
+// full ring, wraparound inside one push and pop, clear.
+//
+//   ./build-host/sample_ring_check [--samples N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+
+#include "sample_ring.h"
+
+namespace
+{
+    unsigned failures = 0;
+
+    void expect(bool condition, const char *what)
+    {
+        if (!condition)
+        {
+            printf("FAIL: %s\n", what);
+            failures++;
+        }
+    }
+
+    // ir carries a second copy so a torn frame shows up
+    SampleFrame frameFor(uint32_t sequence)
+    {
+        return SampleFrame{sequence, ~sequence * 2654435761U};
+    }
+
+    struct Lcg
+    {
+        uint32_t seed;
+
+        uint32_t next(uint32_t bound)
+        {
+            seed = seed * 1664525U + 1013904223U;
+            return (seed >> 16) % bound;
+        }
+    };
+
+    template <size_t Capacity>
+    void checkEdges()
+    {
+        SampleRing<Capacity> ring;
+        SampleFrame in[Capacity + 1];
+        SampleFrame out[Capacity + 1];
+        uint32_t next = 0;
+        uint32_t expected = 0;
+        bool ok = true;
+
+        // walk the indices around the ring several times, a full ring each round
+        for (size_t round = 0; round < 4U * Capacity + 3U; round++)
+        {
+            for (size_t i = 0; i <= Capacity; i++)
+            {
+                in[i] = frameFor(next + static_cast<uint32_t>(i));
+            }
+            size_t stored = ring.push(in, Capacity + 1);
+            next += static_cast<uint32_t>(stored);
+            ok &= ring.size() == Capacity && ring.freeSpace() == 0;
+            ok &= ring.push(in, 1) == 0;
+
+            // take part of it so the next round starts at another offset
+            size_t take = 1U + round % Capacity;
+            size_t got = ring.pop(out, take);
+            ok &= got == take;
+            for (size_t i = 0; i < got; i++)
+            {
+                ok &= out[i].red == expected && out[i].ir == frameFor(expected).ir;
+                expected++;
+            }
+            // the rest is dropped
+            expected += static_cast<uint32_t>(ring.size());
+            ring.clear();
+            ok &= ring.size() == 0 && ring.freeSpace() == Capacity;
+        }
+        ok &= expected == next;
+        expect(ok, "full ring, wraparound and clear");
+    }
+
+    struct StressResult
+    {
+        bool ok = true;
+        size_t fullPushes = 0;
+        size_t emptyPops = 0;
+    };
+
+    template <size_t Capacity>
+    StressResult stress(uint32_t samples)
+    {
+        SampleRing<Capacity> ring;
+        StressResult result;
+        std::atomic<bool> failed{false};
+
+        std::thread producer([&]()
+                             {
+                                 Lcg lcg{0x1234567U};
+                                 SampleFrame batch[2 * Capacity];
+                                 uint32_t sequence = 0;
+                                 while (sequence < samples && !failed.load(std::memory_order_relaxed))
+                                 {
+                                     size_t want = 1U + lcg.next(2U * Capacity);
+                                     if (want > samples - sequence)
+                                     {
+                                         want = samples - sequence;
+                                     }
+                                     for (size_t i = 0; i < want; i++)
+                                     {
+                                         batch[i] = frameFor(sequence + static_cast<uint32_t>(i));
+                                     }
+                                     // what does not fit is offered again, as the sensor task would lose it
+                                     size_t stored = ring.push(batch, want);
+                                     if (stored < want)
+                                     {
+                                         result.fullPushes++;
+                                         // on one core the consumer has to run first
+                                         std::this_thread::yield();
+                                     }
+                                     sequence += static_cast<uint32_t>(stored);
+                                 } });
+
+        Lcg lcg{0x7654321U};
+        uint32_t expected = 0;
+        uint32_t red[2 * Capacity];
+        uint32_t ir[2 * Capacity];
+        SampleFrame frames[2 * Capacity];
+        while (expected < samples && result.ok)
+        {
+            size_t want = 1U + lcg.next(2U * Capacity);
+            bool split = (lcg.next(2U) == 0);
+            size_t got = split ? ring.pop(red, ir, want) : ring.pop(frames, want);
+            if (got == 0)
+            {
+                result.emptyPops++;
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t i = 0; i < got; i++)
+            {
+                uint32_t r = split ? red[i] : frames[i].red;
+                uint32_t v = split ? ir[i] : frames[i].ir;
+                if (r != expected || v != frameFor(expected).ir)
+                {
+                    // lost, duplicated, reordered or torn
+                    printf("FAIL: ring %zu: sample %u arrived as %u\n", Capacity, expected, r);
+                    result.ok = false;
+                    failed.store(true, std::memory_order_relaxed);
+                    break;
+                }
+                expected++;
+            }
+        }
+        producer.join();
+        result.ok &= ring.size() == 0;
+        return result;
+    }
+
+    template <size_t Capacity>
+    void runStress(uint32_t samples)
+    {
+        StressResult r = stress<Capacity>(samples);
+        printf("%8zu %10u %7s %11zu %11zu\n", Capacity, samples, r.ok ? "yes" : "NO", r.fullPushes, r.emptyPops);
+        expect(r.ok, "every sample arrives once and in order");
+        expect(r.fullPushes != 0, "the ring ran full");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t samples = 4000000U;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+        {
+            samples = static_cast<uint32_t>(atol(argv[++i]));
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--samples N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    checkEdges<1>();
+    checkEdges<8>();
+    checkEdges<512>();
+
+    printf("%8s %10s %7s %11s %11s\n", "capacity", "samples", "exact", "full_push", "empty_pop");
+    runStress<1>(samples / 8U);
+    runStress<8>(samples);
+    runStress<64>(samples);
+    runStress<512>(samples);
+    printf("%s\n", failures == 0 ? "all sample ring checks passed" : "sample ring checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+// Host implementation of the FreeRTOS, esp_timer and esp_log subset used by the firmware
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SimTask
+{
+    std::string name;
+    pthread_t thread;
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifyValue = 0;
+};
+
+struct SimQueue
+{
+    size_t length;
+    size_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+static thread_local SimTask *currentTask = nullptr;
+
+static std::chrono::steady_clock::time_point simStartTime()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return start;
+}
+
+static std::chrono::milliseconds ticksToDuration(TickType_t ticks)
+{
+    return std::chrono::milliseconds(static_cast<uint64_t>(ticks) * portTICK_PERIOD_MS);
+}
+
+// waits on cv until pred() holds, portMAX_DELAY blocks forever; returns pred()
+template <typename Predicate>
+static bool waitTicks(std::condition_variable &cv, std::unique_lock<std::mutex> &lock,
+                      TickType_t ticks, Predicate pred)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        cv.wait(lock, pred);
+        return true;
+    }
+    return cv.wait_for(lock, ticksToDuration(ticks), pred);
+}
+
+extern "C" BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName, uint32_t usStackDepth,
+                                  void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask)
+{
+    (void)usStackDepth;
+    (void)uxPriority;
+
+    SimTask *task = new SimTask();
+    task->name = pcName != nullptr ? pcName : "";
+
+    std::promise<void> started;
+    std::future<void> ready = started.get_future();
+    // the task owns the promise, so it outlives set_value() whenever xTaskCreate returns
+    std::thread thread([task, pxTaskCode, pvParameters, started = std::move(started)]() mutable
+                       {
+                           currentTask = task;
+                           task->thread = pthread_self();
+                           started.set_value();
+                           pxTaskCode(pvParameters); });
+    // the handle has to be usable as soon as xTaskCreate returns
+    ready.wait();
+    thread.detach();
+
+    if (pxCreatedTask != nullptr)
+    {
+        *pxCreatedTask = task;
+    }
+    return pdPASS;
+}
+
+extern "C" void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    // threads can not be killed, a task deleting itself returns right after this call
+    (void)xTaskToDelete;
+}
+
+extern "C" void vTaskDelay(TickType_t xTicksToDelay)
+{
+    std::this_thread::sleep_for(ticksToDuration(xTicksToDelay));
+}
+
+extern "C" TickType_t xTaskGetTickCount(void)
+{
+    auto elapsed = std::chrono::steady_clock::now() - simStartTime();
+    return static_cast<TickType_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() /
+                                   portTICK_PERIOD_MS);
+}
+
+extern "C" TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (currentTask == nullptr)
+    {
+        // threads not created with xTaskCreate (e.g. main) get a handle on first use
+        currentTask = new SimTask();
+        currentTask->name = "host";
+        currentTask->thread = pthread_self();
+    }
+    return currentTask;
+}
+
+extern "C" uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    SimTask *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+
+    waitTicks(task->notified, lock, xTicksToWait, [task]()
+              { return task->notifyValue != 0; });
+
+    uint32_t value = task->notifyValue;
+    if (value != 0)
+    {
+        task->notifyValue = xClearCountOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+extern "C" BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+    {
+        std::lock_guard<std::mutex> lock(xTaskToNotify->mutex);
+        xTaskToNotify->notifyValue++;
+    }
+    xTaskToNotify->notified.notify_one();
+    return pdPASS;
+}
+
+extern "C" void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    xTaskNotifyGive(xTaskToNotify);
+    if (pxHigherPriorityTaskWoken != nullptr)
+    {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    }
+}
+
+extern "C" uint64_t sim_task_cpu_time_us(TaskHandle_t xTask)
+{
+    clockid_t clock;
+    struct timespec ts;
+
+    if (xTask == nullptr || pthread_getcpuclockid(xTask->thread, &clock) != 0 || clock_gettime(clock, &ts) != 0)
+    {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000U + static_cast<uint64_t>(ts.tv_nsec) / 1000U;
+}
+
+extern "C" QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    SimQueue *queue = new SimQueue();
+    queue->length = uxQueueLength;
+    queue->itemSize = uxItemSize;
+    return queue;
+}
+
+extern "C" void vQueueDelete(QueueHandle_t xQueue)
+{
+    delete xQueue;
+}
+
+extern "C" BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    std::unique_lock<std::mutex> lock(xQueue->mutex);
+    if (!waitTicks(xQueue->notFull, lock, xTicksToWait, [xQueue]()
+                   { return xQueue->items.size() < xQueue->length; }))
+    {
+        return pdFAIL;
+    }
+
+    const uint8_t *item = static_cast<const uint8_t *>(pvItemToQueue);
+    xQueue->items.emplace_back(item, item + xQueue->itemSize);
+    // notified under the lock: a receiver may delete the queue as soon as the lock is free
+    xQueue->notEmpty.notify_one();
+    return pdPASS;
+}
+
+extern "C" BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    std::unique_lock<std::mutex> lock(xQueue->mutex);
+    if (!waitTicks(xQueue->notEmpty, lock, xTicksToWait, [xQueue]()
+                   { return !xQueue->items.empty(); }))
+    {
+        return pdFAIL;
+    }
+
+    if (xQueue->itemSize != 0)
+    {
+        memcpy(pvBuffer, xQueue->items.front().data(), xQueue->itemSize);
+    }
+    xQueue->items.pop_front();
+    xQueue->notFull.notify_one();
+    return pdPASS;
+}
+
+extern "C" int64_t esp_timer_get_time(void)
+{
+    auto elapsed = std::chrono::steady_clock::now() - simStartTime();
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+static std::atomic<int> logLevel{ESP_LOG_WARN};
+
+extern "C" void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    logLevel = level;
+}
+
+extern "C" void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    (void)tag;
+    if (level > logLevel)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
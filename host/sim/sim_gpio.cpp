@@ -0,0 +1,170 @@
+// Host implementation of the GPIO driver subset used for the sensor interrupt line
+
+#include "driver/gpio.h"
+
+#include <mutex>
+
+struct SimPin
+{
+    gpio_int_type_t intrType = GPIO_INTR_DISABLE;
+    gpio_isr_t handler = nullptr;
+    void *arg = nullptr;
+    bool intrEnabled = false;
+    int level = 1;
+};
+
+static std::mutex pinsMutex;
+static SimPin pins[GPIO_NUM_MAX];
+
+static bool validPin(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+// runs the handler outside of the lock, like an interrupt preempting the caller
+static void dispatch(gpio_num_t gpio_num, int previousLevel)
+{
+    gpio_isr_t handler = nullptr;
+    void *arg = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pinsMutex);
+        const SimPin &pin = pins[gpio_num];
+        if (pin.handler == nullptr || !pin.intrEnabled)
+        {
+            return;
+        }
+
+        bool fire = false;
+        switch (pin.intrType)
+        {
+        case GPIO_INTR_LOW_LEVEL:
+            fire = pin.level == 0;
+            break;
+        case GPIO_INTR_HIGH_LEVEL:
+            fire = pin.level == 1;
+            break;
+        case GPIO_INTR_NEGEDGE:
+            fire = previousLevel == 1 && pin.level == 0;
+            break;
+        case GPIO_INTR_POSEDGE:
+            fire = previousLevel == 0 && pin.level == 1;
+            break;
+        case GPIO_INTR_ANYEDGE:
+            fire = previousLevel != pin.level;
+            break;
+        default:
+            break;
+        }
+
+        if (!fire)
+        {
+            return;
+        }
+        handler = pin.handler;
+        arg = pin.arg;
+    }
+    handler(arg);
+}
+
+extern "C" esp_err_t gpio_config(const gpio_config_t *pGPIOConfig)
+{
+    std::lock_guard<std::mutex> lock(pinsMutex);
+    for (int i = 0; i < GPIO_NUM_MAX; i++)
+    {
+        if (pGPIOConfig->pin_bit_mask & (1ULL << i))
+        {
+            pins[i].intrType = pGPIOConfig->intr_type;
+        }
+    }
+    return ESP_OK;
+}
+
+extern "C" esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    (void)intr_alloc_flags;
+    static bool installed = false;
+    std::lock_guard<std::mutex> lock(pinsMutex);
+    if (installed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    installed = true;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (!validPin(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(pinsMutex);
+    pins[gpio_num].handler = isr_handler;
+    pins[gpio_num].arg = args;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (!validPin(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(pinsMutex);
+    pins[gpio_num].handler = nullptr;
+    pins[gpio_num].arg = nullptr;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    if (!validPin(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int level;
+    {
+        std::lock_guard<std::mutex> lock(pinsMutex);
+        pins[gpio_num].intrEnabled = true;
+        level = pins[gpio_num].level;
+    }
+    // a level interrupt that is still asserted fires again right away
+    dispatch(gpio_num, level);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    if (!validPin(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(pinsMutex);
+    pins[gpio_num].intrEnabled = false;
+    return ESP_OK;
+}
+
+extern "C" int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (!validPin(gpio_num))
+    {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(pinsMutex);
+    return pins[gpio_num].level;
+}
+
+extern "C" void sim_gpio_set_level(gpio_num_t gpio_num, int level)
+{
+    if (!validPin(gpio_num))
+    {
+        return;
+    }
+    int previousLevel;
+    {
+        std::lock_guard<std::mutex> lock(pinsMutex);
+        previousLevel = pins[gpio_num].level;
+        pins[gpio_num].level = level;
+    }
+    dispatch(gpio_num, previousLevel);
+}
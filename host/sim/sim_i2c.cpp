@@ -0,0 +1,177 @@
+// Host implementation of the I2C master driver on top of SimI2cBus
+
+#include "driver/i2c_master.h"
+#include "sim_i2c.h"
+
+#include <chrono>
+#include <thread>
+
+struct i2c_master_bus_t
+{
+    i2c_master_bus_config_t config;
+};
+
+struct i2c_master_dev_t
+{
+    i2c_master_bus_t *bus;
+    i2c_device_config_t config;
+};
+
+SimI2cBus &SimI2cBus::instance()
+{
+    static SimI2cBus bus;
+    return bus;
+}
+
+void SimI2cBus::attach(uint16_t address, SimI2cDevice *device)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    devices[address] = device;
+}
+
+void SimI2cBus::detach(uint16_t address)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    devices.erase(address);
+}
+
+bool SimI2cBus::present(uint16_t address)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return devices.count(address) != 0;
+}
+
+void SimI2cBus::setRealTime(bool enable)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    realTime = enable;
+}
+
+esp_err_t SimI2cBus::transfer(uint16_t address, uint32_t sclSpeedHz,
+                              const uint8_t *writeBuffer, size_t writeSize,
+                              uint8_t *readBuffer, size_t readSize)
+{
+    // the bus is held for the whole transfer, like the hardware does
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = devices.find(address);
+    if (it == devices.end() || !it->second->acknowledges())
+    {
+        return ESP_FAIL;
+    }
+
+    // 9 clocks per byte (address byte included) plus start/stop conditions
+    uint64_t bits = 2 + (writeSize + 1) * 9;
+    if (readSize != 0)
+    {
+        bits += 1 + (readSize + 1) * 9;
+    }
+    uint64_t busyUs = (bits * 1000000U + sclSpeedHz - 1) / sclSpeedHz;
+    auto done = std::chrono::steady_clock::now() + std::chrono::microseconds(busyUs);
+
+    if (writeSize != 0)
+    {
+        it->second->write(writeBuffer, writeSize);
+    }
+    if (readSize != 0)
+    {
+        it->second->read(readBuffer, readSize);
+    }
+
+    counters.transactions++;
+    counters.bytes += writeSize + readSize;
+    counters.busyUs += busyUs;
+
+    if (realTime)
+    {
+        std::this_thread::sleep_until(done);
+    }
+    return ESP_OK;
+}
+
+void SimI2cBus::countProbe()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.probes++;
+}
+
+void SimI2cBus::countDevice(bool added)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (added)
+    {
+        counters.devicesAdded++;
+    }
+    else
+    {
+        counters.devicesRemoved++;
+    }
+}
+
+SimI2cBus::Stats SimI2cBus::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void SimI2cBus::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counters = Stats{};
+}
+
+extern "C" esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config,
+                                        i2c_master_bus_handle_t *ret_bus_handle)
+{
+    *ret_bus_handle = new i2c_master_bus_t{*bus_config};
+    return ESP_OK;
+}
+
+extern "C" esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t bus_handle)
+{
+    delete bus_handle;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus_handle, uint16_t address, int xfer_timeout_ms)
+{
+    (void)bus_handle;
+    (void)xfer_timeout_ms;
+
+    SimI2cBus &bus = SimI2cBus::instance();
+    bus.countProbe();
+    return bus.present(address) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+extern "C" esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle,
+                                               const i2c_device_config_t *dev_config,
+                                               i2c_master_dev_handle_t *ret_handle)
+{
+    *ret_handle = new i2c_master_dev_t{bus_handle, *dev_config};
+    SimI2cBus::instance().countDevice(true);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t handle)
+{
+    delete handle;
+    SimI2cBus::instance().countDevice(false);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer,
+                                         size_t write_size, int xfer_timeout_ms)
+{
+    (void)xfer_timeout_ms;
+    return SimI2cBus::instance().transfer(i2c_dev->config.device_address, i2c_dev->config.scl_speed_hz,
+                                          write_buffer, write_size, nullptr, 0);
+}
+
+extern "C" esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer,
+                                                 size_t write_size, uint8_t *read_buffer, size_t read_size,
+                                                 int xfer_timeout_ms)
+{
+    (void)xfer_timeout_ms;
+    return SimI2cBus::instance().transfer(i2c_dev->config.device_address, i2c_dev->config.scl_speed_hz,
+                                          write_buffer, write_size, read_buffer, read_size);
+}
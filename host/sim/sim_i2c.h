@@ -0,0 +1,69 @@
+#ifndef SIM_I2C_H
+#define SIM_I2C_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include <map>
+#include <mutex>
+
+/// @brief A device model attached to the simulated bus
+class SimI2cDevice
+{
+public:
+    virtual ~SimI2cDevice() {}
+
+    /// @brief Address phase, a device that returns false NACKs the whole transaction
+    virtual bool acknowledges() { return true; }
+
+    /// @brief Write phase of a transaction (register pointer followed by data)
+    virtual void write(const uint8_t *data, size_t size) = 0;
+    /// @brief Read phase of a transaction, after the write phase or a repeated start
+    virtual void read(uint8_t *data, size_t size) = 0;
+};
+
+/// @brief Simulated I2C bus, routes transfers by address and accounts bus time
+class SimI2cBus
+{
+public:
+    struct Stats
+    {
+        uint64_t transactions;
+        uint64_t bytes;
+        uint64_t busyUs;
+        uint64_t probes;
+        uint64_t devicesAdded;
+        uint64_t devicesRemoved;
+    };
+
+    static SimI2cBus &instance();
+
+    void attach(uint16_t address, SimI2cDevice *device);
+    void detach(uint16_t address);
+    bool present(uint16_t address);
+
+    /// @brief When enabled every transfer blocks for the time it takes on the wire
+    void setRealTime(bool enable);
+
+    esp_err_t transfer(uint16_t address, uint32_t sclSpeedHz,
+                       const uint8_t *writeBuffer, size_t writeSize,
+                       uint8_t *readBuffer, size_t readSize);
+
+    void countProbe();
+    void countDevice(bool added);
+
+    Stats stats();
+    void resetStats();
+
+private:
+    SimI2cBus() = default;
+
+    std::mutex mutex;
+    std::map<uint16_t, SimI2cDevice *> devices;
+    bool realTime = true;
+    Stats counters{};
+};
+
+#endif
@@ -0,0 +1,451 @@
+#include "sim_max30102.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+    constexpr uint8_t kIsrStat1 = 0x00;
+    constexpr uint8_t kIsrStat2 = 0x01;
+    constexpr uint8_t kIntrEnable1 = 0x02;
+    constexpr uint8_t kIntrEnable2 = 0x03;
+    constexpr uint8_t kFifoWrPtr = 0x04;
+    constexpr uint8_t kOvfCounter = 0x05;
+    constexpr uint8_t kFifoRdPtr = 0x06;
+    constexpr uint8_t kFifoData = 0x07;
+    constexpr uint8_t kFifoConfig = 0x08;
+    constexpr uint8_t kModeConfig = 0x09;
+    constexpr uint8_t kSpo2Config = 0x0A;
+    constexpr uint8_t kLed1Pa = 0x0C;
+    constexpr uint8_t kLed2Pa = 0x0D;
+    constexpr uint8_t kMultiLed1 = 0x11;
+    constexpr uint8_t kMultiLed2 = 0x12;
+    constexpr uint8_t kRevId = 0xFE;
+    constexpr uint8_t kPartId = 0xFF;
+
+    constexpr uint8_t kStatAlmostFull = 1 << 7;
+    constexpr uint8_t kStatPpgReady = 1 << 6;
+    constexpr uint8_t kStatAlcOverflow = 1 << 5;
+    constexpr uint8_t kStatPowerReady = 1 << 0;
+    constexpr uint8_t kStatDieTempReady = 1 << 1;
+
+    constexpr uint8_t kModeShutdown = 1 << 7;
+    constexpr uint8_t kModeReset = 1 << 6;
+    constexpr uint8_t kModeHeartRate = 0x02;
+    constexpr uint8_t kModeSpo2 = 0x03;
+    constexpr uint8_t kModeMultiLed = 0x07;
+
+    constexpr uint8_t kLedRed = 1;
+    constexpr uint8_t kLedIr = 2;
+
+    constexpr uint8_t kPtrMask = 0x1F;
+    constexpr uint32_t kSampleMax = 0x3FFFF;
+    constexpr double kPi = 3.14159265358979323846;
+
+    constexpr double kSampleRates[8] = {50, 100, 200, 400, 800, 1000, 1600, 3200};
+}
+
+SimMax30102::SimMax30102(gpio_num_t intPin) : intPin(intPin)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    powerOnReset();
+    regs[kIsrStat1] = kStatPowerReady;
+    updateIntLine();
+
+    producer = std::thread(&SimMax30102::producerLoop, this);
+}
+
+SimMax30102::~SimMax30102()
+{
+    running = false;
+    producer.join();
+}
+
+void SimMax30102::setSignal(const Signal &newSignal)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    signal = newSignal;
+}
+
+void SimMax30102::setResetDuration(std::chrono::microseconds duration)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    resetDuration = duration;
+}
+
+double SimMax30102::effectiveSampleRate()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return sampleRateLocked();
+}
+
+bool SimMax30102::isSampling()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return sampleRateLocked() > 0;
+}
+
+SimMax30102::Stats SimMax30102::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void SimMax30102::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counters = Stats{};
+}
+
+bool SimMax30102::acknowledges()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    update(std::chrono::steady_clock::now());
+    return !inReset;
+}
+
+void SimMax30102::write(const uint8_t *data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    update(std::chrono::steady_clock::now());
+
+    regPointer = data[0];
+    for (size_t i = 1; i < size; i++)
+    {
+        writeRegister(regPointer, data[i]);
+        // the register pointer does not advance on FIFO_DATA
+        if (regPointer != kFifoData)
+        {
+            regPointer++;
+        }
+    }
+
+    updateIntLine();
+}
+
+void SimMax30102::read(uint8_t *data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    update(std::chrono::steady_clock::now());
+
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = readRegister(regPointer);
+        if (regPointer != kFifoData)
+        {
+            regPointer++;
+        }
+    }
+
+    updateIntLine();
+}
+
+void SimMax30102::powerOnReset()
+{
+    memset(regs, 0, sizeof(regs));
+    regs[kRevId] = 0x03;
+    regs[kPartId] = 0x15;
+
+    memset(fifo, 0, sizeof(fifo));
+    fifoCount = 0;
+    fifoByteIndex = 0;
+}
+
+void SimMax30102::restartSampling(std::chrono::steady_clock::time_point now)
+{
+    samplingSince = now;
+    producedSinceConfig = 0;
+}
+
+void SimMax30102::update(std::chrono::steady_clock::time_point now)
+{
+    if (inReset && now >= resetDoneAt)
+    {
+        inReset = false;
+        regs[kModeConfig] &= ~kModeReset;
+        restartSampling(now);
+    }
+
+    double rate = sampleRateLocked();
+    if (rate <= 0)
+    {
+        restartSampling(now);
+        return;
+    }
+
+    double elapsed = std::chrono::duration<double>(now - samplingSince).count();
+    uint64_t expected = static_cast<uint64_t>(elapsed * rate);
+    while (producedSinceConfig < expected)
+    {
+        produceSample();
+        producedSinceConfig++;
+    }
+}
+
+double SimMax30102::sampleRateLocked() const
+{
+    uint8_t mode = regs[kModeConfig];
+    if (inReset || (mode & kModeShutdown) || bytesPerSampleLocked() == 0)
+    {
+        return 0;
+    }
+
+    uint8_t averaging = regs[kFifoConfig] >> 5;
+    double samplesAveraged = (averaging >= 5) ? 32 : (1 << averaging);
+    return kSampleRates[(regs[kSpo2Config] >> 2) & 0x07] / samplesAveraged;
+}
+
+size_t SimMax30102::bytesPerSampleLocked() const
+{
+    switch (regs[kModeConfig] & 0x07)
+    {
+    case kModeHeartRate:
+        return 3;
+    case kModeSpo2:
+        return 6;
+    case kModeMultiLed:
+    {
+        const uint8_t slots[4] = {
+            static_cast<uint8_t>(regs[kMultiLed1] & 0x07), static_cast<uint8_t>((regs[kMultiLed1] >> 4) & 0x07),
+            static_cast<uint8_t>(regs[kMultiLed2] & 0x07), static_cast<uint8_t>((regs[kMultiLed2] >> 4) & 0x07)};
+        size_t bytes = 0;
+        // active slots are packed from slot 1, the first disabled one ends the sequence
+        for (uint8_t slot : slots)
+        {
+            if (slot == 0)
+            {
+                break;
+            }
+            bytes += 3;
+        }
+        return bytes;
+    }
+    default:
+        return 0;
+    }
+}
+
+void SimMax30102::produceSample()
+{
+    double t = static_cast<double>(sampleIndex++) / sampleRateLocked();
+
+    uint8_t leds[4] = {0};
+    size_t numLeds = 0;
+    switch (regs[kModeConfig] & 0x07)
+    {
+    case kModeHeartRate:
+        leds[numLeds++] = kLedRed;
+        break;
+    case kModeSpo2:
+        leds[numLeds++] = kLedRed;
+        leds[numLeds++] = kLedIr;
+        break;
+    default:
+        for (size_t slot = 0; slot < bytesPerSampleLocked() / 3; slot++)
+        {
+            uint8_t config = (slot < 2) ? regs[kMultiLed1] : regs[kMultiLed2];
+            leds[numLeds++] = (slot % 2 == 0) ? (config & 0x07) : ((config >> 4) & 0x07);
+        }
+        break;
+    }
+
+    counters.produced++;
+
+    if (fifoCount == kFifoDepth)
+    {
+        regs[kOvfCounter] = (regs[kOvfCounter] < kPtrMask) ? regs[kOvfCounter] + 1 : kPtrMask;
+        counters.lost++;
+
+        // without rollover the new sample is dropped, with rollover the oldest is overwritten
+        if ((regs[kFifoConfig] & (1 << 4)) == 0)
+        {
+            return;
+        }
+        regs[kFifoRdPtr] = (regs[kFifoRdPtr] + 1) & kPtrMask;
+        fifoCount--;
+        fifoByteIndex = 0;
+    }
+
+    uint8_t *entry = fifo[regs[kFifoWrPtr]];
+    for (size_t i = 0; i < numLeds; i++)
+    {
+        uint32_t value = channelValue(leds[i], t);
+        entry[i * 3 + 0] = static_cast<uint8_t>(value >> 16);
+        entry[i * 3 + 1] = static_cast<uint8_t>(value >> 8);
+        entry[i * 3 + 2] = static_cast<uint8_t>(value);
+    }
+    regs[kFifoWrPtr] = (regs[kFifoWrPtr] + 1) & kPtrMask;
+    fifoCount++;
+
+    regs[kIsrStat1] |= kStatPpgReady;
+    if (fifoCount == kFifoDepth - (regs[kFifoConfig] & 0x0F))
+    {
+        regs[kIsrStat1] |= kStatAlmostFull;
+    }
+}
+
+uint32_t SimMax30102::channelValue(uint8_t led, double t)
+{
+    if (led != kLedRed && led != kLedIr)
+    {
+        return 0;
+    }
+
+    // systolic upstroke plus a dicrotic notch, roughly unit amplitude
+    double phase = 2 * kPi * t * signal.heartRateBpm / 60.0;
+    double pulse = 0.6 * sin(phase) + 0.25 * sin(2 * phase) + 0.1 * sin(3 * phase);
+
+    bool red = (led == kLedRed);
+    double current = (red ? regs[kLed1Pa] : regs[kLed2Pa]) / 31.0;
+    double dc = (red ? signal.redDc : signal.irDc) * current;
+    double perfusion = red ? signal.perfusion * signal.ratio : signal.perfusion;
+
+    double value = dc * (1.0 - 0.5 * perfusion * pulse) + noise();
+    if (value < 0)
+    {
+        value = 0;
+    }
+    if (value > kSampleMax)
+    {
+        value = kSampleMax;
+        regs[kIsrStat1] |= kStatAlcOverflow;
+    }
+
+    // lower pulse widths give less resolution, data stays left justified
+    uint32_t resolution = 15 + (regs[kSpo2Config] & 0x03);
+    return static_cast<uint32_t>(value) & ~((1U << (18 - resolution)) - 1);
+}
+
+double SimMax30102::noise()
+{
+    // sum of uniforms, close enough to gaussian for a test signal
+    double sum = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        noiseState = noiseState * 1664525U + 1013904223U;
+        sum += (noiseState >> 8) / 16777216.0 - 0.5;
+    }
+    return sum * signal.noise * 1.7320508;
+}
+
+uint8_t SimMax30102::readRegister(uint8_t reg)
+{
+    uint8_t value = regs[reg];
+
+    switch (reg)
+    {
+    case kIsrStat1:
+        // status bits clear on read
+        regs[kIsrStat1] = 0;
+        break;
+    case kIsrStat2:
+        regs[kIsrStat2] = 0;
+        break;
+    case kFifoData:
+    {
+        if (fifoCount == 0)
+        {
+            return 0;
+        }
+        value = fifo[regs[kFifoRdPtr]][fifoByteIndex++];
+        if (fifoByteIndex == bytesPerSampleLocked())
+        {
+            fifoByteIndex = 0;
+            regs[kFifoRdPtr] = (regs[kFifoRdPtr] + 1) & kPtrMask;
+            fifoCount--;
+            counters.drained++;
+            // popping a complete sample clears the overflow counter
+            regs[kOvfCounter] = 0;
+            regs[kIsrStat1] &= ~kStatAlmostFull;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    return value;
+}
+
+void SimMax30102::writeRegister(uint8_t reg, uint8_t value)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // the rest of a burst that started the reset is dropped
+    if (inReset)
+    {
+        return;
+    }
+
+    switch (reg)
+    {
+    case kIsrStat1:
+    case kIsrStat2:
+    case kFifoData:
+    case kRevId:
+    case kPartId:
+        break;
+    case kFifoWrPtr:
+    case kFifoRdPtr:
+    case kOvfCounter:
+        regs[reg] = value & kPtrMask;
+        fifoCount = (regs[kFifoWrPtr] - regs[kFifoRdPtr]) & kPtrMask;
+        fifoByteIndex = 0;
+        break;
+    case kModeConfig:
+        if (value & kModeReset)
+        {
+            powerOnReset();
+            regs[kModeConfig] = kModeReset;
+            inReset = true;
+            resetDoneAt = now + resetDuration;
+            counters.resets++;
+        }
+        else
+        {
+            regs[kModeConfig] = value;
+        }
+        restartSampling(now);
+        break;
+    case kFifoConfig:
+    case kSpo2Config:
+    case kMultiLed1:
+    case kMultiLed2:
+        regs[reg] = value;
+        restartSampling(now);
+        break;
+    default:
+        regs[reg] = value;
+        break;
+    }
+}
+
+void SimMax30102::updateIntLine()
+{
+    bool asserted = (regs[kIsrStat1] & regs[kIntrEnable1] & (kStatAlmostFull | kStatPpgReady | kStatAlcOverflow)) ||
+                    (regs[kIsrStat1] & kStatPowerReady) ||
+                    (regs[kIsrStat2] & regs[kIntrEnable2] & kStatDieTempReady);
+
+    if (asserted != intAsserted)
+    {
+        intAsserted = asserted;
+        if (intPin != GPIO_NUM_NC)
+        {
+            // open drain, active low
+            sim_gpio_set_level(intPin, asserted ? 0 : 1);
+        }
+    }
+}
+
+void SimMax30102::producerLoop()
+{
+    while (running)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            update(std::chrono::steady_clock::now());
+            updateIntLine();
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(250));
+    }
+}
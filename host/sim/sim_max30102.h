@@ -0,0 +1,108 @@
+#ifndef SIM_MAX30102_H
+#define SIM_MAX30102_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "driver/gpio.h"
+#include "sim_i2c.h"
+
+/// @brief Register level model of the MAX30102.
+/// Models the 32 sample FIFO with FIFO_WR_PTR/FIFO_RD_PTR/OVF_COUNTER, rollover,
+/// the almost full/new data/power ready interrupts with the INT line, the
+/// MODE_CONFIG reset and shutdown bits, and produces samples in real time at the
+/// rate selected by SPO2_CONFIG and FIFO_CONFIG.
+class SimMax30102 : public SimI2cDevice
+{
+public:
+    static constexpr uint16_t kAddress = 0x57U;
+
+    /// @brief Synthetic PPG the model puts into the FIFO
+    struct Signal
+    {
+        double heartRateBpm = 72.0;
+        // (AC/DC red) / (AC/DC ir), 0.6 is roughly 97 % SpO2 on the Maxim curve
+        double ratio = 0.6;
+        // AC/DC of the ir channel
+        double perfusion = 0.02;
+        double irDc = 120000.0;
+        double redDc = 100000.0;
+        // standard deviation of additive noise in ADC counts
+        double noise = 20.0;
+    };
+
+    struct Stats
+    {
+        uint64_t produced;
+        uint64_t drained;
+        uint64_t lost;
+        uint64_t resets;
+    };
+
+    SimMax30102(gpio_num_t intPin = GPIO_NUM_NC);
+    virtual ~SimMax30102();
+
+    /// @brief NACKs its address until a reset is finished, like the part does
+    bool acknowledges() override;
+    void write(const uint8_t *data, size_t size) override;
+    void read(uint8_t *data, size_t size) override;
+
+    void setSignal(const Signal &signal);
+    void setResetDuration(std::chrono::microseconds duration);
+
+    /// @brief Samples per second written into the FIFO with the current configuration, 0 if idle
+    double effectiveSampleRate();
+    bool isSampling();
+
+    Stats stats();
+    void resetStats();
+
+private:
+    static constexpr size_t kFifoDepth = 32U;
+    static constexpr size_t kMaxBytesPerSample = 12U;
+
+    const gpio_num_t intPin;
+
+    std::mutex mutex;
+    uint8_t regs[256];
+    uint8_t regPointer = 0;
+    uint8_t fifo[kFifoDepth][kMaxBytesPerSample];
+    size_t fifoCount = 0;
+    size_t fifoByteIndex = 0;
+    bool intAsserted = false;
+
+    Signal signal;
+    uint64_t sampleIndex = 0;
+    uint32_t noiseState = 0x12345678U;
+
+    std::chrono::microseconds resetDuration{1000};
+    std::chrono::steady_clock::time_point resetDoneAt;
+    std::chrono::steady_clock::time_point samplingSince;
+    uint64_t producedSinceConfig = 0;
+    bool inReset = false;
+
+    Stats counters{};
+
+    std::atomic<bool> running{true};
+    std::thread producer;
+
+    void powerOnReset();
+    void restartSampling(std::chrono::steady_clock::time_point now);
+    void update(std::chrono::steady_clock::time_point now);
+    double sampleRateLocked() const;
+    size_t bytesPerSampleLocked() const;
+    void produceSample();
+    uint32_t channelValue(uint8_t led, double t);
+    double noise();
+    uint8_t readRegister(uint8_t reg);
+    void writeRegister(uint8_t reg, uint8_t value);
+    void updateIntLine();
+    void producerLoop();
+};
+
+#endif
@@ -0,0 +1,439 @@
+// Runs the sensor task against the simulated MAX30102 and reports, per sample rate,
+// how many samples the pipeline keeps up with and what it costs in bus and CPU time.
+//
+// usage: max30102_sim [--seconds N] [--rate HZ] [--averaging N] [--signal NAME] [--raw MTU] [--profile] [--verbose]
+//
+// --signal picks the PPG of the model: finger (default), none, weak, noisy. The results
+// column counts all results, skipped those the signal quality gate answered without
+// running the algorithm. --raw packs the raw samples as main.cpp does for a peer with
+// this ATT MTU and checks the packets for gaps.
+//
+// After the table a part slow to come out of reset and one stuck in reset check that the
+// sensor task retries the start and then gives the run up.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "sensor_task.h"
+#include "sensor_profiler.h"
+#include "ble_ppg_packetizer.h"
+#include "sim_i2c.h"
+#include "sim_max30102.h"
+
+QueueHandle_t SensorCommandsQueueHandle;
+QueueHandle_t SensorResultsQueueHandle;
+QueueHandle_t SensorRawQueueHandle = nullptr;
+
+namespace
+{
+    struct RateOption
+    {
+        unsigned hz;
+        Regs::Spo2SampleRate rate;
+    };
+
+    constexpr RateOption kRates[] = {
+        {50, Regs::Spo2SampleRate::MAX30102_SPO2_SAMPLE_RATE_50_HZ},
+        {100, Regs::Spo2SampleRate::MAX30102_SPO2_SAMPLE_RATE_100_HZ},
+        {200, Regs::Spo2SampleRate::MAX30102_SPO2_SAMPLE_RATE_200_HZ},
+        {400, Regs::Spo2SampleRate::MAX30102_SPO2_SAMPLE_RATE_400_HZ},
+        {800, Regs::Spo2SampleRate::MAX30102_SPO2_SAMPLE_RATE_800_HZ},
+        {1000, Regs::Spo2SampleRate::MAX30102_SPO2_SAMPLE_RATE_1000_HZ},
+        {1600, Regs::Spo2SampleRate::MAX30102_SPO2_SAMPLE_RATE_1600_HZ},
+        {3200, Regs::Spo2SampleRate::MAX30102_SPO2_SAMPLE_RATE_3200_HZ},
+    };
+
+    Regs::SampleAveraging averagingFromCount(unsigned count)
+    {
+        switch (count)
+        {
+        case 1:
+            return Regs::SampleAveraging::MAX30102_SAMPLE_AVERAGING_1;
+        case 2:
+            return Regs::SampleAveraging::MAX30102_SAMPLE_AVERAGING_2;
+        case 4:
+            return Regs::SampleAveraging::MAX30102_SAMPLE_AVERAGING_4;
+        case 8:
+            return Regs::SampleAveraging::MAX30102_SAMPLE_AVERAGING_8;
+        case 16:
+            return Regs::SampleAveraging::MAX30102_SAMPLE_AVERAGING_16;
+        default:
+            return Regs::SampleAveraging::MAX30102_SAMPLE_AVERAGING_32;
+        }
+    }
+
+    struct SignalOption
+    {
+        const char *name;
+        SimMax30102::Signal signal;
+    };
+
+    SimMax30102::Signal makeSignal(double irDc, double perfusion, double noise)
+    {
+        SimMax30102::Signal signal;
+        signal.irDc = irDc;
+        signal.redDc = irDc * 5.0 / 6.0;
+        signal.perfusion = perfusion;
+        signal.noise = noise;
+        return signal;
+    }
+
+    const SignalOption kSignals[] = {
+        {"finger", SimMax30102::Signal{}},
+        // light scattered back without tissue
+        {"none", makeSignal(3000.0, 0.0, 20.0)},
+        {"weak", makeSignal(120000.0, 0.0005, 20.0)},
+        {"noisy", makeSignal(120000.0, 0.02, 1500.0)},
+    };
+
+    TaskHandle_t sensorTask = nullptr;
+
+    // same as ble_ctrl_char_write_callback: queue the command and wake the task
+    void sendCommand(SensorCommands command)
+    {
+        xQueueSend(SensorCommandsQueueHandle, &command, portMAX_DELAY);
+        xTaskNotifyGive(sensorTask);
+    }
+
+    struct RunReport
+    {
+        unsigned rateHz;
+        double sps;
+        SimMax30102::Stats sensor;
+        SimI2cBus::Stats bus;
+        // probes and attaches of the run command, counted before the measurement starts
+        SimI2cBus::Stats startBus;
+        uint64_t cpuUs;
+        double startMs;
+        unsigned results;
+        unsigned skipped;
+        // raw stream packets, their frames, and packets after lost samples
+        unsigned rawPackets;
+        uint64_t rawFrames;
+        unsigned rawGaps;
+    };
+
+    // what a raw stream receiver gets: packets checked against the sample index
+    struct RawReceiver
+    {
+        PpgPacketizer packetizer;
+        uint32_t expectedIndex = 0;
+
+        void receive(RunReport &report)
+        {
+            uint16_t sequence = 0;
+            uint32_t firstIndex = 0;
+            size_t numFrames = 0;
+            if (!PpgPacketizer::parse(packetizer.data(), packetizer.size(), sequence, firstIndex, numFrames))
+            {
+                return;
+            }
+            report.rawGaps += (report.rawPackets != 0 && firstIndex != expectedIndex) ? 1U : 0U;
+            report.rawPackets++;
+            report.rawFrames += numFrames;
+            expectedIndex = firstIndex + static_cast<uint32_t>(numFrames);
+        }
+
+        void drain(RunReport &report)
+        {
+            RawFifoChunk chunk;
+            while (xQueueReceive(SensorRawQueueHandle, &chunk, 0))
+            {
+                size_t done = 0;
+                while (done < chunk.numSamples)
+                {
+                    done += packetizer.append(chunk.firstIndex + done,
+                                              chunk.data + done * RawFifoChunk::kBytesPerSample,
+                                              chunk.numSamples - done);
+                    if (packetizer.ready())
+                    {
+                        receive(report);
+                        packetizer.take();
+                    }
+                }
+            }
+        }
+    };
+
+    RunReport runAtRate(SimMax30102 &sensor, TaskHandle_t task, const RateOption &rate,
+                        unsigned averaging, double seconds, uint16_t rawMtu)
+    {
+        SensorConfigStruct config;
+        config.sampleRate = rate.rate;
+        config.sampleAverage = averagingFromCount(averaging);
+        SensorTaskSetConfig(config);
+
+        auto started = std::chrono::steady_clock::now();
+        sendCommand(SensorCommands::SENSOR_RUN);
+        while (!sensor.isSampling())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        RunReport report{};
+        report.rateHz = rate.hz;
+        report.startMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        report.sps = sensor.effectiveSampleRate();
+        report.startBus = SimI2cBus::instance().stats();
+
+        sensor.resetStats();
+        SimI2cBus::instance().resetStats();
+        uint64_t cpuBefore = sim_task_cpu_time_us(task);
+
+        RawReceiver raw;
+        raw.packetizer.setMtu(rawMtu);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            SensorResult result;
+            if (xQueueReceive(SensorResultsQueueHandle, &result, pdMS_TO_TICKS(10)))
+            {
+                report.results++;
+                if (result.quality != SignalQualityCode::GOOD && result.quality != SignalQualityCode::NO_ESTIMATE)
+                {
+                    report.skipped++;
+                }
+            }
+            if (SensorRawQueueHandle != nullptr)
+            {
+                raw.drain(report);
+            }
+        }
+
+        report.cpuUs = sim_task_cpu_time_us(task) - cpuBefore;
+        report.sensor = sensor.stats();
+        report.bus = SimI2cBus::instance().stats();
+
+        sendCommand(SensorCommands::SENDOR_STOP);
+        // let the task process the stop before the next configuration
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (SensorRawQueueHandle != nullptr)
+        {
+            // the bursts of the stop, the next run starts at index 0 again
+            RunReport ignored{};
+            raw.drain(ignored);
+        }
+        return report;
+    }
+
+    template <typename Predicate>
+    bool waitFor(Predicate done, unsigned timeoutMs)
+    {
+        for (unsigned ms = 0; ms < timeoutMs && !done(); ms++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return done();
+    }
+
+    // the model NACKs every transfer while it resets. A stop NACKed that way still ends the
+    // run, a start NACKed that way is retried once the part answers again, and a part that
+    // never comes back ends the run.
+    void checkResetTimeout(SimMax30102 &sensor)
+    {
+        SensorTaskSetConfig(SensorConfigStruct());
+
+        // shorter than one attempt, long enough to stop in the middle of it
+        sensor.setResetDuration(std::chrono::milliseconds(80));
+        sendCommand(SensorCommands::SENSOR_RUN);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        sendCommand(SensorCommands::SENDOR_STOP);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        bool stoppedInReset = !sensor.isSampling() && !SensorTaskIsRunning();
+
+        // the stop starts nothing new, so the reset of the run before is still going
+        sendCommand(SensorCommands::SENSOR_RUN);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        sendCommand(SensorCommands::SENDOR_STOP);
+        waitFor([]()
+                { return !SensorTaskIsRunning(); }, 50U);
+        auto started = std::chrono::steady_clock::now();
+        sendCommand(SensorCommands::SENSOR_RUN);
+        bool recovered = waitFor([&sensor]()
+                                 { return sensor.isSampling(); }, 2000U) &&
+                         SensorTaskIsRunning();
+        double startMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        sendCommand(SensorCommands::SENDOR_STOP);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        sensor.setResetDuration(std::chrono::milliseconds(5000));
+        started = std::chrono::steady_clock::now();
+        sendCommand(SensorCommands::SENSOR_RUN);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        bool gaveUp = waitFor([]()
+                              { return !SensorTaskIsRunning(); }, 2000U);
+        double giveUpMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        sensor.setResetDuration(std::chrono::microseconds(1000));
+
+        printf("reset timeout: stop during reset %s, start NACKed in reset %s after %.0f ms, stuck part %s after %.0f ms\n",
+               stoppedInReset ? "idle" : "NOT idle", recovered ? "running" : "NOT running", startMs,
+               gaveUp ? "given up" : "NOT given up", giveUpMs);
+    }
+
+    // the same table SensorProfiler::dump() logs on target, summed over all runs
+    void printProfile()
+    {
+        printf("%-12s %8s %10s %10s %10s   histogram (<%.2f us, then doubling)\n", "stage", "count", "min_us",
+               "mean_us", "max_us", double(1U << SensorProfiler::kBucketShift) / SensorProfiler::kTicksPerUs);
+        for (size_t i = 0; i < static_cast<size_t>(ProfileStage::COUNT); i++)
+        {
+            ProfileStage stage = static_cast<ProfileStage>(i);
+            ProfileStats stats = SensorProfiler::stats(stage);
+            if (stats.count == 0)
+            {
+                continue;
+            }
+            printf("%-12s %8lu %10.2f %10.2f %10.2f  ", SensorProfiler::name(stage), (unsigned long)stats.count,
+                   double(stats.min) / SensorProfiler::kTicksPerUs, double(stats.mean()) / SensorProfiler::kTicksPerUs,
+                   double(stats.max) / SensorProfiler::kTicksPerUs);
+            size_t used = ProfileStats::kBuckets;
+            while (used > 1 && stats.histogram[used - 1] == 0)
+            {
+                used--;
+            }
+            for (size_t b = 0; b < used; b++)
+            {
+                printf(" %lu", (unsigned long)stats.histogram[b]);
+            }
+            printf("\n");
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 3.0;
+    unsigned onlyRate = 0;
+    unsigned averaging = 1;
+    bool profile = false;
+    uint16_t rawMtu = 0;
+    const SignalOption *signal = &kSignals[0];
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+        {
+            onlyRate = static_cast<unsigned>(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--averaging") == 0 && i + 1 < argc)
+        {
+            averaging = static_cast<unsigned>(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--signal") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            signal = nullptr;
+            for (const SignalOption &option : kSignals)
+            {
+                if (strcmp(option.name, name) == 0)
+                {
+                    signal = &option;
+                }
+            }
+            if (signal == nullptr)
+            {
+                fprintf(stderr, "unknown signal %s\n", name);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--raw") == 0 && i + 1 < argc)
+        {
+            rawMtu = static_cast<uint16_t>(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            profile = true;
+        }
+        else if (strcmp(argv[i], "--verbose") == 0)
+        {
+            esp_log_level_set("*", ESP_LOG_INFO);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--seconds N] [--rate HZ] [--averaging N] [--signal NAME] [--raw MTU] [--profile] [--verbose]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    SimMax30102 sensor(GPIO_NUM_19);
+    sensor.setSignal(signal->signal);
+    SimI2cBus::instance().attach(SimMax30102::kAddress, &sensor);
+
+    SensorCommandsQueueHandle = xQueueCreate(16U, sizeof(uint32_t));
+    SensorResultsQueueHandle = xQueueCreate(16U, sizeof(SensorResult));
+    if (rawMtu != 0)
+    {
+        SensorRawQueueHandle = xQueueCreate(8U, sizeof(RawFifoChunk));
+    }
+
+    xTaskCreate(SensorTask, "SnsTask", 4096U, nullptr, tskIDLE_PRIORITY, &sensorTask);
+
+    printf("%8s %8s %9s %9s %8s %9s %9s %10s %8s %8s %9s\n",
+           "rate_hz", "sps", "produced", "drained", "lost", "bus_busy%", "task_cpu%", "us/sample", "results", "skipped",
+           "start_ms");
+
+    unsigned maxSustainable = 0;
+    unsigned runs = 0;
+    uint64_t probes = 0;
+    uint64_t devicesAdded = 0;
+    for (const RateOption &rate : kRates)
+    {
+        if (onlyRate != 0 && rate.hz != onlyRate)
+        {
+            continue;
+        }
+
+        RunReport r = runAtRate(sensor, sensorTask, rate, averaging, seconds, rawMtu);
+        runs++;
+        probes += r.startBus.probes;
+        devicesAdded += r.startBus.devicesAdded;
+        double busyPercent = 100.0 * r.bus.busyUs / (seconds * 1e6);
+        double cpuPercent = 100.0 * r.cpuUs / (seconds * 1e6);
+        double usPerSample = r.sensor.drained ? static_cast<double>(r.cpuUs) / r.sensor.drained : 0;
+
+        printf("%8u %8.1f %9llu %9llu %8llu %9.1f %9.2f %10.2f %8u %8u %9.1f\n",
+               r.rateHz, r.sps,
+               (unsigned long long)r.sensor.produced, (unsigned long long)r.sensor.drained,
+               (unsigned long long)r.sensor.lost, busyPercent, cpuPercent, usPerSample, r.results, r.skipped, r.startMs);
+        if (rawMtu != 0)
+        {
+            printf("%8s raw stream: %u packets of %zu frames at MTU %u, %llu frames, %u gaps, %.0f B/s\n", "",
+                   r.rawPackets, PpgPacketizer(rawMtu).framesPerPacket(), rawMtu, (unsigned long long)r.rawFrames,
+                   r.rawGaps, (r.rawPackets * PpgPacketizer::kHeaderSize + r.rawFrames * PpgPacketizer::kFrameSize) / seconds);
+        }
+
+        if (r.sensor.lost == 0 && r.sensor.drained != 0)
+        {
+            maxSustainable = rate.hz;
+        }
+    }
+
+    printf("max sustainable sample rate (averaging %u): %u Hz\n", averaging, maxSustainable);
+    printf("i2c device attaches: %llu, probes: %llu over %u run/stop cycles\n",
+           (unsigned long long)devicesAdded, (unsigned long long)probes, runs);
+    checkResetTimeout(sensor);
+    if (profile)
+    {
+        printProfile();
+    }
+    fflush(stdout);
+
+    // the sensor task never returns, leave without running static destructors under it
+    _Exit(0);
+}
@@ -0,0 +1,579 @@
+// Benchmark of the SpO2/HR engines on synthetic and recorded PPG.
+//
+// Every engine is evaluated once per second of signal after the first 5 s:
+//   generic    Max30102::calculate with the generic algorithm, BUFFER_SIZE samples at FS
+//   window     Max30102::calculate with the specialized window for the sample rate
+//   window500  Spo2Window<100, 500>, the specialized kernel in the original configuration
+//   stream     Spo2Stream, pushed every sample, the latest estimate is read
+//
+// Reports per signal and engine: valid estimates, mean heart rate and SpO2 error against
+// the truth, ns per window (per estimate for the stream), ns per sample (ns/window over the
+// window length, per pushed sample for the stream) and heap allocations while running.
+//
+//   ./build-host/spo2_bench                              # default synthetic matrix
+//   ./build-host/spo2_bench --rate 100 --hr 45,180 --noise 80 --wander 0.01
+//   ./build-host/spo2_bench --file recording.txt --no-synthetic
+//   ./build-host/spo2_bench --write case.txt --rate 100 --hr 72 --spo2 95
+//   ./build-host/spo2_bench --gate window=40 --gate stream=60   # exit 1 above ns/sample
+//
+// Recorded files hold one "red ir" frame per line (space, tab, comma or semicolon
+// separated). Lines starting with # may carry rate=<Hz>, hr=<bpm> and spo2=<%>; without a
+// rate the file is taken as 100 Hz, without hr/spo2 no errors are reported for it.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "sensor.h"
+
+namespace
+{
+    std::atomic<uint64_t> allocations{0};
+}
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size != 0 ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr uint32_t kWarmupSeconds = 5U;
+
+    struct Signal
+    {
+        std::string name;
+        uint32_t rate;
+        std::vector<uint32_t> red;
+        std::vector<uint32_t> ir;
+        bool hasTruth;
+        double heartRate;
+        double spo2;
+    };
+
+    struct Estimate
+    {
+        int32_t heartRate;
+        int32_t spo2;
+        bool valid;
+    };
+
+    struct Stats
+    {
+        uint64_t estimates = 0;
+        uint64_t valid = 0;
+        uint64_t scored = 0;
+        double heartRateError = 0;
+        double spo2Error = 0;
+        double ns = 0;
+        uint64_t samples = 0; // window lengths, or pushed samples for the stream
+        uint64_t allocations = 0;
+
+        void add(const Stats &other)
+        {
+            estimates += other.estimates;
+            valid += other.valid;
+            scored += other.scored;
+            heartRateError += other.heartRateError;
+            spo2Error += other.spo2Error;
+            ns += other.ns;
+            samples += other.samples;
+            allocations += other.allocations;
+        }
+    };
+
+    // ratio of the red to the ir modulation that gives this SpO2 on the decreasing side of
+    // uch_spo2_table, which is -45.060 * r^2 + 30.354 * r + 94.845
+    double ratioForSpo2(double spo2)
+    {
+        double d = 30.354 * 30.354 + 4.0 * 45.060 * (94.845 - spo2);
+        return (30.354 + sqrt(d > 0 ? d : 0)) / (2.0 * 45.060);
+    }
+
+    Signal synthesize(uint32_t rate, double heartRate, double spo2, double noise, double wander, uint32_t seconds)
+    {
+        char name[96];
+        snprintf(name, sizeof(name), "%luHz %.0fbpm %.0f%% n%.0f w%.3f",
+                 (unsigned long)rate, heartRate, spo2, noise, wander);
+        Signal signal{name, rate, {}, {}, true, heartRate, spo2};
+
+        uint32_t seed = 0x2468ACE1U ^ static_cast<uint32_t>(heartRate * 7.0 + spo2 * 131.0 + noise);
+        auto gaussian = [&seed](double sigma)
+        {
+            double sum = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                seed = seed * 1664525U + 1013904223U;
+                sum += (seed >> 8) / 16777216.0 - 0.5;
+            }
+            return sum * sigma * 1.7;
+        };
+
+        const double ratio = ratioForSpo2(spo2);
+        const double perfusion = 0.02;
+        for (uint32_t n = 0; n < seconds * rate; n++)
+        {
+            double t = static_cast<double>(n) / rate;
+            double phase = 2 * kPi * t * heartRate / 60.0;
+            double pulse = 0.6 * sin(phase) + 0.25 * sin(2 * phase) + 0.1 * sin(3 * phase);
+            double baseline = 1.0 + wander * sin(2 * kPi * 0.2 * t) + 0.5 * wander * sin(2 * kPi * 0.07 * t + 1.0);
+            signal.ir.push_back(static_cast<uint32_t>(120000.0 * baseline * (1.0 - 0.5 * perfusion * pulse) + gaussian(noise)));
+            signal.red.push_back(static_cast<uint32_t>(100000.0 * baseline * (1.0 - 0.5 * perfusion * ratio * pulse) + gaussian(noise)));
+        }
+        return signal;
+    }
+
+    bool load(const char *path, Signal &signal)
+    {
+        FILE *file = fopen(path, "r");
+        if (file == nullptr)
+        {
+            fprintf(stderr, "cannot open %s\n", path);
+            return false;
+        }
+
+        signal = Signal{path, 100U, {}, {}, false, 0, 0};
+        bool hasHeartRate = false;
+        bool hasSpo2 = false;
+        char line[256];
+        while (fgets(line, sizeof(line), file) != nullptr)
+        {
+            if (line[0] == '#')
+            {
+                for (char *token = strtok(line + 1, " \t\r\n,"); token != nullptr; token = strtok(nullptr, " \t\r\n,"))
+                {
+                    if (strncmp(token, "rate=", 5) == 0)
+                    {
+                        signal.rate = static_cast<uint32_t>(atoi(token + 5));
+                    }
+                    else if (strncmp(token, "hr=", 3) == 0)
+                    {
+                        signal.heartRate = atof(token + 3);
+                        hasHeartRate = true;
+                    }
+                    else if (strncmp(token, "spo2=", 5) == 0)
+                    {
+                        signal.spo2 = atof(token + 5);
+                        hasSpo2 = true;
+                    }
+                }
+                continue;
+            }
+            unsigned long red = 0;
+            unsigned long ir = 0;
+            if (sscanf(line, "%lu%*[ \t,;]%lu", &red, &ir) == 2)
+            {
+                signal.red.push_back(static_cast<uint32_t>(red));
+                signal.ir.push_back(static_cast<uint32_t>(ir));
+            }
+        }
+        fclose(file);
+        signal.hasTruth = hasHeartRate && hasSpo2;
+        return !signal.ir.empty();
+    }
+
+    bool save(const char *path, const Signal &signal)
+    {
+        FILE *file = fopen(path, "w");
+        if (file == nullptr)
+        {
+            fprintf(stderr, "cannot write %s\n", path);
+            return false;
+        }
+        fprintf(file, "# %s\n# rate=%lu hr=%.1f spo2=%.1f\n", signal.name.c_str(), (unsigned long)signal.rate,
+                signal.heartRate, signal.spo2);
+        for (size_t n = 0; n < signal.ir.size(); n++)
+        {
+            fprintf(file, "%lu %lu\n", (unsigned long)signal.red[n], (unsigned long)signal.ir[n]);
+        }
+        fclose(file);
+        return true;
+    }
+
+    void score(Stats &stats, const Signal &signal, const Estimate &estimate)
+    {
+        stats.estimates++;
+        if (!estimate.valid)
+        {
+            return;
+        }
+        stats.valid++;
+        if (signal.hasTruth)
+        {
+            stats.scored++;
+            stats.heartRateError += fabs(estimate.heartRate - signal.heartRate);
+            stats.spo2Error += fabs(estimate.spo2 - signal.spo2);
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    double elapsedNs(Clock::time_point begin, Clock::time_point end)
+    {
+        return std::chrono::duration<double, std::nano>(end - begin).count();
+    }
+
+    /// @brief One calculation over length samples at every evaluation point
+    template <typename Calculate>
+    Stats runBatch(Signal &signal, uint32_t length, Calculate calculate)
+    {
+        Stats stats;
+        const uint64_t before = allocations.load();
+        for (size_t end = kWarmupSeconds * signal.rate; end <= signal.ir.size(); end += signal.rate)
+        {
+            if (end < length)
+            {
+                continue;
+            }
+            Clock::time_point begin = Clock::now();
+            Estimate estimate = calculate(&signal.red[end - length], &signal.ir[end - length]);
+            stats.ns += elapsedNs(begin, Clock::now());
+            stats.samples += length;
+            score(stats, signal, estimate);
+        }
+        stats.allocations = allocations.load() - before;
+        return stats;
+    }
+
+    Stats runStream(Signal &signal, Spo2Stream &stream)
+    {
+        Stats stats;
+        const uint64_t before = allocations.load();
+        stream.setSampleRate(signal.rate);
+        const size_t first = kWarmupSeconds * signal.rate;
+        size_t n = 0;
+        for (size_t end = first; end <= signal.ir.size(); end += signal.rate)
+        {
+            Clock::time_point begin = Clock::now();
+            for (; n < end; n++)
+            {
+                stream.push(signal.red[n], signal.ir[n]);
+            }
+            stats.ns += elapsedNs(begin, Clock::now());
+            const Spo2StreamResult &result = stream.result();
+            score(stats, signal, Estimate{result.heartRate, result.spo2, result.heartRateValid && result.spo2Valid});
+        }
+        stats.samples = n;
+        stats.allocations = allocations.load() - before;
+        return stats;
+    }
+
+    struct Engine
+    {
+        const char *name;
+        Stats total;
+        double gateNsPerSample; // 0 for no gate
+    };
+
+    struct Engines
+    {
+        std::unique_ptr<SensorAlgorithmContext> context = std::make_unique<SensorAlgorithmContext>();
+        std::unique_ptr<Spo2WindowContext<BUFFER_SIZE>> context500 = std::make_unique<Spo2WindowContext<BUFFER_SIZE>>();
+        std::unique_ptr<Spo2Stream> stream = std::make_unique<Spo2Stream>();
+        Engine list[4] = {{"generic", {}, 0}, {"window", {}, 0}, {"window500", {}, 0}, {"stream", {}, 0}};
+
+        Engine *find(const char *name)
+        {
+            for (Engine &engine : list)
+            {
+                if (strcmp(engine.name, name) == 0)
+                {
+                    return &engine;
+                }
+            }
+            return nullptr;
+        }
+
+        /// @brief Window length of an engine at this rate, 0 if it does not apply
+        uint32_t length(size_t index, uint32_t rate) const
+        {
+            const Spo2WindowVariant *variant = findSpo2Window(rate);
+            switch (index)
+            {
+            case 0:
+                return rate == FS ? BUFFER_SIZE : 0U;
+            case 1:
+                return variant != nullptr ? variant->windowLength : 0U;
+            case 2:
+                return rate == FS ? BUFFER_SIZE : 0U;
+            default:
+                return 1U;
+            }
+        }
+
+        Stats run(size_t index, Signal &signal)
+        {
+            const uint32_t windowLength = length(index, signal.rate);
+            const Spo2WindowVariant *variant = findSpo2Window(signal.rate);
+            auto fromResult = [](SensorResult result)
+            {
+                return Estimate{result.pulse, result.saturation, result.pulse >= 0 && result.saturation >= 0};
+            };
+
+            switch (index)
+            {
+            case 0:
+                return runBatch(signal, windowLength, [this, windowLength, &fromResult](uint32_t *red, uint32_t *ir)
+                                { return fromResult(Max30102::calculate(*context, red, ir, windowLength, nullptr)); });
+            case 1:
+                return runBatch(signal, windowLength, [this, windowLength, variant, &fromResult](uint32_t *red, uint32_t *ir)
+                                { return fromResult(Max30102::calculate(*context, red, ir, windowLength, variant)); });
+            case 2:
+                return runBatch(signal, windowLength, [this](uint32_t *red, uint32_t *ir)
+                                {
+                    int32_t spo2 = 0;
+                    int8_t spo2Valid = 0;
+                    int32_t heartRate = 0;
+                    int8_t heartRateValid = 0;
+                    Spo2Window<FS, BUFFER_SIZE>::calculate(*context500, ir, red, &spo2, &spo2Valid, &heartRate, &heartRateValid);
+                    return Estimate{heartRate, spo2, spo2Valid && heartRateValid}; });
+            default:
+                return runStream(signal, *stream);
+            }
+        }
+    };
+
+    std::vector<double> parseList(const char *text)
+    {
+        std::vector<double> values;
+        std::string copy(text);
+        for (char *token = strtok(copy.data(), ","); token != nullptr; token = strtok(nullptr, ","))
+        {
+            values.push_back(atof(token));
+        }
+        return values;
+    }
+
+    void printHeader()
+    {
+        printf("%-32s %-10s %5s %6s %7s %7s %9s %11s %9s %7s\n",
+               "signal", "engine", "len", "est", "valid%", "hr_err", "spo2_err", "ns/window", "ns/sample", "allocs");
+    }
+
+    void printRow(const char *signal, const char *engine, uint32_t length, const Stats &s)
+    {
+        char lengthText[16];
+        if (length > 1)
+        {
+            snprintf(lengthText, sizeof(lengthText), "%lu", (unsigned long)length);
+        }
+        else
+        {
+            snprintf(lengthText, sizeof(lengthText), "-");
+        }
+        double validPercent = s.estimates ? 100.0 * s.valid / s.estimates : 0;
+        printf("%-32s %-10s %5s %6llu %7.1f", signal, engine, lengthText, (unsigned long long)s.estimates, validPercent);
+        if (s.scored != 0)
+        {
+            printf(" %7.2f %9.2f", s.heartRateError / s.scored, s.spo2Error / s.scored);
+        }
+        else
+        {
+            printf(" %7s %9s", "-", "-");
+        }
+        printf(" %11.0f %9.2f %7llu\n", s.estimates ? s.ns / s.estimates : 0, s.samples ? s.ns / s.samples : 0,
+               (unsigned long long)s.allocations);
+    }
+
+    int usage(const char *program)
+    {
+        fprintf(stderr,
+                "usage: %s [--rate LIST] [--hr LIST] [--spo2 LIST] [--noise LIST] [--wander LIST]\n"
+                "          [--seconds N] [--repeat N] [--file PATH]... [--no-synthetic]\n"
+                "          [--gate ENGINE=NS_PER_SAMPLE]... [--write PATH] [--quiet]\n",
+                program);
+        return 1;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<double> rates = {50, 100};
+    std::vector<double> heartRates = {50, 72, 100, 140};
+    std::vector<double> spo2s = {97, 90};
+    std::vector<double> noises = {10, 40};
+    std::vector<double> wanders = {0, 0.004};
+    uint32_t seconds = 30;
+    unsigned repeat = 3;
+    bool synthetic = true;
+    bool quiet = false;
+    const char *writePath = nullptr;
+    std::vector<const char *> files;
+    std::vector<std::pair<std::string, double>> gates;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--no-synthetic") == 0)
+        {
+            synthetic = false;
+            continue;
+        }
+        if (strcmp(arg, "--quiet") == 0)
+        {
+            quiet = true;
+            continue;
+        }
+        if (value == nullptr)
+        {
+            return usage(argv[0]);
+        }
+        i++;
+        if (strcmp(arg, "--rate") == 0)
+            rates = parseList(value);
+        else if (strcmp(arg, "--hr") == 0)
+            heartRates = parseList(value);
+        else if (strcmp(arg, "--spo2") == 0)
+            spo2s = parseList(value);
+        else if (strcmp(arg, "--noise") == 0)
+            noises = parseList(value);
+        else if (strcmp(arg, "--wander") == 0)
+            wanders = parseList(value);
+        else if (strcmp(arg, "--seconds") == 0)
+            seconds = static_cast<uint32_t>(atoi(value));
+        else if (strcmp(arg, "--repeat") == 0)
+            repeat = static_cast<unsigned>(atoi(value));
+        else if (strcmp(arg, "--file") == 0)
+            files.push_back(value);
+        else if (strcmp(arg, "--write") == 0)
+            writePath = value;
+        else if (strcmp(arg, "--gate") == 0 && strchr(value, '=') != nullptr)
+            gates.emplace_back(std::string(value, strchr(value, '=')), atof(strchr(value, '=') + 1));
+        else
+            return usage(argv[0]);
+    }
+    if (repeat == 0 || seconds <= kWarmupSeconds)
+    {
+        return usage(argv[0]);
+    }
+
+    std::vector<Signal> signals;
+    if (synthetic || writePath != nullptr)
+    {
+        for (double rate : rates)
+            for (double heartRate : heartRates)
+                for (double spo2 : spo2s)
+                    for (double noise : noises)
+                        for (double wander : wanders)
+                            signals.push_back(synthesize(static_cast<uint32_t>(rate), heartRate, spo2, noise, wander, seconds));
+    }
+    if (writePath != nullptr)
+    {
+        return save(writePath, signals.front()) ? 0 : 1;
+    }
+    for (const char *path : files)
+    {
+        Signal signal;
+        if (!load(path, signal))
+        {
+            return 1;
+        }
+        signals.push_back(std::move(signal));
+    }
+
+    Engines engines;
+    for (const auto &gate : gates)
+    {
+        Engine *engine = engines.find(gate.first.c_str());
+        if (engine == nullptr)
+        {
+            fprintf(stderr, "unknown engine %s\n", gate.first.c_str());
+            return 1;
+        }
+        engine->gateNsPerSample = gate.second;
+    }
+
+    if (!quiet)
+    {
+        printHeader();
+    }
+    for (Signal &signal : signals)
+    {
+        for (size_t e = 0; e < 4; e++)
+        {
+            const uint32_t length = engines.length(e, signal.rate);
+            if (length == 0)
+            {
+                continue;
+            }
+            // errors from the first pass, the fastest pass for the time
+            Stats stats = engines.run(e, signal);
+            for (unsigned r = 1; r < repeat; r++)
+            {
+                Stats again = engines.run(e, signal);
+                stats.ns = (again.ns < stats.ns) ? again.ns : stats.ns;
+                stats.allocations += again.allocations;
+            }
+            engines.list[e].total.add(stats);
+            if (!quiet)
+            {
+                printRow(signal.name.c_str(), engines.list[e].name, length, stats);
+            }
+        }
+    }
+
+    printf("\n%zu signals, %u repeats, totals:\n", signals.size(), repeat);
+    printHeader();
+    int status = 0;
+    for (const Engine &engine : engines.list)
+    {
+        if (engine.total.estimates == 0)
+        {
+            continue;
+        }
+        printRow("all", engine.name, 0, engine.total);
+        double nsPerSample = engine.total.ns / engine.total.samples;
+        if (engine.gateNsPerSample > 0 && nsPerSample > engine.gateNsPerSample)
+        {
+            printf("gate: %s %.2f ns/sample is above %.2f\n", engine.name, nsPerSample, engine.gateNsPerSample);
+            status = 1;
+        }
+        if (engine.total.allocations != 0)
+        {
+            printf("gate: %s allocated %llu times\n", engine.name, (unsigned long long)engine.total.allocations);
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,123 @@
+// Runs Max30102::calculate on several threads at once, each with its own
+// SensorAlgorithmContext, and compares every result with a single-threaded run.
+//
+//   ./build-host/spo2_context_check [--threads N] [--rounds N]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "sensor.h"
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr size_t kWindows = 24U;
+
+    struct Window
+    {
+        std::vector<uint32_t> red;
+        std::vector<uint32_t> ir;
+        const Spo2WindowVariant *variant;
+        SensorResult expected;
+    };
+
+    Window makeWindow(size_t index)
+    {
+        // alternate between the specialized windows and the generic algorithm
+        static constexpr uint32_t kRates[] = {50U, 100U, 100U};
+        uint32_t rate = kRates[index % 3];
+        const Spo2WindowVariant *variant = (index % 3 == 2) ? nullptr : findSpo2Window(rate);
+        // the generic algorithm reads BUFFER_SIZE samples whatever the length is, shorter
+        // windows would depend on what the context held before
+        size_t length = (variant != nullptr) ? variant->windowLength : BUFFER_SIZE;
+
+        double bpm = 50.0 + 5.0 * index;
+        double ratio = 0.4 + 0.02 * index;
+        uint32_t seed = 0x1234567U + index;
+
+        Window window{{}, {}, variant, {}};
+        for (size_t n = 0; n < length; n++)
+        {
+            seed = seed * 1664525U + 1013904223U;
+            double noise = ((seed >> 8) / 16777216.0 - 0.5) * 40.0;
+            double phase = 2 * kPi * n / rate * bpm / 60.0;
+            double pulse = 0.6 * sin(phase) + 0.25 * sin(2 * phase) + 0.1 * sin(3 * phase);
+            window.ir.push_back(static_cast<uint32_t>(120000.0 * (1.0 - 0.01 * pulse) + noise));
+            window.red.push_back(static_cast<uint32_t>(100000.0 * (1.0 - 0.01 * ratio * pulse) + noise));
+        }
+        return window;
+    }
+
+    SensorResult run(SensorAlgorithmContext &context, Window &window)
+    {
+        return Max30102::calculate(context, window.red.data(), window.ir.data(), window.ir.size(), window.variant);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned threads = 4;
+    unsigned rounds = 200;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+        {
+            rounds = static_cast<unsigned>(atoi(argv[++i]));
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--threads N] [--rounds N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Window> windows;
+    auto reference = std::make_unique<SensorAlgorithmContext>();
+    for (size_t i = 0; i < kWindows; i++)
+    {
+        windows.push_back(makeWindow(i));
+        windows.back().expected = run(*reference, windows.back());
+    }
+
+    std::atomic<unsigned> mismatches{0};
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&windows, &mismatches, rounds, t]()
+                             {
+            auto context = std::make_unique<SensorAlgorithmContext>();
+            // every thread walks the windows in a different order
+            for (unsigned r = 0; r < rounds; r++)
+            {
+                for (size_t i = 0; i < windows.size(); i++)
+                {
+                    Window &window = windows[(i + t * 7U + r) % windows.size()];
+                    SensorResult result = run(*context, window);
+                    if (result.pulse != window.expected.pulse || result.saturation != window.expected.saturation)
+                    {
+                        mismatches++;
+                    }
+                }
+            } });
+    }
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    printf("%u threads x %u rounds x %zu windows, mismatches against single-threaded results: %u\n",
+           threads, rounds, windows.size(), mismatches.load());
+    return mismatches.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+// Checks the fast SpO2 front end kernels against their scalar references on random data,
+// out of place and in place, and times both over a 500 sample window.
+//
+//   ./build-host/spo2_kernel_check [--rounds N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "sensor_spo2_kernels.h"
+
+namespace
+{
+    constexpr int32_t kWindow = 500;
+    constexpr int32_t kMaxLength = 600;
+    constexpr int32_t kPad = 8;
+
+    uint32_t seed = 0x13579BDFU;
+
+    uint32_t next()
+    {
+        seed = seed * 1664525U + 1013904223U;
+        return seed;
+    }
+
+    // samples around a DC level, the range the front end sees
+    void fillSamples(std::vector<uint32_t> &v)
+    {
+        uint32_t level = next() >> 14;
+        for (uint32_t &x : v)
+        {
+            x = level + (next() >> 20);
+        }
+    }
+
+    // signed values, a narrow range now and then to get ties
+    void fillSigned(std::vector<int32_t> &v, int32_t range)
+    {
+        for (int32_t &x : v)
+        {
+            x = static_cast<int32_t>(next() % (2U * range + 1U)) - range;
+        }
+    }
+
+    unsigned failures = 0;
+
+    void expect(bool ok, const char *kernel, int32_t length, bool inPlace)
+    {
+        if (!ok)
+        {
+            failures++;
+            if (failures <= 10)
+            {
+                printf("mismatch: %s length %ld%s\n", kernel, (long)length, inPlace ? " in place" : "");
+            }
+        }
+    }
+
+    void checkLength(int32_t n)
+    {
+        std::vector<uint32_t> samples(n + kPad);
+        fillSamples(samples);
+        uint32_t dc = samples[0];
+
+        std::vector<int32_t> a(n + kPad, 0), b(n + kPad, 0);
+        spo2_kernel_ma4_ref(a.data(), samples.data(), dc, n);
+        spo2_kernel_ma4(b.data(), samples.data(), dc, n);
+        expect(a == b, "ma4", n, false);
+
+        // in place, as the original moving average over an int32_t array
+        std::vector<int32_t> c(n + kPad), d;
+        fillSigned(c, 1 << 20);
+        d = c;
+        spo2_kernel_ma4_ref(c.data(), reinterpret_cast<const uint32_t *>(c.data()), 0, n);
+        spo2_kernel_ma4(d.data(), reinterpret_cast<const uint32_t *>(d.data()), 0, n);
+        expect(c == d, "ma4", n, true);
+
+        std::vector<int32_t> in(n + kPad);
+        fillSigned(in, 1 << 20);
+        std::fill(a.begin(), a.end(), 0);
+        std::fill(b.begin(), b.end(), 0);
+        spo2_kernel_hamming_ref(a.data(), in.data(), n);
+        spo2_kernel_hamming(b.data(), in.data(), n);
+        expect(a == b, "hamming", n, false);
+
+        c = in;
+        d = in;
+        spo2_kernel_hamming_ref(c.data(), c.data(), n);
+        spo2_kernel_hamming(d.data(), d.data(), n);
+        expect(c == d, "hamming", n, true);
+
+        expect(spo2_kernel_abs_sum_ref(in.data(), n) == spo2_kernel_abs_sum(in.data(), n), "abs_sum", n, false);
+
+        if (n > 0)
+        {
+            expect(spo2_kernel_argmax_ref(in.data(), n) == spo2_kernel_argmax(in.data(), n), "argmax", n, false);
+            fillSigned(in, 3);
+            expect(spo2_kernel_argmax_ref(in.data(), n) == spo2_kernel_argmax(in.data(), n), "argmax ties", n, false);
+        }
+    }
+
+    template <typename Run>
+    double nsPerCall(unsigned rounds, Run run)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        for (unsigned r = 0; r < rounds; r++)
+        {
+            run();
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - begin).count() / rounds;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned rounds = 20000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+        {
+            rounds = static_cast<unsigned>(atoi(argv[++i]));
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--rounds N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    for (int32_t n = 0; n <= kMaxLength; n++)
+    {
+        checkLength(n);
+    }
+    printf("lengths 0..%ld, mismatches against the scalar references: %u\n", (long)kMaxLength, failures);
+
+    std::vector<uint32_t> samples(kWindow + kPad);
+    fillSamples(samples);
+    std::vector<int32_t> values(kWindow + kPad);
+    fillSigned(values, 1 << 16);
+    std::vector<int32_t> out(kWindow + kPad);
+    volatile int32_t sink = 0;
+
+    struct Timing
+    {
+        const char *kernel;
+        double reference;
+        double fast;
+    };
+    const Timing timings[] = {
+        {"ma4",
+         nsPerCall(rounds, [&]()
+                   { spo2_kernel_ma4_ref(out.data(), samples.data(), samples[0], kWindow); sink = sink + out[1]; }),
+         nsPerCall(rounds, [&]()
+                   { spo2_kernel_ma4(out.data(), samples.data(), samples[0], kWindow); sink = sink + out[1]; })},
+        {"hamming",
+         nsPerCall(rounds, [&]()
+                   { spo2_kernel_hamming_ref(out.data(), values.data(), kWindow); sink = sink + out[1]; }),
+         nsPerCall(rounds, [&]()
+                   { spo2_kernel_hamming(out.data(), values.data(), kWindow); sink = sink + out[1]; })},
+        {"abs_sum",
+         nsPerCall(rounds, [&]()
+                   { sink = sink + spo2_kernel_abs_sum_ref(values.data(), kWindow); }),
+         nsPerCall(rounds, [&]()
+                   { sink = sink + spo2_kernel_abs_sum(values.data(), kWindow); })},
+        {"argmax",
+         nsPerCall(rounds, [&]()
+                   { sink = sink + spo2_kernel_argmax_ref(values.data(), kWindow); }),
+         nsPerCall(rounds, [&]()
+                   { sink = sink + spo2_kernel_argmax(values.data(), kWindow); })},
+    };
+
+    printf("%-8s %14s %14s %8s   (ns per %ld samples)\n", "kernel", "reference", "fast", "speedup", (long)kWindow);
+    for (const Timing &t : timings)
+    {
+        printf("%-8s %14.0f %14.0f %7.1fx\n", t.kernel, t.reference, t.fast, t.reference / t.fast);
+    }
+    return failures == 0 ? 0 : 1;
+}
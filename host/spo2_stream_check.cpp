@@ -0,0 +1,173 @@
+// Compares the streaming engine with the batch algorithm on synthetic PPG.
+// Every second the batch function gets the last BUFFER_SIZE samples and its
+// estimates are compared with the latest streaming estimates. At other rates
+// than FS the reference is the Spo2Window specialization for that rate, the
+// batch function with its distances scaled.
+//
+//   ./build-host/spo2_stream_check
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "sensor_spo2_stream.h"
+#include "sensor_spo2_window.h"
+#include "sensor_spo2_algorithm.h"
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr uint32_t kSeconds = 60U;
+    constexpr int32_t kHeartRateTolerance = 3;
+    constexpr int32_t kSpo2Tolerance = 2;
+
+    struct Case
+    {
+        uint32_t sampleRate;
+        double heartRateBpm;
+        double ratio;
+        double noise;
+    };
+
+    constexpr Case kCases[] = {
+        {FS, 45.0, 0.6, 20.0},
+        {FS, 60.0, 0.5, 20.0},
+        {FS, 72.0, 0.6, 20.0},
+        {FS, 72.0, 0.8, 60.0},
+        {FS, 90.0, 0.7, 20.0},
+        {FS, 120.0, 0.6, 20.0},
+        {FS, 150.0, 0.6, 20.0},
+        // 100 Hz with averaging 2, the default configuration of the sensor task
+        {50U, 60.0, 0.5, 20.0},
+        {50U, 72.0, 0.6, 20.0},
+        {50U, 90.0, 0.7, 20.0},
+        {50U, 120.0, 0.6, 20.0},
+        {50U, 150.0, 0.6, 20.0},
+    };
+
+    struct Comparison
+    {
+        unsigned windows;
+        unsigned bothValid;
+        unsigned agreeing;
+        int32_t maxHeartRateError;
+        int32_t maxSpo2Error;
+        // mean absolute heart rate error against the generated rate
+        double batchTruthError;
+        double streamTruthError;
+    };
+
+    // same pulse shape as the register model, plus slow baseline wander
+    void generate(const Case &c, std::vector<uint32_t> &red, std::vector<uint32_t> &ir)
+    {
+        uint32_t seed = 0x2468ACE1U;
+        auto noise = [&seed](double sigma)
+        {
+            double sum = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                seed = seed * 1664525U + 1013904223U;
+                sum += (seed >> 8) / 16777216.0 - 0.5;
+            }
+            return sum * sigma * 1.7;
+        };
+
+        for (uint32_t n = 0; n < kSeconds * c.sampleRate; n++)
+        {
+            double t = static_cast<double>(n) / c.sampleRate;
+            double phase = 2 * kPi * t * c.heartRateBpm / 60.0;
+            double pulse = 0.6 * sin(phase) + 0.25 * sin(2 * phase) + 0.1 * sin(3 * phase);
+            double wander = 1.0 + 0.002 * sin(2 * kPi * 0.2 * t);
+            double perfusion = 0.02;
+
+            ir.push_back(static_cast<uint32_t>(120000.0 * wander * (1.0 - 0.5 * perfusion * pulse) + noise(c.noise)));
+            red.push_back(static_cast<uint32_t>(100000.0 * wander * (1.0 - 0.5 * perfusion * c.ratio * pulse) + noise(c.noise)));
+        }
+    }
+
+    Comparison compare(const Case &c)
+    {
+        std::vector<uint32_t> red;
+        std::vector<uint32_t> ir;
+        generate(c, red, ir);
+
+        Comparison result{};
+        Spo2Stream stream(c.sampleRate);
+        const Spo2WindowVariant *window = (c.sampleRate != FS) ? findSpo2Window(c.sampleRate) : nullptr;
+        const size_t length = (window != nullptr) ? window->windowLength : BUFFER_SIZE;
+        static Spo2SharedContext context;
+
+        for (size_t n = 0; n < ir.size(); n++)
+        {
+            stream.push(red[n], ir[n]);
+
+            if (n + 1 < length || (n + 1) % c.sampleRate != 0)
+            {
+                continue;
+            }
+
+            int32_t spo2 = 0;
+            int8_t spo2Valid = 0;
+            int32_t heartRate = 0;
+            int8_t heartRateValid = 0;
+            if (window != nullptr)
+            {
+                window->calculate(context, &ir[n + 1 - length], &red[n + 1 - length],
+                                  &spo2, &spo2Valid, &heartRate, &heartRateValid);
+            }
+            else
+            {
+                maxim_heart_rate_and_oxygen_saturation(&ir[n + 1 - length], length, &red[n + 1 - length],
+                                                       &spo2, &spo2Valid, &heartRate, &heartRateValid);
+            }
+
+            const Spo2StreamResult &streamed = stream.result();
+            result.windows++;
+            if (!(heartRateValid && spo2Valid && streamed.heartRateValid && streamed.spo2Valid))
+            {
+                continue;
+            }
+            result.bothValid++;
+
+            int32_t heartRateError = abs(heartRate - streamed.heartRate);
+            int32_t spo2Error = abs(spo2 - streamed.spo2);
+            result.maxHeartRateError = (heartRateError > result.maxHeartRateError) ? heartRateError : result.maxHeartRateError;
+            result.maxSpo2Error = (spo2Error > result.maxSpo2Error) ? spo2Error : result.maxSpo2Error;
+            if (heartRateError <= kHeartRateTolerance && spo2Error <= kSpo2Tolerance)
+            {
+                result.agreeing++;
+            }
+            result.batchTruthError += fabs(heartRate - c.heartRateBpm);
+            result.streamTruthError += fabs(streamed.heartRate - c.heartRateBpm);
+        }
+
+        if (result.bothValid != 0)
+        {
+            result.batchTruthError /= result.bothValid;
+            result.streamTruthError /= result.bothValid;
+        }
+        return result;
+    }
+}
+
+int main()
+{
+    printf("%5s %6s %6s %6s %8s %10s %8s %8s %9s %10s %10s\n",
+           "rate", "bpm", "ratio", "noise", "windows", "both_valid", "agree%", "max_dhr", "max_dspo2",
+           "batch_err", "stream_err");
+
+    for (const Case &c : kCases)
+    {
+        Comparison r = compare(c);
+        double agreePercent = r.bothValid ? 100.0 * r.agreeing / r.bothValid : 0;
+        printf("%5u %6.0f %6.2f %6.0f %8u %10u %8.1f %8ld %9ld %10.1f %10.1f\n",
+               c.sampleRate, c.heartRateBpm, c.ratio, c.noise, r.windows, r.bothValid, agreePercent,
+               (long)r.maxHeartRateError, (long)r.maxSpo2Error, r.batchTruthError, r.streamTruthError);
+    }
+
+    printf("agree: heart rate within %ld bpm and spo2 within %ld %% of the batch function\n",
+           (long)kHeartRateTolerance, (long)kSpo2Tolerance);
+    return 0;
+}
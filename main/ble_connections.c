@@ -0,0 +1,129 @@
+#include "ble_connections.h"
+
+static struct ble_conn_entry *ble_conn_lookup(struct ble_conn_table *table, uint16_t conn_handle)
+{
+    for (size_t i = 0; i < BLE_CONN_MAX; i++)
+    {
+        if (table->entries[i].conn_handle == conn_handle)
+        {
+            return &table->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void ble_conn_clear(struct ble_conn_entry *entry)
+{
+    entry->conn_handle = BLE_SUB_CONN_NONE;
+    entry->mtu = 0;
+    entry->itvl = 0;
+    entry->latency = 0;
+    entry->supervision_timeout = 0;
+}
+
+void ble_conn_init(struct ble_conn_table *table)
+{
+    for (size_t i = 0; i < BLE_CONN_MAX; i++)
+    {
+        ble_conn_clear(&table->entries[i]);
+    }
+}
+
+int ble_conn_on_connect(struct ble_conn_table *table, uint16_t conn_handle,
+                        uint16_t itvl, uint16_t latency, uint16_t supervision_timeout)
+{
+    struct ble_conn_entry *entry = ble_conn_lookup(table, conn_handle);
+
+    if (entry == NULL)
+    {
+        entry = ble_conn_lookup(table, BLE_SUB_CONN_NONE);
+        if (entry == NULL)
+        {
+            return -1;
+        }
+    }
+    /* a handle is only reused after its disconnect, nothing carries over */
+    entry->conn_handle = conn_handle;
+    entry->mtu = BLE_CONN_DEFAULT_MTU;
+    entry->itvl = itvl;
+    entry->latency = latency;
+    entry->supervision_timeout = supervision_timeout;
+    return 0;
+}
+
+void ble_conn_on_disconnect(struct ble_conn_table *table, uint16_t conn_handle)
+{
+    struct ble_conn_entry *entry = ble_conn_lookup(table, conn_handle);
+
+    if (entry != NULL)
+    {
+        ble_conn_clear(entry);
+    }
+}
+
+void ble_conn_on_mtu(struct ble_conn_table *table, uint16_t conn_handle, uint16_t mtu)
+{
+    struct ble_conn_entry *entry = ble_conn_lookup(table, conn_handle);
+
+    if (entry != NULL)
+    {
+        entry->mtu = mtu;
+    }
+}
+
+void ble_conn_on_update(struct ble_conn_table *table, uint16_t conn_handle,
+                        uint16_t itvl, uint16_t latency, uint16_t supervision_timeout)
+{
+    struct ble_conn_entry *entry = ble_conn_lookup(table, conn_handle);
+
+    if (entry != NULL)
+    {
+        entry->itvl = itvl;
+        entry->latency = latency;
+        entry->supervision_timeout = supervision_timeout;
+    }
+}
+
+const struct ble_conn_entry *ble_conn_find(const struct ble_conn_table *table, uint16_t conn_handle)
+{
+    if (conn_handle == BLE_SUB_CONN_NONE)
+    {
+        return NULL;
+    }
+    return ble_conn_lookup((struct ble_conn_table *)table, conn_handle);
+}
+
+size_t ble_conn_count(const struct ble_conn_table *table)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < BLE_CONN_MAX; i++)
+    {
+        if (table->entries[i].conn_handle != BLE_SUB_CONN_NONE)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool ble_conn_slot_free(const struct ble_conn_table *table)
+{
+    return ble_conn_count(table) < BLE_CONN_MAX;
+}
+
+uint16_t ble_conn_min_mtu(const struct ble_conn_table *table,
+                          const uint16_t *conn_handles, size_t count)
+{
+    uint16_t mtu = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const struct ble_conn_entry *entry = ble_conn_find(table, conn_handles[i]);
+        if (entry != NULL && (mtu == 0 || entry->mtu < mtu))
+        {
+            mtu = entry->mtu;
+        }
+    }
+    return mtu;
+}
@@ -0,0 +1,84 @@
+#ifndef BLE_CONNECTIONS_H
+#define BLE_CONNECTIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble_subscriptions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The open connections and what was negotiated on each, kept from the GAP
+ * events. Like ble_subscriptions.h it makes no NimBLE calls: ble_task.cpp
+ * feeds the events and asks whether to keep advertising, ble_service.c owns
+ * the table next to the subscriptions and reads the MTUs from it.
+ *
+ * Advertising stops when a central connects. It is restarted as long as a
+ * slot is free, so several centrals (a bedside display and a gateway) can be
+ * connected at the same time, up to BLE_CONN_MAX.
+ */
+
+#define BLE_CONN_MAX BLE_SUB_MAX_CONNECTIONS
+
+/** ATT MTU until the exchange, the minimum of the spec */
+#define BLE_CONN_DEFAULT_MTU 23
+
+struct ble_conn_entry
+{
+    uint16_t conn_handle;
+    uint16_t mtu;
+    /* in 1.25 ms units, connection events, 10 ms units */
+    uint16_t itvl;
+    uint16_t latency;
+    uint16_t supervision_timeout;
+};
+
+struct ble_conn_table
+{
+    struct ble_conn_entry entries[BLE_CONN_MAX];
+};
+
+void ble_conn_init(struct ble_conn_table *table);
+
+/**
+ * A connection was established with these parameters. Returns 0, or -1 when
+ * every slot is taken (the controller accepted more than we track).
+ */
+int ble_conn_on_connect(struct ble_conn_table *table, uint16_t conn_handle,
+                        uint16_t itvl, uint16_t latency, uint16_t supervision_timeout);
+
+/** Forget a closed connection, its slot is free again */
+void ble_conn_on_disconnect(struct ble_conn_table *table, uint16_t conn_handle);
+
+/** BLE_GAP_EVENT_MTU: the exchanged ATT MTU */
+void ble_conn_on_mtu(struct ble_conn_table *table, uint16_t conn_handle, uint16_t mtu);
+
+/** BLE_GAP_EVENT_CONN_UPDATE: the parameters now in use */
+void ble_conn_on_update(struct ble_conn_table *table, uint16_t conn_handle,
+                        uint16_t itvl, uint16_t latency, uint16_t supervision_timeout);
+
+/** The entry of conn_handle, NULL when it is not open */
+const struct ble_conn_entry *ble_conn_find(const struct ble_conn_table *table, uint16_t conn_handle);
+
+/** Open connections */
+size_t ble_conn_count(const struct ble_conn_table *table);
+
+/** True while another central can connect, advertising should run then */
+bool ble_conn_slot_free(const struct ble_conn_table *table);
+
+/**
+ * Smallest MTU of the given connections, so one packet fits them all;
+ * connections that are not open are skipped, 0 when none is.
+ */
+uint16_t ble_conn_min_mtu(const struct ble_conn_table *table,
+                          const uint16_t *conn_handles, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+#include "ble_link_policy.h"
+
+static const struct ble_link_params ble_link_streaming_params = BLE_LINK_STREAMING_PARAMS;
+static const struct ble_link_params ble_link_idle_params = BLE_LINK_IDLE_PARAMS;
+
+static struct ble_link_conn *ble_link_find(struct ble_link_policy *policy, uint16_t conn_handle)
+{
+    for (size_t i = 0; i < BLE_CONN_MAX; i++)
+    {
+        if (policy->conns[i].conn_handle == conn_handle)
+        {
+            return &policy->conns[i];
+        }
+    }
+    return NULL;
+}
+
+static void ble_link_clear(struct ble_link_conn *conn)
+{
+    conn->conn_handle = BLE_SUB_CONN_NONE;
+    conn->streams_raw = 0;
+    conn->mode = BLE_LINK_MODE_NONE;
+    conn->target = BLE_LINK_MODE_NONE;
+    conn->refused = BLE_LINK_MODE_NONE;
+    conn->fast_requested = 0;
+    conn->active_ms = 0;
+}
+
+/* which of our modes parameters chosen by the central amount to */
+static uint8_t ble_link_classify(uint16_t itvl, uint16_t latency)
+{
+    if (itvl <= ble_link_streaming_params.itvl_max && latency == 0)
+    {
+        return BLE_LINK_MODE_STREAMING;
+    }
+    if (itvl >= ble_link_idle_params.itvl_min)
+    {
+        return BLE_LINK_MODE_IDLE;
+    }
+    return BLE_LINK_MODE_NONE;
+}
+
+struct ble_link_params ble_link_params_for(enum ble_link_mode mode)
+{
+    return (mode == BLE_LINK_MODE_STREAMING) ? ble_link_streaming_params : ble_link_idle_params;
+}
+
+void ble_link_init(struct ble_link_policy *policy, bool phy_2m)
+{
+    policy->phy_2m = phy_2m;
+    policy->sensor_running = false;
+    for (size_t i = 0; i < BLE_CONN_MAX; i++)
+    {
+        ble_link_clear(&policy->conns[i]);
+    }
+}
+
+int ble_link_on_connect(struct ble_link_policy *policy, uint16_t conn_handle, uint32_t now_ms)
+{
+    struct ble_link_conn *conn = ble_link_find(policy, conn_handle);
+
+    if (conn == NULL)
+    {
+        conn = ble_link_find(policy, BLE_SUB_CONN_NONE);
+        if (conn == NULL)
+        {
+            return -1;
+        }
+    }
+    ble_link_clear(conn);
+    conn->conn_handle = conn_handle;
+    conn->active_ms = now_ms;
+    return 0;
+}
+
+void ble_link_on_disconnect(struct ble_link_policy *policy, uint16_t conn_handle)
+{
+    struct ble_link_conn *conn = ble_link_find(policy, conn_handle);
+
+    if (conn != NULL)
+    {
+        ble_link_clear(conn);
+    }
+}
+
+void ble_link_on_conn_update(struct ble_link_policy *policy, uint16_t conn_handle,
+                             int status, uint16_t itvl, uint16_t latency)
+{
+    struct ble_link_conn *conn = ble_link_find(policy, conn_handle);
+
+    if (conn == NULL)
+    {
+        return;
+    }
+
+    if (conn->target != BLE_LINK_MODE_NONE)
+    {
+        /* the answer to our request */
+        if (status == 0)
+        {
+            conn->mode = conn->target;
+        }
+        else
+        {
+            conn->refused = conn->target;
+        }
+        conn->target = BLE_LINK_MODE_NONE;
+        return;
+    }
+
+    if (status == 0)
+    {
+        /* the central changed them on its own: take what it chose as the mode
+         * it fits, and do not argue over parameters that fit neither */
+        conn->mode = ble_link_classify(itvl, latency);
+        if (conn->mode == BLE_LINK_MODE_NONE)
+        {
+            conn->refused = (policy->sensor_running || conn->streams_raw) ? BLE_LINK_MODE_STREAMING
+                                                                          : BLE_LINK_MODE_IDLE;
+        }
+    }
+}
+
+void ble_link_set_sensor_running(struct ble_link_policy *policy, bool running)
+{
+    policy->sensor_running = running;
+}
+
+void ble_link_set_streams_raw(struct ble_link_policy *policy, uint16_t conn_handle, bool streams)
+{
+    struct ble_link_conn *conn = ble_link_find(policy, conn_handle);
+
+    if (conn != NULL)
+    {
+        conn->streams_raw = streams ? 1 : 0;
+    }
+}
+
+size_t ble_link_poll(struct ble_link_policy *policy, uint32_t now_ms,
+                     struct ble_link_action *out, size_t max)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < BLE_CONN_MAX && count < max; i++)
+    {
+        struct ble_link_conn *conn = &policy->conns[i];
+        if (conn->conn_handle == BLE_SUB_CONN_NONE)
+        {
+            continue;
+        }
+
+        uint8_t want = BLE_LINK_MODE_NONE;
+        if (policy->sensor_running || conn->streams_raw)
+        {
+            conn->active_ms = now_ms;
+            want = BLE_LINK_MODE_STREAMING;
+        }
+        else if ((uint32_t)(now_ms - conn->active_ms) >= BLE_LINK_IDLE_HOLD_MS)
+        {
+            want = BLE_LINK_MODE_IDLE;
+        }
+        if (want == BLE_LINK_MODE_NONE)
+        {
+            /* inside the hold time, whatever is in use stays */
+            continue;
+        }
+        if (conn->refused != want)
+        {
+            conn->refused = BLE_LINK_MODE_NONE;
+        }
+
+        uint8_t flags = 0;
+        if (want == BLE_LINK_MODE_STREAMING && !conn->fast_requested)
+        {
+            /* both stay once negotiated, they cost nothing while idle */
+            conn->fast_requested = 1;
+            flags |= BLE_LINK_ACTION_DATA_LEN;
+            if (policy->phy_2m)
+            {
+                flags |= BLE_LINK_ACTION_PHY_2M;
+            }
+        }
+        if (conn->target == BLE_LINK_MODE_NONE && conn->mode != want && conn->refused != want)
+        {
+            conn->target = want;
+            flags |= BLE_LINK_ACTION_PARAMS;
+        }
+
+        if (flags != 0)
+        {
+            out[count].conn_handle = conn->conn_handle;
+            out[count].flags = flags;
+            out[count].params = ble_link_params_for((enum ble_link_mode)want);
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,134 @@
+#ifndef BLE_LINK_POLICY_H
+#define BLE_LINK_POLICY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble_connections.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Which connection parameters, PHY and data length the peripheral asks each
+ * central for. No NimBLE calls in here: ble_task.cpp feeds the sensor state,
+ * the raw stream subscriptions and the GAP events, and carries out the
+ * actions ble_link_poll() returns.
+ *
+ * A connection streams while a sensor run is active or it subscribed to a
+ * raw stream: it gets a short interval without latency, and once per
+ * connection the maximum data length and, where the controller has it, the
+ * LE 2M PHY. Otherwise it idles on a long interval with peripheral latency.
+ * Streaming is asked for at once, idle only after BLE_LINK_IDLE_HOLD_MS
+ * without activity, which also leaves the central its own parameters for the
+ * service discovery after connecting. One parameter request is in flight per
+ * connection; a mode the central refused is not asked for again until the
+ * wanted mode changes.
+ */
+
+enum ble_link_mode
+{
+    /* parameters of the central, not ours */
+    BLE_LINK_MODE_NONE = 0,
+    BLE_LINK_MODE_IDLE,
+    BLE_LINK_MODE_STREAMING,
+};
+
+/** Connection parameters to request, units as struct ble_gap_upd_params */
+struct ble_link_params
+{
+    /* 1.25 ms */
+    uint16_t itvl_min;
+    uint16_t itvl_max;
+    /* connection events the peripheral may skip */
+    uint16_t latency;
+    /* 10 ms */
+    uint16_t supervision_timeout;
+};
+
+/* 7.5 to 15 ms, no latency, 4 s timeout */
+#define BLE_LINK_STREAMING_PARAMS {6, 12, 0, 400}
+/* 400 to 500 ms, 4 skipped events, 6 s timeout (more than twice the 2.5 s the link may stay silent) */
+#define BLE_LINK_IDLE_PARAMS {320, 400, 4, 600}
+
+#define BLE_LINK_IDLE_HOLD_MS 5000U
+
+/* LL data length: the largest PDU payload and its air time on the 1M PHY */
+#define BLE_LINK_DATA_LEN_OCTETS 251
+#define BLE_LINK_DATA_LEN_TIME_US 2120
+
+/* what ble_link_poll() asks for */
+#define BLE_LINK_ACTION_PARAMS 0x01
+#define BLE_LINK_ACTION_PHY_2M 0x02
+#define BLE_LINK_ACTION_DATA_LEN 0x04
+
+struct ble_link_action
+{
+    uint16_t conn_handle;
+    uint8_t flags;
+    /* set with BLE_LINK_ACTION_PARAMS */
+    struct ble_link_params params;
+};
+
+struct ble_link_conn
+{
+    uint16_t conn_handle;
+    uint8_t streams_raw;
+    /* parameters in use */
+    uint8_t mode;
+    /* mode of the request in flight, BLE_LINK_MODE_NONE without one */
+    uint8_t target;
+    /* mode the central refused */
+    uint8_t refused;
+    /* PHY and data length were asked for */
+    uint8_t fast_requested;
+    /* last time the connection streamed, or connected */
+    uint32_t active_ms;
+};
+
+struct ble_link_policy
+{
+    bool phy_2m;
+    bool sensor_running;
+    struct ble_link_conn conns[BLE_CONN_MAX];
+};
+
+/** phy_2m: the controller supports the LE 2M PHY */
+void ble_link_init(struct ble_link_policy *policy, bool phy_2m);
+
+/** Returns 0, or -1 when every slot is taken */
+int ble_link_on_connect(struct ble_link_policy *policy, uint16_t conn_handle, uint32_t now_ms);
+
+void ble_link_on_disconnect(struct ble_link_policy *policy, uint16_t conn_handle);
+
+/**
+ * BLE_GAP_EVENT_CONN_UPDATE, or a request that failed right away (status
+ * != 0). itvl and latency are the parameters now in use.
+ */
+void ble_link_on_conn_update(struct ble_link_policy *policy, uint16_t conn_handle,
+                             int status, uint16_t itvl, uint16_t latency);
+
+/** SensorTask started or stopped a run */
+void ble_link_set_sensor_running(struct ble_link_policy *policy, bool running);
+
+/** The connection is subscribed to a raw stream characteristic or not anymore */
+void ble_link_set_streams_raw(struct ble_link_policy *policy, uint16_t conn_handle, bool streams);
+
+/**
+ * Fills out with up to max actions due at now_ms, at most one per connection,
+ * and returns their number. Parameter requests returned here count as in
+ * flight until ble_link_on_conn_update().
+ */
+size_t ble_link_poll(struct ble_link_policy *policy, uint32_t now_ms,
+                     struct ble_link_action *out, size_t max);
+
+/** The parameters of a mode, BLE_LINK_MODE_NONE gives the idle ones */
+struct ble_link_params ble_link_params_for(enum ble_link_mode mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,109 @@
+#include <string.h>
+
+#include "ble_ppg_packetizer.h"
+
+PpgPacketizer::PpgPacketizer(uint16_t mtu)
+{
+    frameLimit = pendingLimit = limitForMtu(mtu);
+    reset();
+}
+
+size_t PpgPacketizer::limitForMtu(uint16_t mtu)
+{
+    size_t payload = (mtu > kMaxMtu) ? kMaxPayload : ((mtu > kAttOverhead) ? mtu - kAttOverhead : 0U);
+    size_t limit = (payload > kHeaderSize) ? (payload - kHeaderSize) / kFrameSize : 0U;
+    // the minimum ATT MTU of 23 still carries two frames
+    return (limit != 0) ? limit : 1U;
+}
+
+void PpgPacketizer::setMtu(uint16_t mtu)
+{
+    pendingLimit = limitForMtu(mtu);
+    if (frames == 0)
+    {
+        frameLimit = pendingLimit;
+    }
+}
+
+void PpgPacketizer::reset()
+{
+    frameLimit = pendingLimit;
+    frames = 0;
+    sequence = 0;
+    nextIndex = 0;
+    closed = false;
+}
+
+void PpgPacketizer::open(uint32_t firstIndex)
+{
+    frameLimit = pendingLimit;
+    packet[0] = static_cast<uint8_t>(sequence);
+    packet[1] = static_cast<uint8_t>(sequence >> 8);
+    packet[2] = static_cast<uint8_t>(firstIndex);
+    packet[3] = static_cast<uint8_t>(firstIndex >> 8);
+    packet[4] = static_cast<uint8_t>(firstIndex >> 16);
+    packet[5] = static_cast<uint8_t>(firstIndex >> 24);
+    nextIndex = firstIndex;
+}
+
+size_t PpgPacketizer::append(uint32_t firstIndex, const uint8_t *raw, size_t numFrames)
+{
+    if (closed || numFrames == 0)
+    {
+        return 0;
+    }
+    if (frames == 0)
+    {
+        open(firstIndex);
+    }
+    else if (firstIndex != nextIndex)
+    {
+        // samples were lost, the packet ends before the gap
+        closed = true;
+        return 0;
+    }
+
+    size_t count = frameLimit - frames;
+    count = (numFrames < count) ? numFrames : count;
+    // the FIFO_DATA bytes are the wire format already
+    memcpy(packet + kHeaderSize + frames * kFrameSize, raw, count * kFrameSize);
+    frames += count;
+    nextIndex += static_cast<uint32_t>(count);
+    closed = (frames == frameLimit);
+    return count;
+}
+
+bool PpgPacketizer::flush()
+{
+    if (frames == 0)
+    {
+        return false;
+    }
+    closed = true;
+    return true;
+}
+
+void PpgPacketizer::take()
+{
+    if (!closed)
+    {
+        return;
+    }
+    sequence++;
+    frames = 0;
+    closed = false;
+}
+
+bool PpgPacketizer::parse(const uint8_t *payload, size_t length, uint16_t &sequence,
+                          uint32_t &firstIndex, size_t &numFrames)
+{
+    if (length < kHeaderSize + kFrameSize || (length - kHeaderSize) % kFrameSize != 0)
+    {
+        return false;
+    }
+    sequence = static_cast<uint16_t>(payload[0] | (payload[1] << 8));
+    firstIndex = static_cast<uint32_t>(payload[2]) | (static_cast<uint32_t>(payload[3]) << 8) |
+                 (static_cast<uint32_t>(payload[4]) << 16) | (static_cast<uint32_t>(payload[5]) << 24);
+    numFrames = (length - kHeaderSize) / kFrameSize;
+    return true;
+}
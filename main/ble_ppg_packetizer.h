@@ -0,0 +1,89 @@
+#ifndef BLE_PPG_PACKETIZER_H
+#define BLE_PPG_PACKETIZER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// @brief Packs raw red/ir frames, 3 + 3 bytes as FIFO_DATA gives them, into notification
+/// payloads of the raw stream characteristic, filled up to the ATT MTU.
+///
+/// Packet layout, little endian header:
+///   uint16_t sequence     +1 per packet, wraps
+///   uint32_t firstIndex   FIFO sample index of the first frame, counts lost samples too
+///   then (size - kHeaderSize) / kFrameSize frames of red[3] ir[3], big endian 18-bit
+/// A receiver finds lost packets from the sequence and lost samples from the index.
+/// Frames that do not follow the ones in the packet start a new packet, so the frames of
+/// one packet are always consecutive.
+class PpgPacketizer
+{
+public:
+    static constexpr size_t kHeaderSize = 6U;
+    static constexpr size_t kFrameSize = 6U;
+    // ATT header of a notification: opcode and handle
+    static constexpr size_t kAttOverhead = 3U;
+    // CONFIG_BT_NIMBLE_ATT_PREFERRED_MTU, larger MTUs are not negotiated
+    static constexpr size_t kMaxMtu = 256U;
+    static constexpr size_t kMaxPayload = kMaxMtu - kAttOverhead;
+    static constexpr size_t kMaxFrames = (kMaxPayload - kHeaderSize) / kFrameSize;
+
+    explicit PpgPacketizer(uint16_t mtu = 23U);
+
+    /// @brief ATT MTU of the receivers, applies from the next packet on
+    void setMtu(uint16_t mtu);
+
+    /// @brief Drop the open packet and start over at sequence 0
+    void reset();
+
+    /// @brief Frames per packet at the current MTU
+    size_t framesPerPacket() const
+    {
+        return frameLimit;
+    }
+
+    /// @brief Add numFrames frames starting at sample index firstIndex, returns how many
+    /// were taken. Stops at a full packet or at a gap to the frames already in it, then
+    /// ready() is set and the packet has to be taken before more frames go in.
+    size_t append(uint32_t firstIndex, const uint8_t *raw, size_t numFrames);
+
+    /// @brief The open packet is complete
+    bool ready() const
+    {
+        return closed;
+    }
+
+    /// @brief Close the open packet even if it is not full, false if it holds no frames
+    bool flush();
+
+    /// @brief Payload of the ready packet
+    const uint8_t *data() const
+    {
+        return packet;
+    }
+
+    size_t size() const
+    {
+        return kHeaderSize + frames * kFrameSize;
+    }
+
+    /// @brief The ready packet was handed on, the next one gets the next sequence number
+    void take();
+
+    /// @brief Reads the header of a received packet, false if it is malformed
+    static bool parse(const uint8_t *payload, size_t length, uint16_t &sequence,
+                      uint32_t &firstIndex, size_t &numFrames);
+
+private:
+    uint8_t packet[kMaxPayload];
+    size_t frameLimit = 0;
+    size_t pendingLimit = 0;
+    size_t frames = 0;
+    uint16_t sequence = 0;
+    // sample index the next frame of the open packet must have
+    uint32_t nextIndex = 0;
+    bool closed = false;
+
+    static size_t limitForMtu(uint16_t mtu);
+    void open(uint32_t firstIndex);
+};
+
+#endif
@@ -0,0 +1,323 @@
+#include <string.h>
+
+#include "ble_ppg_rice.h"
+
+static constexpr uint32_t kRiceSampleMask = 0x3FFFFU;
+
+PpgRicePacketizer::PpgRicePacketizer(uint16_t mtu)
+{
+    streamLimit = pendingStreamLimit = streamLimitForMtu(mtu);
+    reset();
+}
+
+size_t PpgRicePacketizer::streamLimitForMtu(uint16_t mtu)
+{
+    size_t payload = (mtu > PpgPacketizer::kMaxMtu) ? kMaxPayload
+                                                     : ((mtu > PpgPacketizer::kAttOverhead) ? mtu - PpgPacketizer::kAttOverhead : 0U);
+    return (payload > kHeaderSize + kKeyframeSize) ? payload - kHeaderSize - kKeyframeSize : 0U;
+}
+
+uint32_t PpgRicePacketizer::parameter(uint32_t mean)
+{
+    uint32_t average = mean >> kMeanShift;
+    uint32_t k = (average != 0) ? 31U - static_cast<uint32_t>(__builtin_clz(average)) : 0U;
+    return (k < kMaxK) ? k : kMaxK;
+}
+
+uint32_t PpgRicePacketizer::meanForParameter(uint32_t k)
+{
+    // the middle of the means that give k
+    return ((3U << k) >> 1) << kMeanShift;
+}
+
+uint32_t PpgRicePacketizer::sample(const uint8_t *bytes)
+{
+    return ((uint32_t(bytes[0]) << 16) | (uint32_t(bytes[1]) << 8) | bytes[2]) & kRiceSampleMask;
+}
+
+void PpgRicePacketizer::setMtu(uint16_t mtu)
+{
+    pendingStreamLimit = streamLimitForMtu(mtu);
+    if (count == 0)
+    {
+        streamLimit = pendingStreamLimit;
+    }
+}
+
+void PpgRicePacketizer::reset()
+{
+    streamLimit = pendingStreamLimit;
+    count = 0;
+    sequence = 0;
+    nextIndex = 0;
+    closed = false;
+    bytes = 0;
+    accumulator = 0;
+    bits = 0;
+    red = Channel{0, meanForParameter(0)};
+    ir = Channel{0, meanForParameter(0)};
+}
+
+void PpgRicePacketizer::open(uint32_t firstIndex, const uint8_t *frame)
+{
+    streamLimit = pendingStreamLimit;
+
+    // k carries over from the last packet, the mean restarts from it on both sides
+    uint32_t redK = parameter(red.mean);
+    uint32_t irK = parameter(ir.mean);
+    red = Channel{sample(frame), meanForParameter(redK)};
+    ir = Channel{sample(frame + 3), meanForParameter(irK)};
+
+    packet[0] = static_cast<uint8_t>(sequence);
+    packet[1] = static_cast<uint8_t>(sequence >> 8);
+    packet[2] = static_cast<uint8_t>(firstIndex);
+    packet[3] = static_cast<uint8_t>(firstIndex >> 8);
+    packet[4] = static_cast<uint8_t>(firstIndex >> 16);
+    packet[5] = static_cast<uint8_t>(firstIndex >> 24);
+    packet[7] = static_cast<uint8_t>(redK | (irK << 4));
+    memcpy(packet + kHeaderSize, frame, kKeyframeSize);
+
+    bytes = 0;
+    accumulator = 0;
+    bits = 0;
+    count = 1;
+    nextIndex = firstIndex + 1U;
+}
+
+inline void PpgRicePacketizer::write(uint32_t value, uint32_t length)
+{
+    // length <= kEscapeLength + 1 or kResidualBits, with < 8 bits left over it fits
+    accumulator = (accumulator << length) | value;
+    bits += length;
+    uint8_t *stream = packet + kHeaderSize + kKeyframeSize;
+    while (bits >= 8U)
+    {
+        bits -= 8U;
+        stream[bytes++] = static_cast<uint8_t>(accumulator >> bits);
+    }
+}
+
+inline void PpgRicePacketizer::encode(Channel &channel, uint32_t value)
+{
+    int32_t delta = static_cast<int32_t>(value) - static_cast<int32_t>(channel.previous);
+    uint32_t zigzag = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+    uint32_t k = parameter(channel.mean);
+    uint32_t quotient = zigzag >> k;
+
+    if (quotient < kEscapeLength)
+    {
+        // quotient ones and the stop bit in one go
+        write((1U << (quotient + 1U)) - 2U, quotient + 1U);
+        write(zigzag & ((1U << k) - 1U), k);
+    }
+    else
+    {
+        write((1U << kEscapeLength) - 1U, kEscapeLength);
+        write(zigzag, kResidualBits);
+    }
+
+    channel.previous = value;
+    channel.mean += zigzag - (channel.mean >> kMeanShift);
+}
+
+size_t PpgRicePacketizer::append(uint32_t firstIndex, const uint8_t *raw, size_t numFrames)
+{
+    if (closed || numFrames == 0)
+    {
+        return 0;
+    }
+
+    size_t taken = 0;
+    if (count == 0)
+    {
+        open(firstIndex, raw);
+        taken = 1;
+    }
+    else if (firstIndex != nextIndex)
+    {
+        // samples were lost, the packet ends before the gap
+        finish();
+        return 0;
+    }
+
+    for (; taken < numFrames; taken++)
+    {
+        if (count == kMaxFrames)
+        {
+            finish();
+            return taken;
+        }
+
+        // encode, and take it back if it went past the limit
+        const size_t savedBytes = bytes;
+        const uint64_t savedAccumulator = accumulator;
+        const uint32_t savedBits = bits;
+        const Channel savedRed = red;
+        const Channel savedIr = ir;
+
+        const uint8_t *frame = raw + taken * kFrameSize;
+        encode(red, sample(frame));
+        encode(ir, sample(frame + 3));
+
+        if (bytes + ((bits != 0) ? 1U : 0U) > streamLimit)
+        {
+            bytes = savedBytes;
+            accumulator = savedAccumulator;
+            bits = savedBits;
+            red = savedRed;
+            ir = savedIr;
+            finish();
+            return taken;
+        }
+        count++;
+        nextIndex++;
+    }
+    return taken;
+}
+
+void PpgRicePacketizer::finish()
+{
+    if (bits != 0)
+    {
+        packet[kHeaderSize + kKeyframeSize + bytes] = static_cast<uint8_t>(accumulator << (8U - bits));
+    }
+    packet[6] = static_cast<uint8_t>(count);
+    closed = true;
+}
+
+bool PpgRicePacketizer::flush()
+{
+    if (count == 0)
+    {
+        return false;
+    }
+    if (!closed)
+    {
+        finish();
+    }
+    return true;
+}
+
+void PpgRicePacketizer::take()
+{
+    if (!closed)
+    {
+        return;
+    }
+    sequence++;
+    count = 0;
+    bytes = 0;
+    accumulator = 0;
+    bits = 0;
+    closed = false;
+}
+
+bool PpgRicePacketizer::parse(const uint8_t *payload, size_t length, uint16_t &sequence,
+                              uint32_t &firstIndex, size_t &numFrames)
+{
+    if (length < kHeaderSize + kKeyframeSize || payload[6] == 0)
+    {
+        return false;
+    }
+    sequence = static_cast<uint16_t>(payload[0] | (payload[1] << 8));
+    firstIndex = static_cast<uint32_t>(payload[2]) | (static_cast<uint32_t>(payload[3]) << 8) |
+                 (static_cast<uint32_t>(payload[4]) << 16) | (static_cast<uint32_t>(payload[5]) << 24);
+    numFrames = payload[6];
+    return true;
+}
+
+namespace
+{
+    class RiceBitReader
+    {
+    public:
+        RiceBitReader(const uint8_t *stream, size_t length) : stream(stream), length(length) {}
+
+        bool read(uint32_t count, uint32_t &value)
+        {
+            value = 0;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                if (position >= length * 8U)
+                {
+                    return false;
+                }
+                value = (value << 1) | ((stream[position >> 3] >> (7U - (position & 7U))) & 1U);
+                position++;
+            }
+            return true;
+        }
+
+    private:
+        const uint8_t *stream;
+        size_t length;
+        size_t position = 0;
+    };
+}
+
+bool PpgRicePacketizer::decode(const uint8_t *payload, size_t length, uint16_t &sequence,
+                               uint32_t &firstIndex, uint8_t *out, size_t maxFrames, size_t &numFrames)
+{
+    if (!parse(payload, length, sequence, firstIndex, numFrames) || numFrames > maxFrames)
+    {
+        return false;
+    }
+
+    memcpy(out, payload + kHeaderSize, kKeyframeSize);
+    Channel channels[2] = {{sample(out), meanForParameter(payload[7] & 0x0FU)},
+                           {sample(out + 3), meanForParameter(payload[7] >> 4)}};
+
+    RiceBitReader reader(payload + kHeaderSize + kKeyframeSize, length - kHeaderSize - kKeyframeSize);
+    for (size_t f = 1; f < numFrames; f++)
+    {
+        uint8_t *frame = out + f * kFrameSize;
+        for (size_t c = 0; c < 2; c++)
+        {
+            Channel &channel = channels[c];
+            uint32_t k = parameter(channel.mean);
+
+            uint32_t quotient = 0;
+            uint32_t bit = 1;
+            while (quotient < kEscapeLength)
+            {
+                if (!reader.read(1, bit))
+                {
+                    return false;
+                }
+                if (bit == 0)
+                {
+                    break;
+                }
+                quotient++;
+            }
+
+            uint32_t zigzag = 0;
+            if (quotient == kEscapeLength)
+            {
+                if (!reader.read(kResidualBits, zigzag))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                uint32_t remainder = 0;
+                if (!reader.read(k, remainder))
+                {
+                    return false;
+                }
+                zigzag = (quotient << k) | remainder;
+            }
+
+            int32_t delta = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1U);
+            uint32_t value = static_cast<uint32_t>(static_cast<int32_t>(channel.previous) + delta) & kRiceSampleMask;
+            channel.previous = value;
+            channel.mean += zigzag - (channel.mean >> kMeanShift);
+
+            frame[c * 3 + 0] = static_cast<uint8_t>(value >> 16);
+            frame[c * 3 + 1] = static_cast<uint8_t>(value >> 8);
+            frame[c * 3 + 2] = static_cast<uint8_t>(value);
+        }
+    }
+    return true;
+}
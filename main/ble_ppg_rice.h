@@ -0,0 +1,124 @@
+#ifndef BLE_PPG_RICE_H
+#define BLE_PPG_RICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ble_ppg_packetizer.h"
+
+/// @brief Packs raw red/ir frames like PpgPacketizer, compressed. Every packet starts with a
+/// keyframe; the frames after it are first order deltas per channel, zigzag mapped and Rice
+/// coded with a parameter k that follows the mean residual. Packets decode on their own.
+///
+/// Packet layout:
+///   uint16_t sequence, uint32_t firstIndex   little endian, as PpgPacketizer
+///   uint8_t  numFrames
+///   uint8_t  k of red (low nibble) and of ir (high nibble) for the first delta
+///   red[3] ir[3]                             keyframe, FIFO_DATA bytes
+///   bit stream, MSB first, zero padded       red then ir residual of every further frame
+/// A residual v is v >> k ones, a zero and the low k bits of v; from kEscapeLength ones on
+/// it is kEscapeLength ones and v in kResidualBits bits. That bounds a frame to
+/// kMaxFrameBits and the encoder to constant work per sample.
+class PpgRicePacketizer
+{
+public:
+    static constexpr size_t kHeaderSize = 8U;
+    static constexpr size_t kKeyframeSize = PpgPacketizer::kFrameSize;
+    static constexpr size_t kFrameSize = PpgPacketizer::kFrameSize;
+    static constexpr size_t kMaxPayload = PpgPacketizer::kMaxPayload;
+    static constexpr size_t kMaxFrames = 255U;
+    static constexpr uint32_t kEscapeLength = 16U;
+    // zigzag of an 18-bit difference
+    static constexpr uint32_t kResidualBits = 19U;
+    static constexpr uint32_t kMaxK = 15U;
+    static constexpr uint32_t kMaxFrameBits = 2U * (kEscapeLength + kResidualBits);
+
+    explicit PpgRicePacketizer(uint16_t mtu = 23U);
+
+    /// @brief ATT MTU of the receivers, applies from the next packet on
+    void setMtu(uint16_t mtu);
+
+    /// @brief Drop the open packet and start over at sequence 0
+    void reset();
+
+    /// @brief Add numFrames frames starting at sample index firstIndex, returns how many
+    /// were taken. Stops when the next frame does not fit or at a gap to the frames in the
+    /// packet, then ready() is set and the packet has to be taken first.
+    size_t append(uint32_t firstIndex, const uint8_t *raw, size_t numFrames);
+
+    bool ready() const
+    {
+        return closed;
+    }
+
+    /// @brief Close the open packet even if it is not full, false if it holds no frames
+    bool flush();
+
+    const uint8_t *data() const
+    {
+        return packet;
+    }
+
+    size_t size() const
+    {
+        return kHeaderSize + kKeyframeSize + bytes + ((bits != 0) ? 1U : 0U);
+    }
+
+    /// @brief Frames in the open or ready packet
+    size_t frames() const
+    {
+        return count;
+    }
+
+    /// @brief The ready packet was handed on, the next one gets the next sequence number
+    void take();
+
+    /// @brief Reads the header of a received packet, false if it is malformed
+    static bool parse(const uint8_t *payload, size_t length, uint16_t &sequence,
+                      uint32_t &firstIndex, size_t &numFrames);
+
+    /// @brief Reference decoder: writes the frames of a packet to out as FIFO_DATA bytes,
+    /// false if the packet is malformed or has more than maxFrames frames
+    static bool decode(const uint8_t *payload, size_t length, uint16_t &sequence,
+                       uint32_t &firstIndex, uint8_t *out, size_t maxFrames, size_t &numFrames);
+
+private:
+    // mean residual in 1/2^kMeanShift, k follows its log2
+    static constexpr uint32_t kMeanShift = 4U;
+
+    struct Channel
+    {
+        uint32_t previous;
+        uint32_t mean;
+    };
+
+    // up to one frame beyond the limit is written before the frame is dropped again
+    uint8_t packet[kMaxPayload + kMaxFrameBits / 8U + 2U];
+    // bit stream bytes the payload limit leaves
+    size_t streamLimit = 0;
+    size_t pendingStreamLimit = 0;
+    size_t count = 0;
+    uint16_t sequence = 0;
+    uint32_t nextIndex = 0;
+    bool closed = false;
+
+    // bit writer: whole bytes of the stream, and the bits not yet written out
+    size_t bytes = 0;
+    uint64_t accumulator = 0;
+    uint32_t bits = 0;
+
+    Channel red = {0, 0};
+    Channel ir = {0, 0};
+
+    static size_t streamLimitForMtu(uint16_t mtu);
+    static uint32_t parameter(uint32_t mean);
+    static uint32_t meanForParameter(uint32_t k);
+    static uint32_t sample(const uint8_t *bytes);
+
+    void open(uint32_t firstIndex, const uint8_t *frame);
+    void encode(Channel &channel, uint32_t value);
+    void write(uint32_t value, uint32_t length);
+    void finish();
+};
+
+#endif
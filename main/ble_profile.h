@@ -4,7 +4,8 @@
 #include "host/ble_uuid.h"
 #include "host/ble_gatt.h"
 
-// BLE service with 3 characteristics - heartrate, spo2, control
+// BLE service with 6 characteristics - heartrate, spo2, signal quality, control,
+// raw ppg stream plain and Rice coded
 static const ble_uuid128_t gatt_svr_svc_uuid =
     BLE_UUID128_INIT(0x2d, 0x71, 0xa2, 0x59, 0xb4, 0x58, 0xc8, 0x12,
                      0x99, 0x99, 0x43, 0x95, 0x12, 0x2f, 0x46, 0x59);
@@ -37,6 +38,21 @@ const ble_uuid128_t gatt_svr_dsc_spo2_uuid =
     BLE_UUID128_INIT(0x11, 0x11, 0x11, 0x11, 0x12, 0x12, 0x12, 0x12,
                      0x23, 0x23, 0x23, 0x23, 0x34, 0x34, 0x34, 0x34);
 
+/********************************************************************
+    A characteristic that for signal quality: read, notify, indicate
+    SignalQualityCode of the last window, 0 when the values are valid
+********************************************************************/
+uint8_t gatt_svr_chr_quality_val;
+uint16_t gatt_svr_chr_quality_val_handle;
+static const ble_uuid128_t gatt_svr_chr_quality_uuid =
+    BLE_UUID128_INIT(0x00, 0x00, 0x00, 0x00, 0x13, 0x13, 0x13, 0x13,
+                     0x22, 0x22, 0x22, 0x22, 0x33, 0x33, 0x33, 0x33);
+
+uint8_t gatt_svr_dsc_quality_val;
+const ble_uuid128_t gatt_svr_dsc_quality_uuid =
+    BLE_UUID128_INIT(0x21, 0x21, 0x21, 0x21, 0x12, 0x12, 0x12, 0x12,
+                     0x23, 0x23, 0x23, 0x23, 0x34, 0x34, 0x34, 0x34);
+
 /********************************************************************
     A characteristic that for control: write, read
 ********************************************************************/
@@ -51,6 +67,34 @@ const ble_uuid128_t gatt_svr_dsc_ctrl_uuid =
     BLE_UUID128_INIT(0x11, 0x11, 0x11, 0x11, 0x12, 0x12, 0x12, 0x12,
                      0x23, 0x23, 0x23, 0x23, 0x34, 0x34, 0x34, 0x36);
 
+/********************************************************************
+    A characteristic for the raw red/ir samples: notify
+    packets of PpgPacketizer, see ble_ppg_packetizer.h
+********************************************************************/
+uint16_t gatt_svr_chr_raw_val_handle;
+static const ble_uuid128_t gatt_svr_chr_raw_uuid =
+    BLE_UUID128_INIT(0x00, 0x00, 0x00, 0x00, 0x14, 0x14, 0x14, 0x14,
+                     0x22, 0x22, 0x22, 0x22, 0x33, 0x33, 0x33, 0x33);
+
+uint8_t gatt_svr_dsc_raw_val;
+const ble_uuid128_t gatt_svr_dsc_raw_uuid =
+    BLE_UUID128_INIT(0x31, 0x31, 0x31, 0x31, 0x12, 0x12, 0x12, 0x12,
+                     0x23, 0x23, 0x23, 0x23, 0x34, 0x34, 0x34, 0x34);
+
+/********************************************************************
+    A characteristic for the raw red/ir samples, Rice coded: notify
+    packets of PpgRicePacketizer, see ble_ppg_rice.h
+********************************************************************/
+uint16_t gatt_svr_chr_raw_rice_val_handle;
+static const ble_uuid128_t gatt_svr_chr_raw_rice_uuid =
+    BLE_UUID128_INIT(0x00, 0x00, 0x00, 0x00, 0x15, 0x15, 0x15, 0x15,
+                     0x22, 0x22, 0x22, 0x22, 0x33, 0x33, 0x33, 0x33);
+
+uint8_t gatt_svr_dsc_raw_rice_val;
+const ble_uuid128_t gatt_svr_dsc_raw_rice_uuid =
+    BLE_UUID128_INIT(0x41, 0x41, 0x41, 0x41, 0x12, 0x12, 0x12, 0x12,
+                     0x23, 0x23, 0x23, 0x23, 0x34, 0x34, 0x34, 0x34);
+
 /********************************************************************/
 
 static int gatt_svc_access(uint16_t conn_handle, 
@@ -96,6 +140,22 @@ static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
                          BLE_GATT_CHR_F_NOTIFY | 
                          BLE_GATT_CHR_F_INDICATE,
                 .val_handle = &gatt_svr_chr_spo2_val_handle,
+            }, {
+                .uuid = &gatt_svr_chr_quality_uuid.u,
+                .access_cb = gatt_svc_access,
+                .descriptors = (struct ble_gatt_dsc_def[])
+                { {
+                      .uuid = &gatt_svr_dsc_quality_uuid.u,
+                      .att_flags = BLE_ATT_F_READ,
+                      .access_cb = gatt_svc_access,
+                    }, {
+                      0,
+                    }
+                },
+                .flags = BLE_GATT_CHR_F_READ | 
+                         BLE_GATT_CHR_F_NOTIFY | 
+                         BLE_GATT_CHR_F_INDICATE,
+                .val_handle = &gatt_svr_chr_quality_val_handle,
             }, {
                 .uuid = &gatt_svr_chr_ctrl_uuid.u,
                 .access_cb = gatt_svc_access,
@@ -113,6 +173,34 @@ static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
                          BLE_GATT_CHR_F_NOTIFY | 
                          BLE_GATT_CHR_F_INDICATE,
                 .val_handle = &gatt_svr_chr_ctrl_val_handle,                 
+            }, {
+                .uuid = &gatt_svr_chr_raw_uuid.u,
+                .access_cb = gatt_svc_access,
+                .descriptors = (struct ble_gatt_dsc_def[])
+                { {
+                      .uuid = &gatt_svr_dsc_raw_uuid.u,
+                      .att_flags = BLE_ATT_F_READ,
+                      .access_cb = gatt_svc_access,
+                    }, {
+                      0,
+                    }
+                },
+                .flags = BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &gatt_svr_chr_raw_val_handle,
+            }, {
+                .uuid = &gatt_svr_chr_raw_rice_uuid.u,
+                .access_cb = gatt_svc_access,
+                .descriptors = (struct ble_gatt_dsc_def[])
+                { {
+                      .uuid = &gatt_svr_dsc_raw_rice_uuid.u,
+                      .att_flags = BLE_ATT_F_READ,
+                      .access_cb = gatt_svc_access,
+                    }, {
+                      0,
+                    }
+                },
+                .flags = BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &gatt_svr_chr_raw_rice_val_handle,
             }, {
                 0,
             }
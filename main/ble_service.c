@@ -26,10 +26,22 @@
 #include "services/gatt/ble_svc_gatt.h"
 #include "ble_task.h"
 #include "services/ans/ble_svc_ans.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "ble_profile.h"
+#include "ble_subscriptions.h"
+#include "ble_connections.h"
 
 static gatt_svr_ctrl_char_handler_ptr ctrl_func = NULL;
 
+/* written from the NimBLE host task (GAP events) and read from the task that
+ * publishes results, the mutex guards both tables and is never held across a
+ * NimBLE call */
+static struct ble_sub_table gatt_svr_subs;
+static struct ble_conn_table gatt_svr_conns;
+static StaticSemaphore_t gatt_svr_subs_mutex_buffer;
+static SemaphoreHandle_t gatt_svr_subs_mutex = NULL;
+
 static int gatt_svr_write(struct os_mbuf *om, uint16_t min_len, uint16_t max_len,
                           void *dst, uint16_t *len);
 static int gatt_svc_access(uint16_t conn_handle, uint16_t attr_handle,
@@ -79,6 +91,13 @@ static int gatt_svr_read_chr_callback(struct ble_gatt_access_ctxt *ctxt,
                             sizeof(gatt_svr_chr_spo2_val));
         return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
     }
+    else if (attr_handle == gatt_svr_chr_quality_val_handle)
+    {
+        rc = os_mbuf_append(ctxt->om,
+                            &gatt_svr_chr_quality_val,
+                            sizeof(gatt_svr_chr_quality_val));
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
     else if (attr_handle == gatt_svr_chr_ctrl_val_handle)
     {
         rc = os_mbuf_append(ctxt->om,
@@ -131,6 +150,13 @@ static int gatt_svr_read_chr_descr_callback(struct ble_gatt_access_ctxt *ctxt,
                             sizeof(gatt_svr_chr_spo2_val));
         return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
     }
+    else if (ble_uuid_cmp(uuid, &gatt_svr_dsc_quality_uuid.u) == 0)
+    {
+        rc = os_mbuf_append(ctxt->om,
+                            &gatt_svr_dsc_quality_val,
+                            sizeof(gatt_svr_chr_quality_val));
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
     else if (ble_uuid_cmp(uuid, &gatt_svr_dsc_ctrl_uuid.u) == 0)
     {
         rc = os_mbuf_append(ctxt->om,
@@ -138,6 +164,20 @@ static int gatt_svr_read_chr_descr_callback(struct ble_gatt_access_ctxt *ctxt,
                             sizeof(gatt_svr_chr_ctrl_val));
         return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
     }
+    else if (ble_uuid_cmp(uuid, &gatt_svr_dsc_raw_uuid.u) == 0)
+    {
+        rc = os_mbuf_append(ctxt->om,
+                            &gatt_svr_dsc_raw_val,
+                            sizeof(gatt_svr_dsc_raw_val));
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    else if (ble_uuid_cmp(uuid, &gatt_svr_dsc_raw_rice_uuid.u) == 0)
+    {
+        rc = os_mbuf_append(ctxt->om,
+                            &gatt_svr_dsc_raw_rice_val,
+                            sizeof(gatt_svr_dsc_raw_rice_val));
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
     return BLE_ATT_ERR_UNLIKELY;
 }
 
@@ -163,12 +203,12 @@ gatt_svc_access(uint16_t conn_handle, uint16_t attr_handle,
     case BLE_GATT_ACCESS_OP_READ_CHR:
         if (conn_handle != BLE_HS_CONN_HANDLE_NONE)
         {
-            MODLOG_DFLT(INFO, "Characteristic read; conn_handle=%d attr_handle=%d\n",
+            MODLOG_DFLT(DEBUG, "Characteristic read; conn_handle=%d attr_handle=%d\n",
                         conn_handle, attr_handle);
         }
         else
         {
-            MODLOG_DFLT(INFO, "Characteristic read by NimBLE stack; attr_handle=%d\n",
+            MODLOG_DFLT(DEBUG, "Characteristic read by NimBLE stack; attr_handle=%d\n",
                         attr_handle);
         }
         uuid = ctxt->chr->uuid;
@@ -284,16 +324,246 @@ int gatt_svr_init(void)
         return rc;
     }
 
+    gatt_svr_subs_mutex = xSemaphoreCreateMutexStatic(&gatt_svr_subs_mutex_buffer);
+    ble_sub_init(&gatt_svr_subs);
+    ble_conn_init(&gatt_svr_conns);
+
     gatt_svr_chr_heartrate_val = 0x99;
     gatt_svr_chr_spo2_val = 0x99;
+    gatt_svr_chr_quality_val = 0;
     gatt_svr_chr_ctrl_val = 0;
 
     return 0;
 }
 
-void gatt_svr_update_data(uint8_t heartrate, uint8_t spo2) {    
+static const uint8_t *gatt_svr_chr_value(uint16_t attr_handle)
+{
+    if (attr_handle == gatt_svr_chr_heartrate_val_handle)
+    {
+        return &gatt_svr_chr_heartrate_val;
+    }
+    else if (attr_handle == gatt_svr_chr_spo2_val_handle)
+    {
+        return &gatt_svr_chr_spo2_val;
+    }
+    else if (attr_handle == gatt_svr_chr_quality_val_handle)
+    {
+        return &gatt_svr_chr_quality_val;
+    }
+    else if (attr_handle == gatt_svr_chr_ctrl_val_handle)
+    {
+        return &gatt_svr_chr_ctrl_val;
+    }
+    return NULL;
+}
+
+/* Sends the current value to one peer. The value goes along as an mbuf, so the
+ * stack does not read it back through gatt_svc_access. A failed indication
+ * gets no confirmation: the next pending one of the connection is sent in its
+ * place, until one goes out or none is left. */
+static void gatt_svr_send(const struct ble_sub_target *target)
+{
+    struct ble_sub_target current = *target;
+
+    for (;;)
+    {
+        const uint8_t *value = gatt_svr_chr_value(current.attr_handle);
+        struct os_mbuf *om = (value != NULL) ? ble_hs_mbuf_from_flat(value, sizeof(*value)) : NULL;
+        int rc = BLE_HS_ENOMEM;
+
+        if (om != NULL)
+        {
+            /* both consume om, also on failure */
+            rc = current.indicate ? ble_gatts_indicate_custom(current.conn_handle, current.attr_handle, om)
+                                  : ble_gatts_notify_custom(current.conn_handle, current.attr_handle, om);
+        }
+        if (rc == 0)
+        {
+            return;
+        }
+
+        MODLOG_DFLT(WARN, "%s failed; conn_handle=%d attr_handle=%d rc=%d\n",
+                    current.indicate ? "indicate" : "notify",
+                    current.conn_handle, current.attr_handle, rc);
+        if (!current.indicate)
+        {
+            return;
+        }
+
+        /* the entry handed back already counts as in flight, it has to be sent */
+        xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+        bool due = ble_sub_on_indicate_done(&gatt_svr_subs, current.conn_handle, &current);
+        xSemaphoreGive(gatt_svr_subs_mutex);
+        if (!due)
+        {
+            return;
+        }
+    }
+}
+
+static void gatt_svr_publish(uint16_t attr_handle)
+{
+    struct ble_sub_target targets[BLE_SUB_MAX_CONNECTIONS];
+
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    size_t count = ble_sub_collect(&gatt_svr_subs, attr_handle, targets, BLE_SUB_MAX_CONNECTIONS);
+    xSemaphoreGive(gatt_svr_subs_mutex);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        gatt_svr_send(&targets[i]);
+    }
+}
+
+void gatt_svr_update_data(uint8_t heartrate, uint8_t spo2, uint8_t quality) {
     gatt_svr_chr_heartrate_val = heartrate;
     gatt_svr_chr_spo2_val = spo2;
+    gatt_svr_chr_quality_val = quality;
+
+    gatt_svr_publish(gatt_svr_chr_heartrate_val_handle);
+    gatt_svr_publish(gatt_svr_chr_spo2_val_handle);
+    gatt_svr_publish(gatt_svr_chr_quality_val_handle);
+}
+
+static uint16_t gatt_svr_raw_handle(enum gatt_svr_raw_format format)
+{
+    return (format == GATT_SVR_RAW_RICE) ? gatt_svr_chr_raw_rice_val_handle : gatt_svr_chr_raw_val_handle;
+}
+
+uint16_t gatt_svr_raw_mtu(enum gatt_svr_raw_format format)
+{
+    uint16_t conns[BLE_SUB_MAX_CONNECTIONS];
+
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    size_t count = ble_sub_peers(&gatt_svr_subs, gatt_svr_raw_handle(format), conns, BLE_SUB_MAX_CONNECTIONS);
+    uint16_t mtu = ble_conn_min_mtu(&gatt_svr_conns, conns, count);
+    xSemaphoreGive(gatt_svr_subs_mutex);
+    return mtu;
+}
+
+void gatt_svr_send_raw(enum gatt_svr_raw_format format, const uint8_t *packet, uint16_t length)
+{
+    struct ble_sub_target targets[BLE_SUB_MAX_CONNECTIONS];
+
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    size_t count = ble_sub_collect(&gatt_svr_subs, gatt_svr_raw_handle(format), targets, BLE_SUB_MAX_CONNECTIONS);
+    xSemaphoreGive(gatt_svr_subs_mutex);
+
+    /* the packet was packed once for the smallest MTU of all of them, NimBLE
+     * consumes an mbuf per notification so each peer gets a copy of it */
+    for (size_t i = 0; i < count; i++)
+    {
+        struct os_mbuf *om = ble_hs_mbuf_from_flat(packet, length);
+        /* out of mbufs or tx buffers: the packet is lost for this peer, its
+         * sequence number shows the gap */
+        int rc = (om != NULL) ? ble_gatts_notify_custom(targets[i].conn_handle, targets[i].attr_handle, om)
+                              : BLE_HS_ENOMEM;
+        if (rc != 0)
+        {
+            MODLOG_DFLT(DEBUG, "raw notify failed; conn_handle=%d rc=%d\n", targets[i].conn_handle, rc);
+        }
+    }
+}
+
+void gatt_svr_on_subscribe(uint16_t conn_handle, uint16_t attr_handle,
+                           uint8_t cur_notify, uint8_t cur_indicate)
+{
+    if (gatt_svr_chr_value(attr_handle) == NULL &&
+        attr_handle != gatt_svr_chr_raw_val_handle && attr_handle != gatt_svr_chr_raw_rice_val_handle)
+    {
+        return;
+    }
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    int rc = ble_sub_on_subscribe(&gatt_svr_subs, conn_handle, attr_handle,
+                                  cur_notify != 0, cur_indicate != 0);
+    xSemaphoreGive(gatt_svr_subs_mutex);
+    if (rc != 0)
+    {
+        MODLOG_DFLT(ERROR, "subscription table full; conn_handle=%d attr_handle=%d\n",
+                    conn_handle, attr_handle);
+    }
+}
+
+int gatt_svr_on_connect(uint16_t conn_handle, uint16_t itvl, uint16_t latency,
+                        uint16_t supervision_timeout)
+{
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    int rc = ble_conn_on_connect(&gatt_svr_conns, conn_handle, itvl, latency, supervision_timeout);
+    xSemaphoreGive(gatt_svr_subs_mutex);
+    if (rc != 0)
+    {
+        MODLOG_DFLT(ERROR, "connection table full; conn_handle=%d\n", conn_handle);
+    }
+    return rc;
+}
+
+void gatt_svr_on_mtu(uint16_t conn_handle, uint16_t mtu)
+{
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    ble_conn_on_mtu(&gatt_svr_conns, conn_handle, mtu);
+    xSemaphoreGive(gatt_svr_subs_mutex);
+}
+
+void gatt_svr_on_conn_update(uint16_t conn_handle, uint16_t itvl, uint16_t latency,
+                             uint16_t supervision_timeout)
+{
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    ble_conn_on_update(&gatt_svr_conns, conn_handle, itvl, latency, supervision_timeout);
+    xSemaphoreGive(gatt_svr_subs_mutex);
+}
+
+void gatt_svr_on_disconnect(uint16_t conn_handle)
+{
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    ble_sub_on_disconnect(&gatt_svr_subs, conn_handle);
+    ble_conn_on_disconnect(&gatt_svr_conns, conn_handle);
+    xSemaphoreGive(gatt_svr_subs_mutex);
+}
+
+bool gatt_svr_conn_slot_free(void)
+{
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    bool free_slot = ble_conn_slot_free(&gatt_svr_conns);
+    xSemaphoreGive(gatt_svr_subs_mutex);
+    return free_slot;
+}
+
+bool gatt_svr_conn_streams_raw(uint16_t conn_handle)
+{
+    uint16_t conns[BLE_SUB_MAX_CONNECTIONS];
+    bool streams = false;
+
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    for (int format = GATT_SVR_RAW_PLAIN; format <= GATT_SVR_RAW_RICE && !streams; format++)
+    {
+        size_t count = ble_sub_peers(&gatt_svr_subs, gatt_svr_raw_handle((enum gatt_svr_raw_format)format),
+                                     conns, BLE_SUB_MAX_CONNECTIONS);
+        for (size_t i = 0; i < count; i++)
+        {
+            streams = streams || conns[i] == conn_handle;
+        }
+    }
+    xSemaphoreGive(gatt_svr_subs_mutex);
+    return streams;
+}
+
+void gatt_svr_on_notify_tx(uint16_t conn_handle, int status, uint8_t indication)
+{
+    /* an indication reports 0 when sent and once more with the confirmation
+     * (BLE_HS_EDONE) or the error */
+    if (!indication || status == 0)
+    {
+        return;
+    }
+
+    struct ble_sub_target next;
+    xSemaphoreTake(gatt_svr_subs_mutex, portMAX_DELAY);
+    bool due = ble_sub_on_indicate_done(&gatt_svr_subs, conn_handle, &next);
+    xSemaphoreGive(gatt_svr_subs_mutex);
+    if (due)
+    {
+        gatt_svr_send(&next);
+    }
 }
 
 void gatt_svr_set_ctrl_char_handler(gatt_svr_ctrl_char_handler_ptr f) {
@@ -43,7 +43,35 @@ typedef void (*gatt_svr_ctrl_char_handler_ptr)(uint8_t);
 
 void gatt_svr_register_cb(struct ble_gatt_register_ctxt *ctxt, void *arg);
 int gatt_svr_init(void);
-void gatt_svr_update_data(uint8_t heartrate, uint8_t spo2);
+/* stores the values and pushes them to the subscribed peers */
+void gatt_svr_update_data(uint8_t heartrate, uint8_t spo2, uint8_t quality);
+/* encodings of the raw sample stream, one characteristic each */
+enum gatt_svr_raw_format
+{
+    /* PpgPacketizer, 6 bytes per frame */
+    GATT_SVR_RAW_PLAIN = 0,
+    /* PpgRicePacketizer, keyframe and Rice coded deltas */
+    GATT_SVR_RAW_RICE,
+};
+
+/* smallest ATT MTU of the peers subscribed to the raw stream, 0 without any */
+uint16_t gatt_svr_raw_mtu(enum gatt_svr_raw_format format);
+/* notifies a packet to the raw stream subscribers */
+void gatt_svr_send_raw(enum gatt_svr_raw_format format, const uint8_t *packet, uint16_t length);
+/* connection and subscription bookkeeping, fed from the GAP event handler */
+int gatt_svr_on_connect(uint16_t conn_handle, uint16_t itvl, uint16_t latency,
+                        uint16_t supervision_timeout);
+void gatt_svr_on_mtu(uint16_t conn_handle, uint16_t mtu);
+void gatt_svr_on_conn_update(uint16_t conn_handle, uint16_t itvl, uint16_t latency,
+                             uint16_t supervision_timeout);
+void gatt_svr_on_subscribe(uint16_t conn_handle, uint16_t attr_handle,
+                           uint8_t cur_notify, uint8_t cur_indicate);
+void gatt_svr_on_disconnect(uint16_t conn_handle);
+/* true while another central can connect */
+bool gatt_svr_conn_slot_free(void);
+/* true while the connection is subscribed to a raw stream characteristic */
+bool gatt_svr_conn_streams_raw(uint16_t conn_handle);
+void gatt_svr_on_notify_tx(uint16_t conn_handle, int status, uint8_t indication);
 void gatt_svr_set_ctrl_char_handler(gatt_svr_ctrl_char_handler_ptr f);
 
 #ifdef __cplusplus
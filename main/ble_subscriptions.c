@@ -0,0 +1,191 @@
+#include "ble_subscriptions.h"
+
+static struct ble_sub_entry *ble_sub_find(struct ble_sub_table *table,
+                                          uint16_t conn_handle, uint16_t attr_handle)
+{
+    for (size_t i = 0; i < BLE_SUB_MAX_ENTRIES; i++)
+    {
+        struct ble_sub_entry *entry = &table->entries[i];
+        if (entry->conn_handle == conn_handle && entry->attr_handle == attr_handle)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static bool ble_sub_indication_in_flight(const struct ble_sub_table *table, uint16_t conn_handle)
+{
+    for (size_t i = 0; i < BLE_SUB_MAX_ENTRIES; i++)
+    {
+        const struct ble_sub_entry *entry = &table->entries[i];
+        if (entry->conn_handle == conn_handle && entry->in_flight)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ble_sub_clear(struct ble_sub_entry *entry)
+{
+    entry->conn_handle = BLE_SUB_CONN_NONE;
+    entry->attr_handle = 0;
+    entry->notify = 0;
+    entry->indicate = 0;
+    entry->in_flight = 0;
+    entry->pending = 0;
+}
+
+void ble_sub_init(struct ble_sub_table *table)
+{
+    for (size_t i = 0; i < BLE_SUB_MAX_ENTRIES; i++)
+    {
+        ble_sub_clear(&table->entries[i]);
+    }
+}
+
+int ble_sub_on_subscribe(struct ble_sub_table *table, uint16_t conn_handle,
+                         uint16_t attr_handle, bool cur_notify, bool cur_indicate)
+{
+    struct ble_sub_entry *entry = ble_sub_find(table, conn_handle, attr_handle);
+
+    if (!cur_notify && !cur_indicate)
+    {
+        if (entry != NULL)
+        {
+            /* an indication still in flight is the peer's problem now, the
+             * confirmation finds no entry and nothing is resent */
+            ble_sub_clear(entry);
+        }
+        return 0;
+    }
+
+    if (entry == NULL)
+    {
+        entry = ble_sub_find(table, BLE_SUB_CONN_NONE, 0);
+        if (entry == NULL)
+        {
+            return -1;
+        }
+        entry->conn_handle = conn_handle;
+        entry->attr_handle = attr_handle;
+    }
+    entry->notify = cur_notify ? 1 : 0;
+    entry->indicate = cur_indicate ? 1 : 0;
+    if (entry->notify)
+    {
+        entry->pending = 0;
+    }
+    return 0;
+}
+
+void ble_sub_on_disconnect(struct ble_sub_table *table, uint16_t conn_handle)
+{
+    for (size_t i = 0; i < BLE_SUB_MAX_ENTRIES; i++)
+    {
+        if (table->entries[i].conn_handle == conn_handle)
+        {
+            ble_sub_clear(&table->entries[i]);
+        }
+    }
+}
+
+size_t ble_sub_collect(struct ble_sub_table *table, uint16_t attr_handle,
+                       struct ble_sub_target *out, size_t max)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < BLE_SUB_MAX_ENTRIES && count < max; i++)
+    {
+        struct ble_sub_entry *entry = &table->entries[i];
+        if (entry->conn_handle == BLE_SUB_CONN_NONE || entry->attr_handle != attr_handle)
+        {
+            continue;
+        }
+
+        if (entry->notify)
+        {
+            out[count].conn_handle = entry->conn_handle;
+            out[count].attr_handle = attr_handle;
+            out[count].indicate = false;
+            count++;
+        }
+        else if (ble_sub_indication_in_flight(table, entry->conn_handle))
+        {
+            /* only the newest value is sent once the link is free */
+            entry->pending = 1;
+        }
+        else
+        {
+            entry->in_flight = 1;
+            out[count].conn_handle = entry->conn_handle;
+            out[count].attr_handle = attr_handle;
+            out[count].indicate = true;
+            count++;
+        }
+    }
+    return count;
+}
+
+bool ble_sub_on_indicate_done(struct ble_sub_table *table, uint16_t conn_handle,
+                              struct ble_sub_target *next)
+{
+    struct ble_sub_entry *due = NULL;
+
+    for (size_t i = 0; i < BLE_SUB_MAX_ENTRIES; i++)
+    {
+        struct ble_sub_entry *entry = &table->entries[i];
+        if (entry->conn_handle != conn_handle)
+        {
+            continue;
+        }
+        entry->in_flight = 0;
+        if (due == NULL && entry->pending && entry->indicate && !entry->notify)
+        {
+            due = entry;
+        }
+    }
+
+    if (due == NULL)
+    {
+        return false;
+    }
+    due->pending = 0;
+    due->in_flight = 1;
+    next->conn_handle = due->conn_handle;
+    next->attr_handle = due->attr_handle;
+    next->indicate = true;
+    return true;
+}
+
+size_t ble_sub_count(const struct ble_sub_table *table, uint16_t attr_handle)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < BLE_SUB_MAX_ENTRIES; i++)
+    {
+        const struct ble_sub_entry *entry = &table->entries[i];
+        if (entry->conn_handle != BLE_SUB_CONN_NONE && entry->attr_handle == attr_handle)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t ble_sub_peers(const struct ble_sub_table *table, uint16_t attr_handle,
+                     uint16_t *conn_handles, size_t max)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < BLE_SUB_MAX_ENTRIES && count < max; i++)
+    {
+        const struct ble_sub_entry *entry = &table->entries[i];
+        if (entry->conn_handle != BLE_SUB_CONN_NONE && entry->attr_handle == attr_handle)
+        {
+            conn_handles[count++] = entry->conn_handle;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,105 @@
+#ifndef BLE_SUBSCRIPTIONS_H
+#define BLE_SUBSCRIPTIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Which peers get a characteristic value pushed, kept from the
+ * BLE_GAP_EVENT_SUBSCRIBE events. No NimBLE calls in here, ble_service.c
+ * owns the table and sends what ble_sub_collect() returns.
+ *
+ * A peer that enables notifications gets notifications. Indications are
+ * opt-in: only a peer that enables indications and not notifications gets
+ * them, and at most one is outstanding per connection, as ATT allows. A value
+ * that changes while an indication waits for its confirmation is sent once
+ * the confirmation (or the timeout) arrives.
+ */
+
+#ifdef CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+#define BLE_SUB_MAX_CONNECTIONS CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+#else
+#define BLE_SUB_MAX_CONNECTIONS 4
+#endif
+
+/** Characteristics with notify/indicate per connection: heartrate, spo2, quality, ctrl, raw, raw rice */
+#define BLE_SUB_MAX_ATTRS 6
+
+#define BLE_SUB_MAX_ENTRIES (BLE_SUB_MAX_CONNECTIONS * BLE_SUB_MAX_ATTRS)
+
+/** Same value as BLE_HS_CONN_HANDLE_NONE, marks a free entry */
+#define BLE_SUB_CONN_NONE 0xFFFF
+
+struct ble_sub_entry
+{
+    uint16_t conn_handle;
+    uint16_t attr_handle;
+    uint8_t notify;
+    uint8_t indicate;
+    /* indication sent, confirmation not received yet */
+    uint8_t in_flight;
+    /* value changed while an indication of this connection was in flight */
+    uint8_t pending;
+};
+
+struct ble_sub_table
+{
+    struct ble_sub_entry entries[BLE_SUB_MAX_ENTRIES];
+};
+
+/** One value to send */
+struct ble_sub_target
+{
+    uint16_t conn_handle;
+    uint16_t attr_handle;
+    bool indicate;
+};
+
+void ble_sub_init(struct ble_sub_table *table);
+
+/**
+ * Apply a BLE_GAP_EVENT_SUBSCRIBE event, cur_notify and cur_indicate as the
+ * peer left its CCCD. Returns 0, or -1 when the table is full.
+ */
+int ble_sub_on_subscribe(struct ble_sub_table *table, uint16_t conn_handle,
+                         uint16_t attr_handle, bool cur_notify, bool cur_indicate);
+
+/** Drop every subscription of a closed connection */
+void ble_sub_on_disconnect(struct ble_sub_table *table, uint16_t conn_handle);
+
+/**
+ * The value of attr_handle changed: fills out with up to max peers to send it
+ * to and returns their number. Indications returned here count as in flight.
+ */
+size_t ble_sub_collect(struct ble_sub_table *table, uint16_t attr_handle,
+                       struct ble_sub_target *out, size_t max);
+
+/**
+ * The outstanding indication of conn_handle was confirmed or failed. Returns
+ * true and fills next when a value changed meanwhile and is due now; it then
+ * counts as in flight.
+ */
+bool ble_sub_on_indicate_done(struct ble_sub_table *table, uint16_t conn_handle,
+                              struct ble_sub_target *next);
+
+/** Peers that get attr_handle pushed in any way */
+size_t ble_sub_count(const struct ble_sub_table *table, uint16_t attr_handle);
+
+/** Fills conn_handles with up to max peers subscribed to attr_handle, returns their number */
+size_t ble_sub_peers(const struct ble_sub_table *table, uint16_t attr_handle,
+                     uint16_t *conn_handles, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdbool.h>
 
 #include "ble_task.h"
+#include "ble_link_policy.h"
 
 #include "esp_log.h"
 #include "nvs_flash.h"
@@ -12,14 +13,32 @@
 #include "services/gap/ble_svc_gap.h"
 #include "nimble/ble.h"
 #include "modlog/modlog.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 static const char *bletag = "BLE";
 
 static uint8_t own_addr_type;
 
+#if defined(CONFIG_BT_NIMBLE_LL_CFG_FEAT_LE_2M_PHY)
+static constexpr bool kLinkPhy2m = true;
+#else
+// the ESP32 controller is Bluetooth 4.2, 1M PHY only
+static constexpr bool kLinkPhy2m = false;
+#endif
+
+/* fed from the GAP events in the host task and from ble_link_update(), the
+ * mutex is never held across a NimBLE call */
+static struct ble_link_policy link_policy;
+static StaticSemaphore_t link_policy_mutex_buffer;
+static SemaphoreHandle_t link_policy_mutex = NULL;
+
 static int bleprph_gap_event(struct ble_gap_event *event, void *arg);
 static void bleprph_print_conn_desc(struct ble_gap_conn_desc *desc);
 static void bleprph_advertise(void);
+static void bleprph_advertise_if_free(void);
+static uint32_t bleprph_now_ms(void);
+static void bleprph_apply_link_action(const struct ble_link_action *action);
 static void bleprph_on_reset(int reason);
 static void bleprph_on_sync(void);
 static int bleprph_gap_event(struct ble_gap_event *event, void *arg);
@@ -121,6 +140,91 @@ static void bleprph_advertise(void)
     }
 }
 
+/**
+ * Resumes advertising while another central can connect. A connection stops
+ * advertising, with every slot taken it stays off until a central leaves.
+ */
+static void bleprph_advertise_if_free(void)
+{
+    if (gatt_svr_conn_slot_free() && !ble_gap_adv_active())
+    {
+        bleprph_advertise();
+    }
+}
+
+static uint32_t bleprph_now_ms(void)
+{
+    return static_cast<uint32_t>(xTaskGetTickCount()) * portTICK_PERIOD_MS;
+}
+
+/**
+ * Asks the central for what the link policy decided. A parameter request
+ * the stack turns down right away counts as refused.
+ */
+static void bleprph_apply_link_action(const struct ble_link_action *action)
+{
+    int rc;
+
+    if (action->flags & BLE_LINK_ACTION_DATA_LEN)
+    {
+        rc = ble_gap_set_data_len(action->conn_handle, BLE_LINK_DATA_LEN_OCTETS,
+                                  BLE_LINK_DATA_LEN_TIME_US);
+        if (rc != 0)
+        {
+            MODLOG_DFLT(WARN, "data length request failed; conn_handle=%d rc=%d\n",
+                        action->conn_handle, rc);
+        }
+    }
+
+    if ((action->flags & BLE_LINK_ACTION_PHY_2M) && kLinkPhy2m)
+    {
+        rc = ble_gap_set_prefered_le_phy(action->conn_handle, BLE_GAP_LE_PHY_2M_MASK,
+                                         BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_CODED_ANY);
+        if (rc != 0)
+        {
+            MODLOG_DFLT(WARN, "2M PHY request failed; conn_handle=%d rc=%d\n",
+                        action->conn_handle, rc);
+        }
+    }
+
+    if (action->flags & BLE_LINK_ACTION_PARAMS)
+    {
+        struct ble_gap_upd_params params;
+        memset(&params, 0, sizeof params);
+        params.itvl_min = action->params.itvl_min;
+        params.itvl_max = action->params.itvl_max;
+        params.latency = action->params.latency;
+        params.supervision_timeout = action->params.supervision_timeout;
+
+        MODLOG_DFLT(INFO, "requesting conn_itvl=%d..%d conn_latency=%d; conn_handle=%d\n",
+                    params.itvl_min, params.itvl_max, params.latency, action->conn_handle);
+        rc = ble_gap_update_params(action->conn_handle, &params);
+        if (rc != 0)
+        {
+            MODLOG_DFLT(WARN, "connection update request failed; conn_handle=%d rc=%d\n",
+                        action->conn_handle, rc);
+            xSemaphoreTake(link_policy_mutex, portMAX_DELAY);
+            ble_link_on_conn_update(&link_policy, action->conn_handle, rc, 0, 0);
+            xSemaphoreGive(link_policy_mutex);
+        }
+    }
+}
+
+extern "C" void ble_link_update(bool sensor_running)
+{
+    struct ble_link_action actions[BLE_CONN_MAX];
+
+    xSemaphoreTake(link_policy_mutex, portMAX_DELAY);
+    ble_link_set_sensor_running(&link_policy, sensor_running);
+    size_t count = ble_link_poll(&link_policy, bleprph_now_ms(), actions, BLE_CONN_MAX);
+    xSemaphoreGive(link_policy_mutex);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        bleprph_apply_link_action(&actions[i]);
+    }
+}
+
 static void bleprph_on_reset(int reason)
 {
     MODLOG_DFLT(ERROR, "Resetting state; reason=%d\n", reason);
@@ -178,22 +282,29 @@ static int bleprph_gap_event(struct ble_gap_event *event, void *arg)
             rc = ble_gap_conn_find(event->connect.conn_handle, &desc);
             assert(rc == 0);
             bleprph_print_conn_desc(&desc);
+            gatt_svr_on_connect(desc.conn_handle, desc.conn_itvl, desc.conn_latency,
+                                desc.supervision_timeout);
+            xSemaphoreTake(link_policy_mutex, portMAX_DELAY);
+            ble_link_on_connect(&link_policy, desc.conn_handle, bleprph_now_ms());
+            xSemaphoreGive(link_policy_mutex);
         }
         MODLOG_DFLT(INFO, "\n");
 
-        if (event->connect.status != 0)
-        {
-            bleprph_advertise();
-        }
+        /* failed, or connected with a slot left for the next central */
+        bleprph_advertise_if_free();
         return 0;
 
     case BLE_GAP_EVENT_DISCONNECT:
         MODLOG_DFLT(INFO, "disconnect; reason=%d ", event->disconnect.reason);
         bleprph_print_conn_desc(&event->disconnect.conn);
         MODLOG_DFLT(INFO, "\n");
+        gatt_svr_on_disconnect(event->disconnect.conn.conn_handle);
+        xSemaphoreTake(link_policy_mutex, portMAX_DELAY);
+        ble_link_on_disconnect(&link_policy, event->disconnect.conn.conn_handle);
+        xSemaphoreGive(link_policy_mutex);
 
-        /* Connection terminated; resume advertising. */
-        bleprph_advertise();
+        /* Connection terminated; a slot is free, resume advertising. */
+        bleprph_advertise_if_free();
         return 0;
 
     case BLE_GAP_EVENT_CONN_UPDATE:
@@ -204,12 +315,18 @@ static int bleprph_gap_event(struct ble_gap_event *event, void *arg)
         assert(rc == 0);
         bleprph_print_conn_desc(&desc);
         MODLOG_DFLT(INFO, "\n");
+        gatt_svr_on_conn_update(desc.conn_handle, desc.conn_itvl, desc.conn_latency,
+                                desc.supervision_timeout);
+        xSemaphoreTake(link_policy_mutex, portMAX_DELAY);
+        ble_link_on_conn_update(&link_policy, desc.conn_handle, event->conn_update.status,
+                                desc.conn_itvl, desc.conn_latency);
+        xSemaphoreGive(link_policy_mutex);
         return 0;
 
     case BLE_GAP_EVENT_ADV_COMPLETE:
         MODLOG_DFLT(INFO, "advertise complete; reason=%d",
                     event->adv_complete.reason);
-        bleprph_advertise();
+        bleprph_advertise_if_free();
         return 0;
 
     case BLE_GAP_EVENT_ENC_CHANGE:
@@ -223,12 +340,15 @@ static int bleprph_gap_event(struct ble_gap_event *event, void *arg)
         return 0;
 
     case BLE_GAP_EVENT_NOTIFY_TX:
-        MODLOG_DFLT(INFO, "notify_tx event; conn_handle=%d attr_handle=%d "
+        MODLOG_DFLT(DEBUG, "notify_tx event; conn_handle=%d attr_handle=%d "
                           "status=%d is_indication=%d",
                     event->notify_tx.conn_handle,
                     event->notify_tx.attr_handle,
                     event->notify_tx.status,
                     event->notify_tx.indication);
+        gatt_svr_on_notify_tx(event->notify_tx.conn_handle,
+                              event->notify_tx.status,
+                              event->notify_tx.indication);
         return 0;
 
     case BLE_GAP_EVENT_SUBSCRIBE:
@@ -241,6 +361,14 @@ static int bleprph_gap_event(struct ble_gap_event *event, void *arg)
                     event->subscribe.cur_notify,
                     event->subscribe.prev_indicate,
                     event->subscribe.cur_indicate);
+        gatt_svr_on_subscribe(event->subscribe.conn_handle,
+                              event->subscribe.attr_handle,
+                              event->subscribe.cur_notify,
+                              event->subscribe.cur_indicate);
+        xSemaphoreTake(link_policy_mutex, portMAX_DELAY);
+        ble_link_set_streams_raw(&link_policy, event->subscribe.conn_handle,
+                                 gatt_svr_conn_streams_raw(event->subscribe.conn_handle));
+        xSemaphoreGive(link_policy_mutex);
         return 0;
 
     case BLE_GAP_EVENT_MTU:
@@ -248,6 +376,15 @@ static int bleprph_gap_event(struct ble_gap_event *event, void *arg)
                     event->mtu.conn_handle,
                     event->mtu.channel_id,
                     event->mtu.value);
+        gatt_svr_on_mtu(event->mtu.conn_handle, event->mtu.value);
+        return 0;
+
+    case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE:
+        MODLOG_DFLT(INFO, "phy update event; conn_handle=%d status=%d tx_phy=%d rx_phy=%d\n",
+                    event->phy_updated.conn_handle,
+                    event->phy_updated.status,
+                    event->phy_updated.tx_phy,
+                    event->phy_updated.rx_phy);
         return 0;
 
     case BLE_GAP_EVENT_REPEAT_PAIRING:
@@ -316,6 +453,9 @@ extern "C" void init_ble(gatt_svr_ctrl_char_handler_ptr f)
     rc = gatt_svr_init();
     assert(rc == 0);
 
+    link_policy_mutex = xSemaphoreCreateMutexStatic(&link_policy_mutex_buffer);
+    ble_link_init(&link_policy, kLinkPhy2m);
+
     /* Set callback to put new commands to queue */
     gatt_svr_set_ctrl_char_handler(f);
 
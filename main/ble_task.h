@@ -9,6 +9,8 @@ extern "C" {
 
 void bleprph_host_task(void *param);
 void init_ble(gatt_svr_ctrl_char_handler_ptr f);
+/* feeds the sensor state to the link policy and requests what is due */
+void ble_link_update(bool sensor_running);
 
 #ifdef __cplusplus
 }
@@ -1,4 +1,7 @@
 #include "i2c_helper.h"
+#include "esp_timer.h"
+
+#include <string.h>
 
 const std::string tag{"I2Chelper"};
 
@@ -12,29 +15,144 @@ i2c_master_dev_handle_t I2CHelper::get_handler(uint8_t i2cAdress)
     dev_cfg.scl_speed_hz = kI2cInstanceSpeed;
 
     i2cMutex.lock();
+    auto it = devices.find(i2cAdress);
+    if (it != devices.end())
+    {
+        stats.handleReuses++;
+        dev_handle = it->second;
+        i2cMutex.unlock();
+        return dev_handle;
+    }
+
+    int64_t attachStart = esp_timer_get_time();
     ESP_ERROR_CHECK(i2c_master_probe(bus_handle, i2cAdress, i2cTimeoutMs));
     ESP_ERROR_CHECK(i2c_master_bus_add_device(bus_handle, &dev_cfg, &dev_handle));
+    int64_t attachTimeUs = esp_timer_get_time() - attachStart;
+
+    devices[i2cAdress] = dev_handle;
+    stats.deviceAttaches++;
+    stats.attachTimeUs += attachTimeUs;
     i2cMutex.unlock();
 
+    ESP_LOGI(tag.c_str(), "attached device 0x%02x in %lld us", i2cAdress, (long long)attachTimeUs);
+
     return dev_handle;
 }
 
+esp_err_t I2CHelper::i2c_remove_device(uint8_t i2cAdress)
+{
+    i2cMutex.lock();
+    auto it = devices.find(i2cAdress);
+    if (it == devices.end())
+    {
+        i2cMutex.unlock();
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t err = i2c_master_bus_rm_device(it->second);
+    shadows.erase(it->second);
+    devices.erase(it);
+    i2cMutex.unlock();
+
+    return err;
+}
+
+void I2CHelper::i2c_remove_all_devices()
+{
+    i2cMutex.lock();
+    for (auto &device : devices)
+    {
+        ESP_ERROR_CHECK(i2c_master_bus_rm_device(device.second));
+    }
+    devices.clear();
+    shadows.clear();
+    i2cMutex.unlock();
+}
+
 esp_err_t I2CHelper::i2c_write_register(i2c_master_dev_handle_t dev_handle,
                                         SensRegs::Regs registerNum,
                                         uint8_t registerValue)
 {
     uint8_t data_wr[2] = {static_cast<uint8_t>(registerNum), registerValue};
+    uint8_t shadowValue = 0;
 
     // ESP_LOGI(tag.c_str(), "write reg=%d dev_handle=%d", int(registerNum), int(dev_handle));
     i2cMutex.lock();
+    if (shadowLookup(dev_handle, data_wr[0], &shadowValue) && shadowValue == registerValue)
+    {
+        stats.elidedWrites++;
+        i2cMutex.unlock();
+        return ESP_OK;
+    }
+
     esp_err_t err = i2c_master_transmit(dev_handle,
                                         data_wr,
                                         2,
                                         i2cTimeoutMs);
+    stats.transactions++;
+    if (err == ESP_OK)
+    {
+        shadowStore(dev_handle, data_wr[0], &registerValue, 1);
+    }
     i2cMutex.unlock();
     return err;
 };
 
+esp_err_t I2CHelper::i2c_write_register_sequence(i2c_master_dev_handle_t dev_handle,
+                                                 const RegisterWrite *sequence,
+                                                 size_t count)
+{
+    esp_err_t err = ESP_OK;
+
+    i2cMutex.lock();
+    for (size_t i = 0; i < count && err == ESP_OK;)
+    {
+        uint8_t data_wr[kMaxBurstWriteSize + 1];
+        uint8_t firstRegister = static_cast<uint8_t>(sequence[i].registerNum);
+        size_t runLength = 0;
+
+        // the register pointer auto-increments on writes, except on FIFO_DATA
+        do
+        {
+            data_wr[1 + runLength] = sequence[i + runLength].value;
+            runLength++;
+        } while (i + runLength < count && runLength < kMaxBurstWriteSize &&
+                 firstRegister != static_cast<uint8_t>(SensRegs::Regs::FIFO_DATA) &&
+                 static_cast<uint8_t>(sequence[i + runLength].registerNum) == firstRegister + runLength);
+
+        // skip the burst when the device already holds all of its values
+        bool unchanged = true;
+        for (size_t k = 0; k < runLength && unchanged; k++)
+        {
+            uint8_t shadowValue = 0;
+            unchanged = shadowLookup(dev_handle, firstRegister + k, &shadowValue) &&
+                        shadowValue == data_wr[1 + k];
+        }
+
+        if (unchanged)
+        {
+            stats.elidedWrites++;
+        }
+        else
+        {
+            data_wr[0] = firstRegister;
+            err = i2c_master_transmit(dev_handle,
+                                      data_wr,
+                                      runLength + 1,
+                                      i2cTimeoutMs);
+            stats.transactions++;
+            if (err == ESP_OK)
+            {
+                shadowStore(dev_handle, firstRegister, &data_wr[1], runLength);
+            }
+        }
+        i += runLength;
+    }
+    i2cMutex.unlock();
+
+    return err;
+}
+
 esp_err_t I2CHelper::i2c_read_register(i2c_master_dev_handle_t dev_handle,
                                        SensRegs::Regs registerNum,
                                        uint8_t *registerValue)
@@ -44,12 +162,24 @@ esp_err_t I2CHelper::i2c_read_register(i2c_master_dev_handle_t dev_handle,
     // ESP_LOGI(tag.c_str(), "read reg=%d dev_handle=%d", int(registerNum), int(dev_handle));
 
     i2cMutex.lock();
+    if (shadowLookup(dev_handle, buf, registerValue))
+    {
+        stats.cachedReads++;
+        i2cMutex.unlock();
+        return ESP_OK;
+    }
+
     esp_err_t err = i2c_master_transmit_receive(dev_handle,
                                                 &buf,
                                                 1,
                                                 registerValue,
                                                 1,
                                                 i2cTimeoutMs);
+    stats.transactions++;
+    if (err == ESP_OK)
+    {
+        shadowStore(dev_handle, buf, registerValue, 1);
+    }
     i2cMutex.unlock();
 
     return err;
@@ -64,6 +194,7 @@ esp_err_t I2CHelper::i2c_read_mult_register(i2c_master_dev_handle_t dev_handle,
 
     // ESP_LOGI(tag.c_str(), "readm reg=%d dev_handle=%d", int(registerNum), int(dev_handle));
 
+    // bursts always go to the bus, they are used for status and fifo data
     i2cMutex.lock();
     esp_err_t err = i2c_master_transmit_receive(dev_handle,
                                                 &buf,
@@ -71,7 +202,227 @@ esp_err_t I2CHelper::i2c_read_mult_register(i2c_master_dev_handle_t dev_handle,
                                                 registerValue,
                                                 dataAmount,
                                                 i2cTimeoutMs);
+    stats.transactions++;
+    if (err == ESP_OK)
+    {
+        shadowStore(dev_handle, buf, registerValue, dataAmount);
+    }
     i2cMutex.unlock();
 
     return err;
-};
\ No newline at end of file
+};
+
+bool I2CHelper::RegisterShadow::cacheable(uint8_t reg, uint8_t regValue) const
+{
+    if (isVolatile[reg])
+    {
+        return false;
+    }
+
+    auto it = selfClearing.find(reg);
+    return it == selfClearing.end() || (regValue & it->second) == 0;
+}
+
+void I2CHelper::shadowStore(i2c_master_dev_handle_t dev_handle, uint8_t firstRegister,
+                            const uint8_t *values, size_t count)
+{
+    RegisterShadow &shadow = shadows[dev_handle];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t reg = firstRegister + i;
+        // the register pointer stops on FIFO_DATA, the rest of the burst is fifo content
+        if (reg == static_cast<uint8_t>(SensRegs::Regs::FIFO_DATA))
+        {
+            break;
+        }
+
+        if (shadow.cacheable(reg, values[i]))
+        {
+            shadow.value[reg] = values[i];
+            shadow.valid[reg] = true;
+        }
+        else
+        {
+            shadow.valid[reg] = false;
+        }
+    }
+}
+
+bool I2CHelper::shadowLookup(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t *value)
+{
+    auto it = shadows.find(dev_handle);
+    if (it == shadows.end() || !it->second.valid[reg] || it->second.isVolatile[reg])
+    {
+        return false;
+    }
+
+    *value = it->second.value[reg];
+    return true;
+}
+
+void I2CHelper::i2c_set_register_volatile(i2c_master_dev_handle_t dev_handle, SensRegs::Regs registerNum)
+{
+    i2cMutex.lock();
+    RegisterShadow &shadow = shadows[dev_handle];
+    shadow.isVolatile[static_cast<uint8_t>(registerNum)] = true;
+    shadow.valid[static_cast<uint8_t>(registerNum)] = false;
+    i2cMutex.unlock();
+}
+
+void I2CHelper::i2c_set_register_self_clearing(i2c_master_dev_handle_t dev_handle, SensRegs::Regs registerNum,
+                                               uint8_t mask)
+{
+    i2cMutex.lock();
+    RegisterShadow &shadow = shadows[dev_handle];
+    shadow.selfClearing[static_cast<uint8_t>(registerNum)] = mask;
+    shadow.valid[static_cast<uint8_t>(registerNum)] = false;
+    i2cMutex.unlock();
+}
+
+void I2CHelper::i2c_invalidate_shadow(i2c_master_dev_handle_t dev_handle)
+{
+    i2cMutex.lock();
+    auto it = shadows.find(dev_handle);
+    if (it != shadows.end())
+    {
+        it->second.valid.reset();
+    }
+    i2cMutex.unlock();
+}
+
+I2CStats I2CHelper::i2c_get_stats()
+{
+    i2cMutex.lock();
+    I2CStats current = stats;
+    i2cMutex.unlock();
+    return current;
+}
+
+esp_err_t I2CHelper::i2c_submit(const I2CTransaction &transaction)
+{
+    if (transaction.type == I2CTransactionType::I2C_TRANSACTION_WRITE &&
+        transaction.dataAmount > kAsyncMaxWriteSize)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    workerMutex.lock();
+    if (workerTask == nullptr)
+    {
+        if (transactionQueue == nullptr)
+        {
+            transactionQueue = xQueueCreate(kAsyncQueueLength, sizeof(I2CTransaction));
+        }
+        if (workerExit == nullptr)
+        {
+            workerExit = xSemaphoreCreateBinary();
+        }
+        if (transactionQueue == nullptr || workerExit == nullptr ||
+            xTaskCreate(busWorker, "I2CWorker", kWorkerStackSize, this,
+                        tskIDLE_PRIORITY + 1, &workerTask) != pdPASS)
+        {
+            workerTask = nullptr;
+            workerMutex.unlock();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    workerMutex.unlock();
+
+    if (xQueueSend(transactionQueue, &transaction, pdMS_TO_TICKS(i2cTimeoutMs)) != pdTRUE)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    return ESP_OK;
+}
+
+void I2CHelper::i2c_stop_worker()
+{
+    workerMutex.lock();
+    if (workerTask != nullptr)
+    {
+        I2CTransaction stop{};
+        stop.type = I2CTransactionType::I2C_TRANSACTION_STOP_WORKER;
+
+        xQueueSend(transactionQueue, &stop, portMAX_DELAY);
+        xSemaphoreTake(workerExit, portMAX_DELAY);
+        workerTask = nullptr;
+    }
+    if (transactionQueue != nullptr)
+    {
+        vQueueDelete(transactionQueue);
+        transactionQueue = nullptr;
+    }
+    if (workerExit != nullptr)
+    {
+        vSemaphoreDelete(workerExit);
+        workerExit = nullptr;
+    }
+    workerMutex.unlock();
+}
+
+esp_err_t I2CHelper::execute(const I2CTransaction &transaction)
+{
+    if (transaction.type == I2CTransactionType::I2C_TRANSACTION_READ)
+    {
+        return i2c_read_mult_register(transaction.dev_handle,
+                                      transaction.registerNum,
+                                      transaction.data,
+                                      transaction.dataAmount);
+    }
+
+    uint8_t data_wr[kAsyncMaxWriteSize + 1];
+    data_wr[0] = static_cast<uint8_t>(transaction.registerNum);
+    memcpy(&data_wr[1], transaction.data, transaction.dataAmount);
+
+    i2cMutex.lock();
+    esp_err_t err = i2c_master_transmit(transaction.dev_handle,
+                                        data_wr,
+                                        transaction.dataAmount + 1,
+                                        i2cTimeoutMs);
+    stats.transactions++;
+    if (err == ESP_OK)
+    {
+        shadowStore(transaction.dev_handle, data_wr[0], transaction.data, transaction.dataAmount);
+    }
+    i2cMutex.unlock();
+
+    return err;
+}
+
+void I2CHelper::busWorker(void *parameters)
+{
+    I2CHelper *self = static_cast<I2CHelper *>(parameters);
+
+    for (;;)
+    {
+        I2CTransaction transaction;
+        if (xQueueReceive(self->transactionQueue, &transaction, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+
+        if (transaction.type == I2CTransactionType::I2C_TRANSACTION_STOP_WORKER)
+        {
+            xSemaphoreGive(self->workerExit);
+            vTaskDelete(NULL);
+            return;
+        }
+
+        esp_err_t err = self->execute(transaction);
+
+        if (transaction.result != nullptr)
+        {
+            *transaction.result = err;
+        }
+        if (transaction.callback != nullptr)
+        {
+            transaction.callback(err, transaction.callbackArg);
+        }
+        if (transaction.done != nullptr)
+        {
+            xSemaphoreGive(transaction.done);
+        }
+    }
+}
\ No newline at end of file
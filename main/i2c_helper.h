@@ -2,14 +2,67 @@
 #define I2C_HELPER_H
 
 #include "driver/i2c_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "sensor_registers.h"
 
+#include <bitset>
+#include <map>
 #include <string>
 #include <mutex>
 
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
 
+enum class I2CTransactionType
+{
+    I2C_TRANSACTION_WRITE = 0,
+    I2C_TRANSACTION_READ,
+    I2C_TRANSACTION_STOP_WORKER,
+};
+
+/// @brief One entry of a register image
+struct RegisterWrite
+{
+    SensRegs::Regs registerNum;
+    uint8_t value;
+};
+
+typedef void (*i2c_completion_cb_t)(esp_err_t err, void *arg);
+
+/// @brief Descriptor of a queued register transaction.
+/// The data buffer is owned by the caller and has to stay valid until completion.
+struct I2CTransaction
+{
+    i2c_master_dev_handle_t dev_handle;
+    I2CTransactionType type;
+    SensRegs::Regs registerNum;
+    uint8_t *data;
+    size_t dataAmount;
+    // optional, called from the bus worker task after the transfer
+    i2c_completion_cb_t callback;
+    void *callbackArg;
+    // optional, binary semaphore given after the callback
+    SemaphoreHandle_t done;
+    // optional, receives the transfer status before the semaphore is given
+    esp_err_t *result;
+};
+
+/// @brief Bus traffic counters, elided writes and cached reads are transactions saved by the shadow,
+/// handle reuses are probe/attach sequences saved by the device registry
+struct I2CStats
+{
+    uint32_t transactions;
+    uint32_t elidedWrites;
+    uint32_t cachedReads;
+    uint32_t deviceAttaches;
+    uint32_t handleReuses;
+    // time spent in probe and attach
+    int64_t attachTimeUs;
+};
+
 class I2CHelper
 {
 public:
@@ -24,13 +77,26 @@ public:
 
     ~I2CHelper()
     {
+        i2c_stop_worker();
+        // the bus can only be deleted once no device is attached
+        i2c_remove_all_devices();
         ESP_ERROR_CHECK(i2c_del_master_bus(bus_handle));
     };
 
+    /// @brief Handle of the device at this address. The first call probes and attaches it,
+    /// later calls return the cached handle until the device is removed.
     i2c_master_dev_handle_t get_handler(uint8_t i2cAdress);
+    /// @brief Detach the device from the bus and drop its shadow, its handle becomes invalid
+    esp_err_t i2c_remove_device(uint8_t i2cAdress);
+    void i2c_remove_all_devices();
     esp_err_t i2c_write_register(i2c_master_dev_handle_t dev_handle,
                                  SensRegs::Regs registerNum,
                                  uint8_t registerValue);
+    /// @brief Write a register image under one lock. Entries are written in table order,
+    /// runs of entries with consecutive register addresses are sent as one burst.
+    esp_err_t i2c_write_register_sequence(i2c_master_dev_handle_t dev_handle,
+                                          const RegisterWrite *sequence,
+                                          size_t count);
     esp_err_t i2c_read_register(i2c_master_dev_handle_t dev_handle,
                                 SensRegs::Regs registerNum,
                                 uint8_t *registerValue);
@@ -39,13 +105,60 @@ public:
                                      uint8_t *registerValue,
                                      size_t dataAmount);
 
+    /// @brief Registers changed by the device itself (status, fifo) are never cached
+    void i2c_set_register_volatile(i2c_master_dev_handle_t dev_handle, SensRegs::Regs registerNum);
+    /// @brief Values with any of these bits set are not cached (e.g. a reset bit the device clears)
+    void i2c_set_register_self_clearing(i2c_master_dev_handle_t dev_handle, SensRegs::Regs registerNum,
+                                        uint8_t mask);
+    /// @brief Forget cached values, e.g. after a device reset restored its defaults
+    void i2c_invalidate_shadow(i2c_master_dev_handle_t dev_handle);
+    I2CStats i2c_get_stats();
+
+    /// @brief Queue a transaction for the bus worker and return immediately.
+    /// Transactions are executed in submission order, so requests to one device keep their order.
+    esp_err_t i2c_submit(const I2CTransaction &transaction);
+    void i2c_stop_worker();
+
 private:
     static constexpr auto kI2cInstanceSpeed = 400000U;
     static constexpr auto i2cTimeoutMs = 16U;
+    static constexpr auto kAsyncQueueLength = 16U;
+    static constexpr auto kAsyncMaxWriteSize = 32U;
+    static constexpr auto kMaxBurstWriteSize = 16U;
+    static constexpr auto kWorkerStackSize = 3072U;
 
     const i2c_master_bus_config_t i2c_mst_config;
     i2c_master_bus_handle_t bus_handle;
     std::mutex i2cMutex;
+
+    /// @brief Last known value of the host-owned registers of one device
+    struct RegisterShadow
+    {
+        uint8_t value[256];
+        std::bitset<256> valid;
+        std::bitset<256> isVolatile;
+        std::map<uint8_t, uint8_t> selfClearing;
+
+        bool cacheable(uint8_t reg, uint8_t regValue) const;
+    };
+
+    // guarded by i2cMutex, attached devices by address and the shadow of each handle
+    std::map<uint8_t, i2c_master_dev_handle_t> devices;
+    std::map<i2c_master_dev_handle_t, RegisterShadow> shadows;
+    I2CStats stats{};
+
+    void shadowStore(i2c_master_dev_handle_t dev_handle, uint8_t firstRegister,
+                     const uint8_t *values, size_t count);
+    bool shadowLookup(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t *value);
+
+    std::mutex workerMutex;
+    QueueHandle_t transactionQueue = nullptr;
+    TaskHandle_t workerTask = nullptr;
+    // given by the worker on STOP_WORKER, so no task notification of the caller is consumed
+    SemaphoreHandle_t workerExit = nullptr;
+
+    esp_err_t execute(const I2CTransaction &transaction);
+    static void busWorker(void *parameters);
 };
 
 #endif
\ No newline at end of file
@@ -5,12 +5,17 @@
 #include <freertos/semphr.h>
 
 #include "ble_task.h"
+#include "ble_ppg_packetizer.h"
+#include "ble_ppg_rice.h"
 #include "sensor_task.h"
+#include "sensor_profiler.h"
 
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
 
 #define QUEUE_SIZE (16U)
+// FIFO bursts waiting for the raw stream, 8 of up to 32 samples
+#define RAW_QUEUE_SIZE (8U)
 
 static const char *TAG = "main";
 
@@ -18,8 +23,12 @@ static constexpr auto kQueueTimeoutMs = 2U;
 
 QueueHandle_t SensorCommandsQueueHandle;
 QueueHandle_t SensorResultsQueueHandle;
+QueueHandle_t SensorRawQueueHandle;
 TaskHandle_t xTaskBuffer;
 
+static PpgPacketizer rawPacketizer;
+static PpgRicePacketizer rawRicePacketizer;
+
 /**
  * @brief This function should handle new data written into ctrl characteristic
  * 
@@ -32,16 +41,65 @@ void ble_ctrl_char_write_callback(uint8_t new_data) {
        command = SensorCommands::SENSOR_RUN;
     } else if (new_data == 0) {
         command = SensorCommands::SENDOR_STOP;        
+    } else if (new_data == 2) {
+        // stage timings, see sensor_profiler.h
+        SensorProfiler::dump();
+        return;
     } else {
         ESP_LOGW(TAG, "Invalid command received: %u", new_data);
         return;
     }
 
     xQueueSend(SensorCommandsQueueHandle, &command, pdMS_TO_TICKS(kQueueTimeoutMs));
+    // the sensor task sleeps on its notification between fifo interrupts
+    if (xTaskBuffer != nullptr)
+    {
+        xTaskNotifyGive(xTaskBuffer);
+    }
     ESP_LOGI(TAG, "new command=%u handled", new_data);
     return;
 }
 
+/**
+ * @brief Packs one FIFO burst into raw stream notifications of one encoding, each filled
+ * to the smallest MTU of its subscribed peers
+ */
+template <typename Packetizer>
+static void pack_raw_samples(Packetizer &packetizer, gatt_svr_raw_format format, const RawFifoChunk &chunk)
+{
+    uint16_t mtu = gatt_svr_raw_mtu(format);
+    if (mtu == 0)
+    {
+        // nobody listens, the next subscriber starts with sequence 0
+        packetizer.reset();
+        return;
+    }
+    packetizer.setMtu(mtu);
+
+    size_t done = 0;
+    while (done < chunk.numSamples)
+    {
+        done += packetizer.append(chunk.firstIndex + done,
+                                  chunk.data + done * RawFifoChunk::kBytesPerSample,
+                                  chunk.numSamples - done);
+        if (packetizer.ready())
+        {
+            gatt_svr_send_raw(format, packetizer.data(), static_cast<uint16_t>(packetizer.size()));
+            packetizer.take();
+        }
+    }
+}
+
+static void publish_raw_samples()
+{
+    RawFifoChunk chunk;
+    while (xQueueReceive(SensorRawQueueHandle, &chunk, 0) == pdTRUE)
+    {
+        pack_raw_samples(rawPacketizer, GATT_SVR_RAW_PLAIN, chunk);
+        pack_raw_samples(rawRicePacketizer, GATT_SVR_RAW_RICE, chunk);
+    }
+}
+
 extern "C" void app_main()
 {
     // Queue for commands from BLE-task to sensor task
@@ -49,6 +107,9 @@ extern "C" void app_main()
 
     // Queue for sensor results from sensor task to BLE-task
     SensorResultsQueueHandle = xQueueCreate(QUEUE_SIZE, sizeof(SensorResult));
+
+    // Queue for raw FIFO bursts from sensor task to BLE-task
+    SensorRawQueueHandle = xQueueCreate(RAW_QUEUE_SIZE, sizeof(RawFifoChunk));
         
     gatt_svr_ctrl_char_handler_ptr ptr = &ble_ctrl_char_write_callback;
 
@@ -60,9 +121,14 @@ extern "C" void app_main()
         SensorResult result;
         if (xQueueReceive(SensorResultsQueueHandle, &result, pdMS_TO_TICKS(kQueueTimeoutMs)) == true)
         {
-            ESP_LOGI(TAG, "heartRate=%ld, spo2=%ld", result.pulse, result.saturation);
-            gatt_svr_update_data(result.pulse, result.saturation);
+            ESP_LOGI(TAG, "heartRate=%ld, spo2=%ld, quality=%u", result.pulse, result.saturation,
+                     static_cast<unsigned>(result.quality));
+            SENSOR_PROFILE_SCOPE(ProfileStage::GATT_UPDATE);
+            gatt_svr_update_data(result.pulse, result.saturation, static_cast<uint8_t>(result.quality));
         }
+        publish_raw_samples();
+        // short interval while running, long with latency when stopped
+        ble_link_update(SensorTaskIsRunning());
         vTaskDelay(pdMS_TO_TICKS(1U));
     }
 }
\ No newline at end of file
@@ -0,0 +1,112 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+
+/// @brief One interleaved sample as it comes out of the fifo
+struct SampleFrame
+{
+    uint32_t red;
+    uint32_t ir;
+};
+
+/// @brief Lock-free single-producer/single-consumer ring of sample frames.
+/// Head is written only by the producer, tail only by the consumer. Indices run freely
+/// and are masked on access, so the capacity has to be a power of two.
+template <size_t Capacity>
+class SampleRing
+{
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    static constexpr size_t capacity()
+    {
+        return Capacity;
+    }
+
+    /// @brief Frames ready to be consumed, exact from the consumer side
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Free slots, exact from the producer side
+    size_t freeSpace() const
+    {
+        return Capacity - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+    }
+
+    /// @brief Producer: append up to count frames, returns how many were stored
+    size_t push(const SampleFrame *src, size_t count)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t t = tail.load(std::memory_order_acquire);
+        const size_t n = min(count, Capacity - (h - t));
+
+        for (size_t i = 0; i < n; i++)
+        {
+            frames[(h + i) & kMask] = src[i];
+        }
+
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    /// @brief Consumer: take up to count frames de-interleaved into separate channels
+    size_t pop(uint32_t *red, uint32_t *ir, size_t count)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        const size_t h = head.load(std::memory_order_acquire);
+        const size_t n = min(count, h - t);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            const SampleFrame &frame = frames[(t + i) & kMask];
+            red[i] = frame.red;
+            ir[i] = frame.ir;
+        }
+
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    /// @brief Consumer: take up to count frames as they are
+    size_t pop(SampleFrame *dst, size_t count)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        const size_t h = head.load(std::memory_order_acquire);
+        const size_t n = min(count, h - t);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            dst[i] = frames[(t + i) & kMask];
+        }
+
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    /// @brief Consumer: drop everything that is currently stored
+    void clear()
+    {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t kMask = Capacity - 1;
+
+    static constexpr size_t min(size_t a, size_t b)
+    {
+        return a < b ? a : b;
+    }
+
+    // producer and consumer indices on separate cache lines
+    alignas(32) std::atomic<size_t> head{0};
+    alignas(32) std::atomic<size_t> tail{0};
+    SampleFrame frames[Capacity];
+};
+
+#endif
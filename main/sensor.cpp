@@ -1,8 +1,20 @@
 #include <sensor.h>
 #include <string.h>
 
+#include "sensor_profiler.h"
+
 static const std::string tagMax{"Sensor"};
 
+// registers the sensor itself updates, never served from the shadow
+static constexpr SensRegs::Regs kVolatileRegisters[] = {
+    SensRegs::Regs::ISR_STAT1,
+    SensRegs::Regs::ISR_STAT2,
+    SensRegs::Regs::FIFO_WR_PTR,
+    SensRegs::Regs::FIFO_OVFLW,
+    SensRegs::Regs::FIFO_RD_PTR,
+    SensRegs::Regs::FIFO_DATA,
+};
+
 void Max30102::init()
 {
     ESP_LOGI(tagMax.c_str(), "%s", "Start init max driver");
@@ -10,6 +22,13 @@ void Max30102::init()
     sensorHandler = _i2cHelper.get_handler(kI2cAddress);
     if (sensorHandler != 0)
     {
+        for (SensRegs::Regs reg : kVolatileRegisters)
+        {
+            _i2cHelper.i2c_set_register_volatile(sensorHandler, reg);
+        }
+        // RESET in MODE_CONFIG clears itself when the reset is done
+        _i2cHelper.i2c_set_register_self_clearing(sensorHandler, SensRegs::Regs::MODE_CONFIG, kModeReset);
+
         uint8_t pid = 0;
         uint8_t rev = 0;
 
@@ -26,8 +45,14 @@ void Max30102::init()
 
         ESP_LOGI(tagMax.c_str(), "%s", "Init max driver done");
 
-        memset((void *)led1Data, 0, kLedBufferSize * sizeof(uint32_t));
-        memset((void *)led2Data, 0, kLedBufferSize * sizeof(uint32_t));
+        if (fifoReadDone == nullptr)
+        {
+            fifoReadDone = xSemaphoreCreateBinary();
+        }
+
+        samples.clear();
+        windowCorrupted = false;
+        windowQuality.restart();
     }
     else
     {
@@ -39,156 +64,375 @@ void Max30102::init()
 void Max30102::deinit()
 {
     ESP_LOGI(tagMax.c_str(), "%s", "Deinit max driver");
+
+    I2CStats stats = _i2cHelper.i2c_get_stats();
+    ESP_LOGI(tagMax.c_str(), "i2c transactions=%lu, saved: elided writes=%lu, cached reads=%lu",
+             (unsigned long)stats.transactions, (unsigned long)stats.elidedWrites,
+             (unsigned long)stats.cachedReads);
+    ESP_LOGI(tagMax.c_str(), "i2c device attaches=%lu (%lld us), handle reuses=%lu",
+             (unsigned long)stats.deviceAttaches, (long long)stats.attachTimeUs,
+             (unsigned long)stats.handleReuses);
+
+    // the handle stays attached in the I2CHelper registry and is reused by the next init
     sensorHandler = 0;
 };
 
 void Max30102::start()
 {
-    SensorReset();
-    vTaskDelay(kAfterResetTimeoutMs / portTICK_PERIOD_MS);
-    SensorConfig();
-    SensorStart();
+    // the configuration is written by pollStart() once the part is out of reset
+    esp_err_t err = SensorReset();
+    fifoSampleIndex = 0;
+    // oversampled rates are filtered down before anything else sees the frames
+    decimator.configure(config.effectiveSampleRateHz());
+    stream.setSampleRate(decimator.outputRateHz());
+    windowQuality.setSampleRate(decimator.outputRateHz());
+    spo2Window = findSpo2Window(decimator.outputRateHz());
+    if (spo2Window != nullptr && spo2Window->windowLength > kSampleRingSize)
+    {
+        spo2Window = nullptr;
+    }
+    // the beat intervals of the stream have to fit its history, sized for the algorithm rate
+    resultMode = requestedResultMode;
+    if (resultMode == ResultMode::PER_BEAT && decimator.outputRateHz() != SampleDecimator::kAlgorithmRateHz)
+    {
+        ESP_LOGW(tagMax.c_str(), "Per beat results need %lu Hz frames, %lu Hz runs in window mode",
+                 (unsigned long)SampleDecimator::kAlgorithmRateHz, (unsigned long)decimator.outputRateHz());
+        resultMode = ResultMode::WINDOW;
+    }
+    resetStartTickCount = xTaskGetTickCount();
+    startState = StartState::RESETTING;
+    // a part still busy with an earlier reset NACKs this one
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(tagMax.c_str(), "Sensor reset not acknowledged: %s", esp_err_to_name(err));
+        startState = StartState::FAILED;
+    }
 };
 
 void Max30102::stop()
 {
-    SensorStop();
+    bool disableInterrupt = (startState == StartState::RUNNING) && fifoInterruptEnabled;
+    fifoInterruptEnabled = false;
+    if (disableInterrupt)
+    {
+        writeFifoInterruptEnable();
+    }
+    // NACKed while the part is resetting, it comes out of the reset idle anyway
+    esp_err_t err = SensorStop();
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(tagMax.c_str(), "Sensor stop not acknowledged: %s", esp_err_to_name(err));
+    }
+    startState = StartState::STOPPED;
 };
 
-size_t Max30102::readData(uint32_t *data)
+bool Max30102::pollStart()
 {
-    // read new data from fifo
-    size_t amountOfSamples = readFromFifo();
-    offsetInBuffer += amountOfSamples;
-
-    if (offsetInBuffer != 0)
+    uint8_t mode = kModeReset;
+    // the part may not answer while it is resetting
+    if (_i2cHelper.i2c_read_register(sensorHandler, Regs::Regs::MODE_CONFIG, &mode) != ESP_OK ||
+        (mode & kModeReset) != 0)
     {
-        if ((offsetInBuffer > (kLedBufferSize - 64U)) ||
-            ((xTaskGetTickCount() - LastSentResultTickCount) > pdMS_TO_TICKS(10000U)))
+        if ((xTaskGetTickCount() - resetStartTickCount) > pdMS_TO_TICKS(kResetTimeoutMs))
         {
-            // calculate values from buffered value
-            if (!(ambientLightOverflow() || IsFifoOverFlow()))
-            {
-                SensorResult result = calculate(led1Data, led2Data, offsetInBuffer);
-                memcpy(data, (uint32_t *)&result, sizeof(SensorResult));
-                LastSentResultTickCount = xTaskGetTickCount();
-                return sizeof(SensorResult);
-            }
-            else
-            {
-                ESP_LOGE(tagMax.c_str(), "Ambient light or fifo overflow detected");
-                return 0;
-            }
-
-            offsetInBuffer = 0;
-            memset((void *)led1Data, 0, kLedBufferSize * sizeof(uint32_t));
-            memset((void *)led2Data, 0, kLedBufferSize * sizeof(uint32_t));
+            ESP_LOGE(tagMax.c_str(), "%s", "Sensor did not come out of reset");
+            startState = StartState::FAILED;
         }
+        return false;
+    }
+
+    // clears a pending PWR_RDY and releases the INT line before sampling starts
+    StatusSnapshot status = readStatus();
+    if (status.powerReady())
+    {
+        ESP_LOGW(tagMax.c_str(), "%s", "Sensor power cycled during start");
+    }
+
+    SensorStart(config);
+    // the reset cleared the interrupt enable registers
+    if (fifoInterruptEnabled)
+    {
+        writeFifoInterruptEnable();
+    }
+    startState = StartState::RUNNING;
+
+    ESP_LOGI(tagMax.c_str(), "Sensor ready after %lu ms",
+             (unsigned long)((xTaskGetTickCount() - resetStartTickCount) * portTICK_PERIOD_MS));
+    return true;
+}
+
+size_t Max30102::readData(uint32_t *data)
+{
+    if (startState == StartState::RESETTING && !pollStart())
+    {
+        return 0;
+    }
+    if (startState != StartState::RUNNING)
+    {
+        return 0;
+    }
+
+    // all decisions of this cycle are taken from one status read
+    StatusSnapshot status = readStatus();
+    bool corrupted = status.ambientLightOverflow() || status.fifoOverflow();
+
+    if (resultMode == ResultMode::PER_BEAT)
+    {
+        submitFifoRead(status);
+        readFromFifo(status);
+        windowCorrupted |= corrupted;
+        return readBeats(data);
+    }
+
+    // a window complete before this cycle is calculated while the bus worker reads the
+    // burst, the overflow or ambient light of this status concerns the samples of the burst
+    size_t resultSize = readWindow(data, status);
+    readFromFifo(status);
+    windowCorrupted |= corrupted;
+    return resultSize;
+}
+
+size_t Max30102::readWindow(uint32_t *data, const StatusSnapshot &status)
+{
+    // a specialized algorithm takes exactly one window, the generic one whatever is buffered
+    size_t buffered = samples.size();
+    bool windowReady = (spo2Window != nullptr)
+                           ? (buffered >= spo2Window->windowLength)
+                           : ((buffered != 0) &&
+                              ((buffered > kCalculateThreshold) ||
+                               ((xTaskGetTickCount() - LastSentResultTickCount) > pdMS_TO_TICKS(10000U))));
+    if (!windowReady)
+    {
+        submitFifoRead(status);
+        return 0;
+    }
+
+    size_t numSamples = samples.pop(led1Data, led2Data,
+                                    (spo2Window != nullptr) ? spo2Window->windowLength : kSampleRingSize);
+    // the burst can use the space the window leaves
+    submitFifoRead(status);
+
+    bool corrupted = windowCorrupted;
+    windowCorrupted = false;
+    // the frames that stay in the ring were already counted for this window, close enough
+    SignalQualityCode quality = windowQuality.evaluate();
+    uint32_t perfusion = windowQuality.perfusion();
+    windowQuality.restart();
+
+    if (corrupted)
+    {
+        ESP_LOGE(tagMax.c_str(), "Ambient light or fifo overflow detected");
+        return 0;
+    }
+
+    // calculate values from buffered value, unless the signal can not give any
+    SensorResult result{-1, -1, quality};
+    if (quality == SignalQualityCode::GOOD)
+    {
+        result = calculate(algorithmContext, led1Data, led2Data, numSamples, spo2Window);
+    }
+    else
+    {
+        ESP_LOGI(tagMax.c_str(), "Calculation skipped: quality=%u, perfusion=%lu/10000",
+                 static_cast<unsigned>(quality), (unsigned long)perfusion);
+    }
+    memcpy(data, (uint32_t *)&result, sizeof(SensorResult));
+    LastSentResultTickCount = xTaskGetTickCount();
+    return sizeof(SensorResult);
+}
+
+size_t Max30102::readBeats(uint32_t *data)
+{
+    // a gap in the samples breaks the filter state
+    if (windowCorrupted)
+    {
+        ESP_LOGE(tagMax.c_str(), "Ambient light or fifo overflow detected");
+        windowCorrupted = false;
+        stream.reset();
+    }
 
-        if (offsetInBuffer > kLedBufferSize)
+    SampleFrame frames[kFifoDepth];
+    bool beat = false;
+    size_t numSamples = 0;
+    SENSOR_PROFILE_SCOPE(ProfileStage::STREAM);
+    while ((numSamples = samples.pop(frames, kFifoDepth)) != 0)
+    {
+        for (size_t i = 0; i < numSamples; i++)
         {
-            offsetInBuffer = 0;
+            beat |= stream.push(frames[i].red, frames[i].ir);
         }
     }
 
-    return 0;
+    if (!beat)
+    {
+        return 0;
+    }
+
+    const Spo2StreamResult &estimate = stream.result();
+    SensorResult result = (estimate.heartRateValid && estimate.spo2Valid)
+                              ? SensorResult{estimate.heartRate, estimate.spo2, SignalQualityCode::GOOD}
+                              : SensorResult{-1, -1, SignalQualityCode::NO_ESTIMATE};
+    memcpy(data, (uint32_t *)&result, sizeof(SensorResult));
+    LastSentResultTickCount = xTaskGetTickCount();
+    return sizeof(SensorResult);
 }
 
-SensorResult Max30102::calculate(uint32_t *led1Data, uint32_t *led2Data, size_t numSamplesRead)
+SensorResult Max30102::calculate(SensorAlgorithmContext &context,
+                                 uint32_t *led1Data, uint32_t *led2Data, size_t numSamplesRead,
+                                 const Spo2WindowVariant *window)
 {
     int32_t heartRate = 0;
     int8_t heartRateValid = 0;
     int32_t spo2 = 0;
     int8_t spo2Valid = 0;
 
-    maxim_heart_rate_and_oxygen_saturation(led2Data, numSamplesRead, led1Data, &spo2, &spo2Valid, &heartRate, &heartRateValid);
+    SENSOR_PROFILE_MARK(profileStart);
+    if (window != nullptr && numSamplesRead == window->windowLength)
+    {
+        window->calculate(context.window, led2Data, led1Data, &spo2, &spo2Valid, &heartRate, &heartRateValid);
+    }
+    else
+    {
+        maxim_heart_rate_and_oxygen_saturation_r(&context.generic, led2Data, numSamplesRead, led1Data,
+                                                 &spo2, &spo2Valid, &heartRate, &heartRateValid);
+    }
+    SENSOR_PROFILE_LAP(ProfileStage::CALCULATE, profileStart);
 
     ESP_LOGI(tagMax.c_str(), "Calculated: heart=%ld/%d, spo2=%ld/%d, count=%u",
              heartRate, heartRateValid, spo2, spo2Valid, numSamplesRead);
 
-    return (spo2Valid && heartRateValid) ? SensorResult{heartRate, spo2} : SensorResult{-1, -1};
+    return (spo2Valid && heartRateValid) ? SensorResult{heartRate, spo2, SignalQualityCode::GOOD}
+                                         : SensorResult{-1, -1, SignalQualityCode::NO_ESTIMATE};
+}
+
+void Max30102::SensorStart(const SensorConfigStruct &config) const
+{
+    const StartImage image = makeStartImage(config);
+    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register_sequence(sensorHandler, image.data(), image.size()));
+}
+
+esp_err_t Max30102::SensorStop() const
+{
+    static constexpr RegisterWrite kStopImage[] = {
+        {SensRegs::Regs::MULTILED_CONFIG1, 0},
+        {SensRegs::Regs::MODE_CONFIG, 1 << 7},
+    };
+    return _i2cHelper.i2c_write_register_sequence(sensorHandler, kStopImage,
+                                                  sizeof(kStopImage) / sizeof(kStopImage[0]));
 }
 
-void Max30102::SensorConfig(const SensorConfigStruct &config)
-{
-    // LED Pulse Amplitude Configuration
-    // powerLevel = 0x02:0.4mA, 0x1F:6.4mA, 0x7F:25.4mA, 0xFF:50.0mA
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::LED1_PA,
-                                                  config.powerLevel));
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::LED2_PA,
-                                                  config.powerLevel));
-
-    // set sample average, enable rollover, set (32 - 2) as an fifo almost full threshold
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::FIFO_CONFIG,
-                                                  (static_cast<uint8_t>(config.sampleAverage) << 5) |
-                                                      (1 << 4) | 0x09));
-    // spo2 configuration register
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::SPO2_CONFIG,
-                                                  (static_cast<uint8_t>(config.scaleWidth) << 5) |
-                                                      (static_cast<uint8_t>(config.sampleRate) << 2) |
-                                                      static_cast<uint8_t>(config.pulseWidth)));
+void Max30102::enableFifoInterrupt(bool enable)
+{
+    fifoInterruptEnabled = enable;
+    if (startState == StartState::RUNNING)
+    {
+        writeFifoInterruptEnable();
+    }
 }
 
-void Max30102::SensorStart() const
+void Max30102::writeFifoInterruptEnable() const
 {
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::FIFO_WR_PTR, 0));
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::FIFO_OVFLW, 0));
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::FIFO_RD_PTR, 0));
+    uint8_t mask = fifoInterruptEnabled ? (1 << static_cast<uint8_t>(SensRegs::max30102_interrupt_t::MAX30102_INTERRUPT_FIFO_FULL_EN)) : 0;
+    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::INTR_ENABLE1, mask));
+}
 
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::MULTILED_CONFIG1,
-                                                  (static_cast<uint8_t>(SensRegs::SlotConfig::SLOT_LED1_IR) << 4) |
-                                                      static_cast<uint8_t>(SensRegs::SlotConfig::SLOT_LED1_RED)));
-    // multi led mode and enable
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::MODE_CONFIG, 7));
+StatusSnapshot Max30102::readStatus() const
+{
+    // ISR_STAT1..FIFO_RD_PTR are contiguous, reading ISR_STAT1 also releases the INT line
+    uint8_t raw[StatusSnapshot::kSize] = {0};
+    SENSOR_PROFILE_MARK(profileStart);
+    ESP_ERROR_CHECK(_i2cHelper.i2c_read_mult_register(sensorHandler, SensRegs::Regs::ISR_STAT1,
+                                                      raw, sizeof(raw)));
+    SENSOR_PROFILE_LAP(ProfileStage::STATUS_READ, profileStart);
+    return StatusSnapshot::decode(raw);
 }
 
-void Max30102::SensorStop() const
+void Max30102::submitFifoRead(const StatusSnapshot &status)
 {
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::MULTILED_CONFIG1, 0));
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, SensRegs::Regs::MODE_CONFIG, 1 << 7));
+    size_t numSamples = status.available();
+    PrintValue(tagMax, "Fifo values count", numSamples);
+
+    if (numSamples <= kFifoReadThreshold)
+    {
+        return;
+    }
+
+    // samples that do not fit stay in the fifo until the next poll, a full block of
+    // the decimator never gives more outputs than the free space
+    size_t freeSpace = samples.freeSpace() * decimator.ratio();
+    numSamples = (numSamples < freeSpace) ? numSamples : freeSpace;
+    if (numSamples == 0)
+    {
+        return;
+    }
+
+    // drain all available samples in a single burst, FIFO_RD_PTR auto-increments per sample
+    I2CTransaction transaction{};
+    transaction.dev_handle = sensorHandler;
+    transaction.type = I2CTransactionType::I2C_TRANSACTION_READ;
+    transaction.registerNum = SensRegs::Regs::FIFO_DATA;
+    transaction.data = fifoData;
+    transaction.dataAmount = numSamples * kFifoBytesPerSample;
+    transaction.done = fifoReadDone;
+    transaction.result = &fifoReadResult;
+    ESP_ERROR_CHECK(_i2cHelper.i2c_submit(transaction));
+    fifoReadPending = numSamples;
 }
 
-size_t Max30102::readFromFifo()
+size_t Max30102::readFromFifo(const StatusSnapshot &status)
 {
-    uint8_t fifoWrite = 0;
-    ESP_ERROR_CHECK(_i2cHelper.i2c_read_register(sensorHandler, SensRegs::Regs::FIFO_WR_PTR, &fifoWrite));
-    PrintValue(tagMax, "Fifo values count", fifoWrite);
-    size_t numSamples = 0;
+    size_t numSamples = fifoReadPending;
+    fifoReadPending = 0;
+    if (numSamples == 0)
+    {
+        return 0;
+    }
 
-    if (fifoWrite > 24)
+    // the time this task still waits for the burst
+    SENSOR_PROFILE_MARK(profileStart);
+    xSemaphoreTake(fifoReadDone, portMAX_DELAY);
+    ESP_ERROR_CHECK(fifoReadResult);
+    SENSOR_PROFILE_LAP(ProfileStage::FIFO_READ, profileStart);
+    const uint8_t *data = fifoData;
+
+    // the samples an overflow pushed out keep their place in the raw stream, reading
+    // FIFO_DATA clears the counter
+    fifoSampleIndex += status.overflowCounter;
+    if (rawSink != nullptr)
     {
-        for (size_t i = 0; i < fifoWrite; i++)
-        {
-            uint8_t data[6];
+        rawSink->onFifoData(fifoSampleIndex, data, numSamples);
+    }
+    fifoSampleIndex += static_cast<uint32_t>(numSamples);
+    SENSOR_PROFILE_LAP(ProfileStage::RAW_SINK, profileStart);
 
-            ESP_ERROR_CHECK(_i2cHelper.i2c_read_mult_register(sensorHandler,
-                                                              SensRegs::Regs::FIFO_DATA,
-                                                              data, 6));
+    SampleFrame frames[kFifoDepth];
+    unpackFifoSamples(data, numSamples, frames);
+    SENSOR_PROFILE_LAP(ProfileStage::UNPACK, profileStart);
 
-            led1Data[offsetInBuffer + i] = (data[0] << 16) | (data[1] << 8) | data[2];
-            led2Data[offsetInBuffer + i] = (data[3] << 16) | (data[4] << 8) | data[5];
+    size_t numFrames = decimator.process(frames, numSamples, frames);
+    SENSOR_PROFILE_LAP(ProfileStage::DECIMATE, profileStart);
 
-            // PrintValue(tagMax, "led1", led1Data[offsetInBuffer + i]);
-            // PrintValue(tagMax, "led2", led2Data[offsetInBuffer + i]);
-        }
-        numSamples = fifoWrite;
+    size_t pushed = samples.push(frames, numFrames);
+    if (resultMode == ResultMode::WINDOW)
+    {
+        windowQuality.push(frames, pushed);
     }
+    SENSOR_PROFILE_LAP(ProfileStage::RING_PUSH, profileStart);
 
-    return numSamples;
+    return pushed;
 };
 
-bool Max30102::IsFifoOverFlow() const
+void Max30102::unpackFifoSamples(const uint8_t *__restrict raw, size_t numSamples,
+                                 SampleFrame *__restrict frames)
 {
-    uint8_t overFlow = 0;
-    ESP_ERROR_CHECK(_i2cHelper.i2c_read_register(sensorHandler, SensRegs::Regs::FIFO_OVFLW, &overFlow));
-    return (overFlow != 0);
-}
+    // branch-free fixed-stride loop, lets the compiler unroll/vectorize it
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        const uint8_t *sample = raw + i * kFifoBytesPerSample;
 
-bool Max30102::ambientLightOverflow() const
-{
-    uint8_t config = 0;
-    ESP_ERROR_CHECK(_i2cHelper.i2c_read_register(sensorHandler, SensRegs::Regs::ISR_STAT1, &config));
-    return ((1 << 5) & config);
+        frames[i].red = ((uint32_t(sample[0]) << 16) | (uint32_t(sample[1]) << 8) | sample[2]) & kFifoSampleMask;
+        frames[i].ir = ((uint32_t(sample[3]) << 16) | (uint32_t(sample[4]) << 8) | sample[5]) & kFifoSampleMask;
+    }
 }
 
 void Max30102::SensorWakeUp() const
@@ -196,7 +440,11 @@ void Max30102::SensorWakeUp() const
     ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, Regs::Regs::MODE_CONFIG, 0));
 };
 
-void Max30102::SensorReset() const
+esp_err_t Max30102::SensorReset() const
 {
-    ESP_ERROR_CHECK(_i2cHelper.i2c_write_register(sensorHandler, Regs::Regs::MODE_CONFIG, 1 << 6));
+    esp_err_t err = _i2cHelper.i2c_write_register(sensorHandler, Regs::Regs::MODE_CONFIG, kModeReset);
+    // the reset restores the power-on defaults of all registers, the shadow cannot tell
+    // whether a failed write reached the part before the NACK
+    _i2cHelper.i2c_invalidate_shadow(sensorHandler);
+    return err;
 };
\ No newline at end of file
@@ -3,10 +3,17 @@
 
 #include <stdint.h>
 
+#include <array>
+
 #include "i2c_helper.h"
 #include "sensor_abstract.h"
+#include "sample_ring.h"
+#include "sensor_signal_quality.h"
+#include "sensor_decimator.h"
 
 #include "sensor_spo2_algorithm.h"
+#include "sensor_spo2_stream.h"
+#include "sensor_spo2_window.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -18,6 +25,16 @@ struct SensorResult
 {
     int32_t pulse;
     int32_t saturation;
+    // reason when pulse and saturation are -1
+    SignalQualityCode quality;
+};
+
+/// @brief Scratch of one SpO2/HR calculation, every concurrently computing sensor needs its own.
+/// A calculation uses one of the two algorithms, so they share the memory.
+union SensorAlgorithmContext
+{
+    maxim_spo2_context_t generic;
+    Spo2SharedContext window;
 };
 
 struct SensorConfigStruct
@@ -28,26 +45,116 @@ struct SensorConfigStruct
     Regs::PulseWidth pulseWidth;
     Regs::AdcFullScaleWidth scaleWidth;
 
-    SensorConfigStruct() : powerLevel(0x1F),
+    constexpr SensorConfigStruct() : powerLevel(0x1F),
                            sampleAverage(Regs::SampleAveraging::MAX30102_SAMPLE_AVERAGING_2),
                            sampleRate(Regs::Spo2SampleRate::MAX30102_SPO2_SAMPLE_RATE_100_HZ),
                            pulseWidth(Regs::PulseWidth::LED_PW_411US),
                            scaleWidth(Regs::AdcFullScaleWidth::SPO2_ADC_RGE_LSB_15PA63_FULLSCALE_4096NA)
     {
     }
+
+    /// @brief Samples per second coming out of the fifo, sample rate divided by averaging
+    constexpr uint32_t effectiveSampleRateHz() const
+    {
+        constexpr uint32_t kSampleRateHz[] = {50U, 100U, 200U, 400U, 800U, 1000U, 1600U, 3200U};
+        return kSampleRateHz[static_cast<uint8_t>(sampleRate)] >> static_cast<uint8_t>(sampleAverage);
+    }
+};
+
+/// @brief When readData() produces a result
+enum class ResultMode
+{
+    // batch algorithm over the buffered window, every few seconds
+    WINDOW,
+    // streaming algorithm, after every confirmed beat
+    PER_BEAT,
+};
+
+/// @brief Decoded status block ISR_STAT1..FIFO_RD_PTR (0x00..0x06), fetched in one burst
+struct StatusSnapshot
+{
+    static constexpr size_t kSize = 7U;
+
+    uint8_t interruptStatus1;
+    uint8_t interruptStatus2;
+    uint8_t interruptEnable1;
+    uint8_t interruptEnable2;
+    uint8_t writePtr;
+    uint8_t overflowCounter;
+    uint8_t readPtr;
+
+    static constexpr StatusSnapshot decode(const uint8_t (&raw)[kSize])
+    {
+        return StatusSnapshot{raw[0], raw[1], raw[2], raw[3], raw[4], raw[5], raw[6]};
+    }
+
+    constexpr bool isSet(Regs::InterruptStatus flag) const
+    {
+        return (interruptStatus1 >> static_cast<uint8_t>(flag)) & 1U;
+    }
+
+    constexpr bool fifoAlmostFull() const
+    {
+        return isSet(Regs::InterruptStatus::MAX30102_INTERRUPT_STATUS_FIFO_FULL);
+    }
+
+    constexpr bool dataReady() const
+    {
+        return isSet(Regs::InterruptStatus::MAX30102_INTERRUPT_STATUS_PPG_RDY);
+    }
+
+    constexpr bool ambientLightOverflow() const
+    {
+        return isSet(Regs::InterruptStatus::MAX30102_INTERRUPT_STATUS_ALC_OVF);
+    }
+
+    constexpr bool powerReady() const
+    {
+        return isSet(Regs::InterruptStatus::MAX30102_INTERRUPT_STATUS_PWR_RDY);
+    }
+
+    constexpr bool fifoOverflow() const
+    {
+        return overflowCounter != 0;
+    }
+
+    /// @brief Number of unread samples
+    constexpr size_t available() const;
+};
+
+/// @brief Gets the FIFO_DATA bytes of every burst read before they are unpacked, called
+/// from the sensor task
+class RawSampleSink
+{
+public:
+    virtual ~RawSampleSink() {}
+
+    /// @brief numSamples frames of 3 bytes red and 3 bytes ir. firstIndex counts the FIFO
+    /// samples since start(), samples lost to a FIFO overflow included.
+    virtual void onFifoData(uint32_t firstIndex, const uint8_t *raw, size_t numSamples) = 0;
 };
 
 class Max30102 : Sensor
 {
 
 public:
-    static SensorResult calculate(uint32_t *led1Data, uint32_t *led2Data, size_t numSamplesRead);
+    /// @brief Run the specialized algorithm if window is given and the sample count matches it,
+    /// the generic one otherwise. Reentrant, scratch data lives in context.
+    static SensorResult calculate(SensorAlgorithmContext &context,
+                                  uint32_t *led1Data, uint32_t *led2Data, size_t numSamplesRead,
+                                  const Spo2WindowVariant *window = nullptr);
 
     Max30102(I2CHelper &i2cHelper) : _i2cHelper(i2cHelper),
                                      sensorHandler(0),
                                      LastSentResultTickCount(0),
-                                     offsetInBuffer(0) {};
-    virtual ~Max30102() {}
+                                     fifoInterruptEnabled(false) {};
+    virtual ~Max30102()
+    {
+        if (fifoReadDone != nullptr)
+        {
+            vSemaphoreDelete(fifoReadDone);
+        }
+    }
 
     void init() override;
     void deinit() override;
@@ -55,35 +162,171 @@ public:
     void stop() override;
     size_t readData(uint32_t *data) override;
 
+    /// @brief Configuration applied on the next start()
+    void setConfig(const SensorConfigStruct &newConfig)
+    {
+        config = newConfig;
+    }
+
+    /// @brief Result mode used from the next start(). PER_BEAT needs frames at the algorithm
+    /// rate, a FIFO rate the decimator passes unchanged runs WINDOW instead.
+    void setResultMode(ResultMode mode)
+    {
+        requestedResultMode = mode;
+    }
+
+    /// @brief Receiver of the raw samples, nullptr for none
+    void setRawSink(RawSampleSink *sink)
+    {
+        rawSink = sink;
+    }
+
+    using StartImage = std::array<RegisterWrite, 9>;
+
+    /// @brief Register writes that configure and start the sensor, in the order they are sent
+    static constexpr StartImage makeStartImage(const SensorConfigStruct &config)
+    {
+        return StartImage{{
+            // clear the fifo pointers (0x04..0x06, one burst)
+            {Regs::Regs::FIFO_WR_PTR, 0},
+            {Regs::Regs::FIFO_OVFLW, 0},
+            {Regs::Regs::FIFO_RD_PTR, 0},
+            // set sample average, enable rollover, fire almost full after kFifoReadThreshold samples
+            {Regs::Regs::FIFO_CONFIG, static_cast<uint8_t>((static_cast<uint8_t>(config.sampleAverage) << 5) |
+                                                           (1 << 4) | kFifoAlmostFull)},
+            {Regs::Regs::SPO2_CONFIG, static_cast<uint8_t>((static_cast<uint8_t>(config.scaleWidth) << 5) |
+                                                           (static_cast<uint8_t>(config.sampleRate) << 2) |
+                                                           static_cast<uint8_t>(config.pulseWidth))},
+            // LED Pulse Amplitude Configuration (0x0C..0x0D, one burst)
+            // powerLevel = 0x02:0.4mA, 0x1F:6.4mA, 0x7F:25.4mA, 0xFF:50.0mA
+            {Regs::Regs::LED1_PA, config.powerLevel},
+            {Regs::Regs::LED2_PA, config.powerLevel},
+            // red in slot 1 and ir in slot 2, the order the FIFO_DATA unpacking expects
+            {Regs::Regs::MULTILED_CONFIG1, static_cast<uint8_t>((static_cast<uint8_t>(Regs::SlotConfig::SLOT_LED2_IR) << 4) |
+                                                                static_cast<uint8_t>(Regs::SlotConfig::SLOT_LED1_RED))},
+            // multi led mode and enable, has to be the last one
+            {Regs::Regs::MODE_CONFIG, static_cast<uint8_t>(Regs::Mode::MAX30102_MODE_MULTI_LED)},
+        }};
+    }
+
+    /// @brief Assert INT when the fifo holds more than kFifoReadThreshold samples,
+    /// applied once the sensor is running
+    void enableFifoInterrupt(bool enable);
+
     bool isInitDone() const
     {
         return sensorHandler != 0;
     }
 
+    /// @brief start() was called and the part is still coming out of reset
+    bool isStarting() const
+    {
+        return startState == StartState::RESETTING;
+    }
+
+    /// @brief The part NACKed the reset or did not come out of it within kResetTimeoutMs,
+    /// start() may try again
+    bool startFailed() const
+    {
+        return startState == StartState::FAILED;
+    }
+
+    /// @brief Number of unread samples from the FIFO pointers (5-bit wraparound)
+    static constexpr size_t fifoAvailable(uint8_t writePtr, uint8_t readPtr, uint8_t overflowCounter,
+                                          bool almostFull)
+    {
+        size_t available = static_cast<uint8_t>(writePtr - readPtr) & kFifoPtrMask;
+        // equal pointers mean the FIFO is full once it overflowed, or when it filled up to
+        // exactly kFifoDepth since the almost full flag was set: only reading FIFO_DATA or
+        // the status clears the flag, so the FIFO can not have been emptied
+        return (available == 0 && (overflowCounter != 0 || almostFull)) ? kFifoDepth : available;
+    }
+
+    /// @brief Unpack raw FIFO_DATA bytes (3 bytes red + 3 bytes ir per sample) into 18-bit values
+    static void unpackFifoSamples(const uint8_t *__restrict raw, size_t numSamples,
+                                  SampleFrame *__restrict frames);
+
 private:
     static constexpr uint8_t kI2cAddress = 0x57U;
     static constexpr auto kRevisionID = 3U;
     static constexpr auto kPartID = 21U;
-    static constexpr auto kAfterResetTimeoutMs = 5000U;
-    static constexpr auto kLedBufferSize = 255U;
+    // the reset takes well below a millisecond, give up if the part does not come back
+    static constexpr auto kResetTimeoutMs = 100U;
+    static constexpr uint8_t kModeReset = 1U << 6;
+    static constexpr size_t kSampleRingSize = 256U;
+    // calculate as soon as the ring can not take two more full fifos
+    static constexpr size_t kCalculateThreshold = kSampleRingSize - 64U;
+    static constexpr size_t kFifoDepth = 32U;
+    static constexpr uint8_t kFifoPtrMask = 0x1FU;
+    static constexpr size_t kFifoBytesPerSample = 6U;
+    static constexpr uint32_t kFifoSampleMask = 0x3FFFFU;
+    static constexpr size_t kFifoReadThreshold = 24U;
+    // FIFO_A_FULL holds the number of free slots left when the interrupt fires
+    static constexpr uint8_t kFifoAlmostFull = kFifoDepth - (kFifoReadThreshold + 1U);
+
+    enum class StartState
+    {
+        STOPPED,
+        RESETTING,
+        RUNNING,
+        // reset timed out, nothing is written until the next start()
+        FAILED,
+    };
 
     I2CHelper &_i2cHelper;
     i2c_master_dev_handle_t sensorHandler;
     TickType_t LastSentResultTickCount = 0;
-    size_t offsetInBuffer = 0;
+    TickType_t resetStartTickCount = 0;
+    StartState startState = StartState::STOPPED;
+    bool fifoInterruptEnabled = false;
+    // ambient light or fifo overflow seen while the current window was collected
+    bool windowCorrupted = false;
+    // quality of the frames collected for the current window
+    SignalQuality windowQuality;
+    // FIFO rate down to the algorithm rate, passes the frames at 50 and 100 Hz
+    SampleDecimator decimator;
+    SensorConfigStruct config;
+    ResultMode requestedResultMode = ResultMode::WINDOW;
+    // the mode of the current run, chosen by start()
+    ResultMode resultMode = ResultMode::WINDOW;
+    Spo2Stream stream;
+    // specialization for the configured rate, nullptr runs the generic algorithm
+    const Spo2WindowVariant *spo2Window = nullptr;
+    RawSampleSink *rawSink = nullptr;
+    // FIFO samples since start(), read or lost
+    uint32_t fifoSampleIndex = 0;
 
-    uint32_t led1Data[kLedBufferSize];
-    uint32_t led2Data[kLedBufferSize];
+    // the burst of the current cycle, read by the bus worker of the I2CHelper
+    uint8_t fifoData[kFifoDepth * kFifoBytesPerSample];
+    esp_err_t fifoReadResult = ESP_OK;
+    // samples of the burst submitted and not yet taken by readFromFifo
+    size_t fifoReadPending = 0;
+    SemaphoreHandle_t fifoReadDone = nullptr;
 
-    void SensorConfig(const SensorConfigStruct &config = SensorConfigStruct());
-    void SensorStart() const;
-    void SensorStop() const;
+    // filled by readFromFifo, drained by readData
+    SampleRing<kSampleRingSize> samples;
+    uint32_t led1Data[kSampleRingSize];
+    uint32_t led2Data[kSampleRingSize];
+    SensorAlgorithmContext algorithmContext;
+
+    void SensorStart(const SensorConfigStruct &config) const;
+    esp_err_t SensorStop() const;
     void SensorWakeUp() const;
-    void SensorReset() const;
+    esp_err_t SensorReset() const;
+
+    bool pollStart();
+    void writeFifoInterruptEnable() const;
 
-    bool IsFifoOverFlow() const;
-    bool ambientLightOverflow() const;
-    size_t readFromFifo();
+    StatusSnapshot readStatus() const;
+    void submitFifoRead(const StatusSnapshot &status);
+    size_t readFromFifo(const StatusSnapshot &status);
+    size_t readWindow(uint32_t *data, const StatusSnapshot &status);
+    size_t readBeats(uint32_t *data);
 };
 
+constexpr size_t StatusSnapshot::available() const
+{
+    return Max30102::fifoAvailable(writePtr, readPtr, overflowCounter, fifoAlmostFull());
+}
+
 #endif
\ No newline at end of file
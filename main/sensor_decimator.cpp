@@ -0,0 +1,135 @@
+#include "sensor_decimator.h"
+
+static constexpr uint32_t kDecimatorSampleMax = 0x3FFFFU;
+
+static inline void prime(int32_t (&line)[2 * kDecimatorTapsPerPhase], int32_t value)
+{
+    for (int32_t &x : line)
+    {
+        x = value;
+    }
+}
+
+/// @brief Sum of the branches of one channel in Q12, rounded and limited to 18 bits
+template <uint32_t Ratio>
+static inline uint32_t filterOutput(const int32_t (&lines)[kDecimatorMaxRatio][2 * kDecimatorTapsPerPhase],
+                                    uint32_t slot)
+{
+    constexpr auto &kBranches = PolyphaseDecimator<Ratio>::kCoefficients.branches;
+
+    int32_t acc = 1 << (PolyphaseDecimator<Ratio>::kCoefficientBits - 1);
+    for (uint32_t branch = 0; branch < Ratio; branch++)
+    {
+        const int32_t *x = &lines[branch][slot + 1];
+        for (uint32_t i = 0; i < kDecimatorTapsPerPhase; i++)
+        {
+            acc += kBranches[branch][i] * x[i];
+        }
+    }
+    acc >>= PolyphaseDecimator<Ratio>::kCoefficientBits;
+    // the negative side lobes can ring past the input range on steps
+    return (acc < 0) ? 0U : ((static_cast<uint32_t>(acc) > kDecimatorSampleMax) ? kDecimatorSampleMax : static_cast<uint32_t>(acc));
+}
+
+template <uint32_t Ratio>
+size_t PolyphaseDecimator<Ratio>::process(DecimatorState &state, const SampleFrame *in, size_t count, SampleFrame *out)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (!state.primed)
+    {
+        // start as if the first frame had always been there, no ramp up from zero
+        for (uint32_t branch = 0; branch < Ratio; branch++)
+        {
+            prime(state.red[branch], static_cast<int32_t>(in[0].red));
+            prime(state.ir[branch], static_cast<int32_t>(in[0].ir));
+        }
+        state.primed = true;
+    }
+
+    size_t produced = 0;
+    uint32_t slot = state.slot;
+    uint32_t phase = state.phase;
+    for (size_t n = 0; n < count; n++)
+    {
+        // both copies, so the read below never wraps
+        const int32_t red = static_cast<int32_t>(in[n].red);
+        const int32_t ir = static_cast<int32_t>(in[n].ir);
+        state.red[phase][slot] = red;
+        state.red[phase][slot + kDecimatorTapsPerPhase] = red;
+        state.ir[phase][slot] = ir;
+        state.ir[phase][slot + kDecimatorTapsPerPhase] = ir;
+
+        if (++phase == Ratio)
+        {
+            // in[n] has been read, out[produced] with produced <= n is safe to write
+            out[produced].red = filterOutput<Ratio>(state.red, slot);
+            out[produced].ir = filterOutput<Ratio>(state.ir, slot);
+            produced++;
+            phase = 0;
+            slot = (slot + 1 == kDecimatorTapsPerPhase) ? 0 : slot + 1;
+        }
+    }
+    state.slot = slot;
+    state.phase = phase;
+    return produced;
+}
+
+template class PolyphaseDecimator<2>;
+template class PolyphaseDecimator<4>;
+template class PolyphaseDecimator<8>;
+template class PolyphaseDecimator<10>;
+template class PolyphaseDecimator<16>;
+
+// 200, 400, 800, 1000 and 1600 Hz down to 100 Hz
+static constexpr DecimatorVariant kDecimators[] = {
+    {2U, &PolyphaseDecimator<2>::process},
+    {4U, &PolyphaseDecimator<4>::process},
+    {8U, &PolyphaseDecimator<8>::process},
+    {10U, &PolyphaseDecimator<10>::process},
+    {16U, &PolyphaseDecimator<16>::process},
+};
+
+const DecimatorVariant *findDecimator(uint32_t ratio)
+{
+    for (const DecimatorVariant &variant : kDecimators)
+    {
+        if (variant.ratio == ratio)
+        {
+            return &variant;
+        }
+    }
+    return nullptr;
+}
+
+void SampleDecimator::configure(uint32_t inputRateHz)
+{
+    variant = (inputRateHz % kAlgorithmRateHz == 0) ? findDecimator(inputRateHz / kAlgorithmRateHz) : nullptr;
+    outputRate = (variant != nullptr) ? kAlgorithmRateHz : inputRateHz;
+    reset();
+}
+
+void SampleDecimator::reset()
+{
+    state.slot = 0;
+    state.phase = 0;
+    state.primed = false;
+}
+
+size_t SampleDecimator::process(const SampleFrame *in, size_t count, SampleFrame *out)
+{
+    if (variant == nullptr)
+    {
+        if (out != in)
+        {
+            for (size_t n = 0; n < count; n++)
+            {
+                out[n] = in[n];
+            }
+        }
+        return count;
+    }
+    return variant->process(state, in, count, out);
+}
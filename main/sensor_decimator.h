@@ -0,0 +1,178 @@
+#ifndef SENSOR_DECIMATOR_H
+#define SENSOR_DECIMATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sample_ring.h"
+
+/// @brief Taps of every polyphase branch, a decimator by Ratio has Ratio * kDecimatorTapsPerPhase taps
+static constexpr uint32_t kDecimatorTapsPerPhase = 8U;
+static constexpr uint32_t kDecimatorMaxRatio = 16U;
+
+/// @brief Delay lines of one decimator, sized for every shipped ratio. Each branch keeps
+/// its last kDecimatorTapsPerPhase inputs twice, so a branch is always read as one
+/// contiguous run without wrapping.
+struct DecimatorState
+{
+    int32_t red[kDecimatorMaxRatio][2 * kDecimatorTapsPerPhase];
+    int32_t ir[kDecimatorMaxRatio][2 * kDecimatorTapsPerPhase];
+    // next delay line slot, 0..kDecimatorTapsPerPhase-1
+    uint32_t slot;
+    // inputs of the current output block seen so far, 0..Ratio-1
+    uint32_t phase;
+    // the delay lines are filled with the first input instead of zeros
+    bool primed;
+};
+
+/// @brief Low pass FIR and downsampling by Ratio for the red/ir frames, as a polyphase filter:
+/// input k of every block of Ratio frames only goes into branch k, and one output per block
+/// costs Ratio * kDecimatorTapsPerPhase multiply-adds per channel.
+///
+/// The coefficients are a Hamming windowed sinc with the cutoff at 40 % of the output rate,
+/// generated and quantized at compile time. They are Q12 and sum to exactly 4096, so a
+/// constant input comes out unchanged and 18-bit samples never overflow the 32-bit sums.
+template <uint32_t Ratio>
+class PolyphaseDecimator
+{
+    static_assert(Ratio >= 2 && Ratio <= kDecimatorMaxRatio, "ratio out of the state range");
+
+public:
+    static constexpr uint32_t kRatio = Ratio;
+    static constexpr uint32_t kTaps = Ratio * kDecimatorTapsPerPhase;
+    static constexpr int32_t kCoefficientBits = 12;
+
+    struct Coefficients
+    {
+        // filter as designed, tap 0 applies to the newest input
+        int32_t taps[kTaps];
+        // branch k, ordered from the oldest to the newest input of that branch
+        int32_t branches[Ratio][kDecimatorTapsPerPhase];
+    };
+
+    /// @brief Filter count frames into out, returns the number of outputs. Streams across
+    /// calls with any count; out may be in, it is never written ahead of the reads.
+    static size_t process(DecimatorState &state, const SampleFrame *in, size_t count, SampleFrame *out);
+
+private:
+    static constexpr double kPi = 3.14159265358979323846;
+
+    // sin and cos for the design only, the standard ones are not constexpr
+    static constexpr double sine(double x)
+    {
+        while (x > kPi)
+        {
+            x -= 2 * kPi;
+        }
+        while (x < -kPi)
+        {
+            x += 2 * kPi;
+        }
+        double term = x;
+        double sum = x;
+        for (int n = 1; n < 20; n++)
+        {
+            term *= -x * x / ((2 * n) * (2 * n + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    static constexpr double cosine(double x)
+    {
+        return sine(x + kPi / 2);
+    }
+
+    static constexpr Coefficients design()
+    {
+        constexpr double kCutoff = 0.4 / (2.0 * Ratio); // 40 % of the output rate, in cycles per input
+        constexpr double kCenter = (kTaps - 1) / 2.0;
+
+        double ideal[kTaps] = {};
+        double sum = 0;
+        for (uint32_t n = 0; n < kTaps; n++)
+        {
+            double t = n - kCenter;
+            double sinc = (t == 0) ? 2 * kCutoff : sine(2 * kPi * kCutoff * t) / (kPi * t);
+            ideal[n] = sinc * (0.54 - 0.46 * cosine(2 * kPi * n / (kTaps - 1)));
+            sum += ideal[n];
+        }
+
+        Coefficients result{};
+        int32_t total = 0;
+        for (uint32_t n = 0; n < kTaps; n++)
+        {
+            double scaled = ideal[n] / sum * (1 << kCoefficientBits);
+            result.taps[n] = static_cast<int32_t>(scaled >= 0 ? scaled + 0.5 : scaled - 0.5);
+            total += result.taps[n];
+        }
+        // the rounding error goes to the middle taps, unity gain at DC stays exact
+        result.taps[kTaps / 2 - 1] += ((1 << kCoefficientBits) - total) / 2;
+        result.taps[kTaps / 2] += ((1 << kCoefficientBits) - total) - ((1 << kCoefficientBits) - total) / 2;
+
+        // output n sees input n * Ratio + Ratio - 1 - (k * Ratio + p) through taps[k * Ratio + p],
+        // that is offset Ratio - 1 - p of block n - k
+        for (uint32_t branch = 0; branch < Ratio; branch++)
+        {
+            for (uint32_t i = 0; i < kDecimatorTapsPerPhase; i++)
+            {
+                uint32_t k = kDecimatorTapsPerPhase - 1 - i;
+                result.branches[branch][i] = result.taps[k * Ratio + (Ratio - 1 - branch)];
+            }
+        }
+        return result;
+    }
+
+public:
+    static constexpr Coefficients kCoefficients = design();
+};
+
+/// @brief One shipped ratio, selected at run time
+struct DecimatorVariant
+{
+    uint32_t ratio;
+    size_t (*process)(DecimatorState &state, const SampleFrame *in, size_t count, SampleFrame *out);
+};
+
+/// @brief Decimator for this ratio, nullptr if none is shipped
+const DecimatorVariant *findDecimator(uint32_t ratio);
+
+/// @brief Brings the FIFO rate down to the rate the SpO2/HR algorithm is built for.
+/// Rates that are no shipped multiple of it pass unchanged.
+class SampleDecimator
+{
+public:
+    /// @brief Rate the algorithm expects, see FS in sensor_spo2_algorithm.h
+    static constexpr uint32_t kAlgorithmRateHz = 100U;
+
+    /// @brief Select the ratio for this input rate and clear the filter state
+    void configure(uint32_t inputRateHz);
+    void reset();
+
+    /// @brief Rate of the frames process() returns
+    uint32_t outputRateHz() const
+    {
+        return outputRate;
+    }
+
+    uint32_t ratio() const
+    {
+        return (variant != nullptr) ? variant->ratio : 1U;
+    }
+
+    /// @brief Filter and downsample in place or into out, returns the number of output frames
+    size_t process(const SampleFrame *in, size_t count, SampleFrame *out);
+
+private:
+    const DecimatorVariant *variant = nullptr;
+    uint32_t outputRate = kAlgorithmRateHz;
+    DecimatorState state;
+};
+
+extern template class PolyphaseDecimator<2>;
+extern template class PolyphaseDecimator<4>;
+extern template class PolyphaseDecimator<8>;
+extern template class PolyphaseDecimator<10>;
+extern template class PolyphaseDecimator<16>;
+
+#endif
@@ -0,0 +1,66 @@
+#include "sensor_interrupt.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+
+static const char *tagIrq = "SensorIrq";
+
+void GpioInterruptSource::enable(TaskHandle_t task)
+{
+    notifyTask = task;
+
+    gpio_config_t ioConfig = {};
+    ioConfig.pin_bit_mask = 1ULL << _pin;
+    ioConfig.mode = GPIO_MODE_INPUT;
+    ioConfig.pull_up_en = GPIO_PULLUP_ENABLE;
+    ioConfig.pull_down_en = GPIO_PULLDOWN_DISABLE;
+    // level triggered, an edge that happens while the task is busy can not be lost
+    ioConfig.intr_type = GPIO_INTR_LOW_LEVEL;
+    ESP_ERROR_CHECK(gpio_config(&ioConfig));
+
+    // the service may be already installed by another driver
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+    {
+        ESP_ERROR_CHECK(err);
+    }
+
+    if (!isrAdded)
+    {
+        ESP_ERROR_CHECK(gpio_isr_handler_add(_pin, isrHandler, this));
+        isrAdded = true;
+    }
+
+    ESP_ERROR_CHECK(gpio_intr_enable(_pin));
+    ESP_LOGI(tagIrq, "Fifo interrupt enabled on gpio %d", static_cast<int>(_pin));
+}
+
+void GpioInterruptSource::disable()
+{
+    gpio_intr_disable(_pin);
+
+    if (isrAdded)
+    {
+        gpio_isr_handler_remove(_pin);
+        isrAdded = false;
+    }
+
+    notifyTask = nullptr;
+}
+
+void GpioInterruptSource::rearm()
+{
+    if (isrAdded)
+    {
+        gpio_intr_enable(_pin);
+    }
+}
+
+void IRAM_ATTR GpioInterruptSource::isrHandler(void *arg)
+{
+    GpioInterruptSource *self = static_cast<GpioInterruptSource *>(arg);
+
+    // mask the level interrupt until the task has read the status register
+    gpio_intr_disable(self->_pin);
+    self->notifyFromIsr();
+}
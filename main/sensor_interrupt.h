@@ -0,0 +1,54 @@
+#ifndef SENSOR_INTERRUPT_H
+#define SENSOR_INTERRUPT_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+
+/// @brief Source of the sensor INT line.
+/// Contract: when the line is asserted the source masks itself and gives a direct
+/// task notification to the registered task. The task services the sensor (which
+/// releases the line) and then calls rearm() to unmask the source again.
+class SensorInterruptSource
+{
+public:
+    virtual ~SensorInterruptSource() {}
+
+    virtual void enable(TaskHandle_t task) = 0;
+    virtual void disable() = 0;
+    virtual void rearm() = 0;
+
+protected:
+    TaskHandle_t notifyTask = nullptr;
+
+    /// @brief Called from the interrupt context when the line is asserted
+    void notifyFromIsr()
+    {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        if (notifyTask != nullptr)
+        {
+            vTaskNotifyGiveFromISR(notifyTask, &higherPriorityTaskWoken);
+        }
+        portYIELD_FROM_ISR(higherPriorityTaskWoken);
+    }
+};
+
+/// @brief MAX30102 INT pin (active low, open drain) routed through a level triggered GPIO ISR
+class GpioInterruptSource : public SensorInterruptSource
+{
+public:
+    GpioInterruptSource(gpio_num_t pin) : _pin(pin) {}
+    virtual ~GpioInterruptSource() {}
+
+    void enable(TaskHandle_t task) override;
+    void disable() override;
+    void rearm() override;
+
+private:
+    const gpio_num_t _pin;
+    bool isrAdded = false;
+
+    static void isrHandler(void *arg);
+};
+
+#endif
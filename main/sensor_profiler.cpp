@@ -0,0 +1,146 @@
+#include "sensor_profiler.h"
+
+#include <stdio.h>
+
+#include <atomic>
+
+#include "esp_log.h"
+
+#if !defined(__XTENSA__)
+#include <chrono>
+#endif
+
+static const char *tagProfiler = "Profiler";
+
+static constexpr size_t kStageCount = static_cast<size_t>(ProfileStage::COUNT);
+
+static constexpr const char *kStageNames[kStageCount] = {
+    "status_read",
+    "fifo_read",
+    "raw_sink",
+    "unpack",
+    "decimate",
+    "ring_push",
+    "calculate",
+    "algo_filter",
+    "algo_peaks",
+    "algo_ratio",
+    "stream",
+    "queue_send",
+    "gatt_update",
+};
+
+/// @brief ProfileStats as the probes update it
+struct ProfileCounters
+{
+    std::atomic<uint32_t> count;
+    // ~min, so the zero initialized value stands for no sample
+    std::atomic<uint32_t> minInverted;
+    std::atomic<uint32_t> max;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint32_t> histogram[ProfileStats::kBuckets];
+};
+
+static ProfileCounters profileTable[kStageCount];
+
+static void storeMax(std::atomic<uint32_t> &target, uint32_t value)
+{
+    uint32_t seen = target.load(std::memory_order_relaxed);
+    while (value > seen && !target.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+#if !defined(__XTENSA__)
+uint32_t SensorProfiler::now()
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch());
+    return static_cast<uint32_t>(ns.count());
+}
+#endif
+
+void SensorProfiler::record(ProfileStage stage, uint32_t start, uint32_t end)
+{
+    ProfileCounters &stats = profileTable[static_cast<size_t>(stage)];
+    uint32_t ticks = end - start;
+
+    storeMax(stats.minInverted, ~ticks);
+    storeMax(stats.max, ticks);
+    stats.sum.fetch_add(ticks, std::memory_order_relaxed);
+    stats.count.fetch_add(1U, std::memory_order_relaxed);
+
+    // bit width above the bucket shift, clamped to the open last bucket
+    uint32_t scaled = ticks >> kBucketShift;
+    size_t bucket = (scaled == 0) ? 0 : static_cast<size_t>(32 - __builtin_clz(scaled));
+    bucket = (bucket < ProfileStats::kBuckets) ? bucket : ProfileStats::kBuckets - 1;
+    stats.histogram[bucket].fetch_add(1U, std::memory_order_relaxed);
+}
+
+ProfileStats SensorProfiler::stats(ProfileStage stage)
+{
+    const ProfileCounters &counters = profileTable[static_cast<size_t>(stage)];
+    ProfileStats stats;
+
+    stats.count = counters.count.load(std::memory_order_relaxed);
+    stats.min = (stats.count != 0) ? ~counters.minInverted.load(std::memory_order_relaxed) : 0;
+    stats.max = counters.max.load(std::memory_order_relaxed);
+    stats.sum = counters.sum.load(std::memory_order_relaxed);
+    for (size_t b = 0; b < ProfileStats::kBuckets; b++)
+    {
+        stats.histogram[b] = counters.histogram[b].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+const char *SensorProfiler::name(ProfileStage stage)
+{
+    size_t index = static_cast<size_t>(stage);
+    return index < kStageCount ? kStageNames[index] : "?";
+}
+
+void SensorProfiler::reset()
+{
+    for (ProfileCounters &counters : profileTable)
+    {
+        counters.count.store(0, std::memory_order_relaxed);
+        counters.minInverted.store(0, std::memory_order_relaxed);
+        counters.max.store(0, std::memory_order_relaxed);
+        counters.sum.store(0, std::memory_order_relaxed);
+        for (std::atomic<uint32_t> &bucket : counters.histogram)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void SensorProfiler::dump()
+{
+    ESP_LOGI(tagProfiler, "stage: count, min/mean/max us, histogram from <%lu ns doubling",
+             (unsigned long)((1000UL << kBucketShift) / kTicksPerUs));
+    for (size_t i = 0; i < kStageCount; i++)
+    {
+        const ProfileStats stats = SensorProfiler::stats(static_cast<ProfileStage>(i));
+        if (stats.count == 0)
+        {
+            continue;
+        }
+
+        // the histogram as one list, trailing empty buckets left out
+        char histogram[ProfileStats::kBuckets * 11 + 1] = {0};
+        size_t used = ProfileStats::kBuckets;
+        while (used > 1 && stats.histogram[used - 1] == 0)
+        {
+            used--;
+        }
+        size_t length = 0;
+        for (size_t b = 0; b < used; b++)
+        {
+            length += snprintf(histogram + length, sizeof(histogram) - length, b == 0 ? "%lu" : " %lu",
+                               (unsigned long)stats.histogram[b]);
+        }
+
+        ESP_LOGI(tagProfiler, "%s: %lu, %lu/%lu/%lu us, [%s]", kStageNames[i], (unsigned long)stats.count,
+                 (unsigned long)(stats.min / kTicksPerUs), (unsigned long)(stats.mean() / kTicksPerUs),
+                 (unsigned long)(stats.max / kTicksPerUs), histogram);
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef SENSOR_PROFILER_H
+#define SENSOR_PROFILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Build with SENSOR_PROFILER_ENABLED=0 to compile every probe out
+#ifndef SENSOR_PROFILER_ENABLED
+#define SENSOR_PROFILER_ENABLED 1
+#endif
+
+// the clock below is compiled with the probes on or off
+#if defined(__XTENSA__)
+#include "sdkconfig.h"
+#include "xtensa/core-macros.h"
+#endif
+
+/// @brief Pipeline stages with their own row in the profile table
+enum class ProfileStage : uint8_t
+{
+    // ISR_STAT1..FIFO_RD_PTR burst read
+    STATUS_READ = 0,
+    // wait for the FIFO_DATA burst the bus worker reads
+    FIFO_READ,
+    // hand-off of the FIFO_DATA bytes to the raw stream
+    RAW_SINK,
+    UNPACK,
+    DECIMATE,
+    // sample ring and signal quality update
+    RING_PUSH,
+    // whole calculate(), the three stages below are parts of it
+    CALCULATE,
+    ALGO_FILTER,
+    ALGO_PEAKS,
+    ALGO_RATIO,
+    // per beat mode, all samples of one readData()
+    STREAM,
+    QUEUE_SEND,
+    GATT_UPDATE,
+    COUNT,
+};
+
+/// @brief Duration statistics of one stage, in ticks of SensorProfiler::now()
+struct ProfileStats
+{
+    static constexpr size_t kBuckets = 16U;
+
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    // bucket 0 below 2^kBucketShift ticks, every further one twice as wide, the last is open
+    uint32_t histogram[kBuckets];
+
+    uint32_t mean() const
+    {
+        return count != 0 ? static_cast<uint32_t>(sum / count) : 0;
+    }
+};
+
+/// @brief Fixed table of stage durations, filled by the probes below and dumped on demand.
+/// The CPU cycle counter on target, a steady clock in nanoseconds on the host.
+/// Probes inside calculate() record from every task that runs it on its own context,
+/// so each field is updated with a relaxed atomic. A dump running at the same time
+/// may see a stage between the updates of two fields.
+class SensorProfiler
+{
+public:
+#if defined(__XTENSA__)
+    static constexpr uint32_t kTicksPerUs = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    static constexpr uint32_t kBucketShift = 7U;
+
+    static inline uint32_t now()
+    {
+        return XTHAL_GET_CCOUNT();
+    }
+#else
+    static constexpr uint32_t kTicksPerUs = 1000U;
+    static constexpr uint32_t kBucketShift = 10U;
+
+    static uint32_t now();
+#endif
+
+    /// @brief Add end - start to the stage, counter wraparound is harmless
+    static void record(ProfileStage stage, uint32_t start, uint32_t end);
+
+    static ProfileStats stats(ProfileStage stage);
+    static const char *name(ProfileStage stage);
+    static void reset();
+
+    /// @brief Log one line per stage that has samples, in microseconds
+    static void dump();
+};
+
+/// @brief Records the lifetime of the object
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfileStage stage) : _stage(stage), _start(SensorProfiler::now()) {}
+    ~ProfileScope()
+    {
+        SensorProfiler::record(_stage, _start, SensorProfiler::now());
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    const ProfileStage _stage;
+    const uint32_t _start;
+};
+
+#if SENSOR_PROFILER_ENABLED
+#define SENSOR_PROFILE_CONCAT_(a, b) a##b
+#define SENSOR_PROFILE_CONCAT(a, b) SENSOR_PROFILE_CONCAT_(a, b)
+/// @brief Time the rest of the enclosing block
+#define SENSOR_PROFILE_SCOPE(stage) ProfileScope SENSOR_PROFILE_CONCAT(profileScope, __LINE__)(stage)
+/// @brief Start a lap timer for sequential stages of one function
+#define SENSOR_PROFILE_MARK(mark) uint32_t mark = SensorProfiler::now()
+/// @brief Record the time since the last mark/lap and restart it
+#define SENSOR_PROFILE_LAP(stage, mark)                     \
+    do                                                      \
+    {                                                       \
+        uint32_t profileNow = SensorProfiler::now();        \
+        SensorProfiler::record(stage, mark, profileNow);    \
+        mark = profileNow;                                  \
+    } while (0)
+#else
+#define SENSOR_PROFILE_SCOPE(stage) ((void)0)
+#define SENSOR_PROFILE_MARK(mark) ((void)0)
+#define SENSOR_PROFILE_LAP(stage, mark) ((void)0)
+#endif
+
+#endif
@@ -98,17 +98,20 @@ namespace SensRegs
         SPO2_ADC_RGE_LSB_62PA5_FULLSCALE_16384NA,
     };
 
+    /// @brief LED driven in a multi-LED mode slot, SLOTx of MULTILED_CONFIG1/2
     enum class SlotConfig
     {
         SLOT_DISABLE = 0,
         SLOT_LED1_RED = 1,
-        SLOT_LED1_IR = 1,
+        SLOT_LED2_IR = 2,
     };
 
     enum class Regs
     {
         ISR_STAT1 = 0,
         ISR_STAT2 = 1,
+        INTR_ENABLE1 = 0x02,
+        INTR_ENABLE2 = 0x03,
         FIFO_WR_PTR = 0x04,
         FIFO_OVFLW = 0x05,
         FIFO_RD_PTR = 0x06,
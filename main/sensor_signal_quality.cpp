@@ -0,0 +1,157 @@
+#include "sensor_signal_quality.h"
+
+SignalQuality::SignalQuality(uint32_t sampleRateHz)
+{
+    setSampleRate(sampleRateHz);
+}
+
+void SignalQuality::setSampleRate(uint32_t sampleRateHz)
+{
+    sampleRate = (sampleRateHz != 0) ? sampleRateHz : 1U;
+
+    // time constant of the largest power of two not above one second
+    baselineShift = 31U - static_cast<uint32_t>(__builtin_clz(sampleRate));
+    baselineShift = (baselineShift != 0) ? baselineShift : 1U;
+
+    minInterval = (60U * sampleRate) / kMaxBpm;
+    maxInterval = (60U * sampleRate) / kMinBpm;
+
+    baseline = 0;
+    amplitude = 0;
+    recentIndex = 0;
+    above = false;
+    sinceCrossing = 0;
+    restart();
+}
+
+void SignalQuality::restart()
+{
+    count = 0;
+    irSum = 0;
+    irMin = 0;
+    irMax = 0;
+    saturated = 0;
+    intervals = 0;
+    plausibleIntervals = 0;
+    shortestInterval = 0;
+    longestInterval = 0;
+}
+
+void SignalQuality::push(const SampleFrame *frames, size_t numFrames)
+{
+    if (numFrames == 0)
+    {
+        return;
+    }
+    if (count == 0)
+    {
+        irMin = irMax = frames[0].ir;
+    }
+    if (baseline == 0)
+    {
+        baseline = frames[0].ir << kDcFraction;
+        for (uint32_t &ir : recentIr)
+        {
+            ir = frames[0].ir;
+        }
+    }
+
+    for (size_t i = 0; i < numFrames; i++)
+    {
+        const uint32_t ir = frames[i].ir;
+        const uint32_t red = frames[i].red;
+
+        irSum += ir;
+        irMin = (ir < irMin) ? ir : irMin;
+        irMax = (ir > irMax) ? ir : irMax;
+        saturated += (ir >= kSaturationLevel || red >= kSaturationLevel) ? 1U : 0U;
+
+        // 18-bit samples with kDcFraction fraction bits stay far from the int32_t range
+        int32_t delta = static_cast<int32_t>(ir << kDcFraction) - static_cast<int32_t>(baseline);
+        baseline = static_cast<uint32_t>(static_cast<int32_t>(baseline) + (delta >> baselineShift));
+
+        // crossings of the 4 point average against the baseline
+        recentIr[recentIndex++ & 3U] = ir;
+        const uint32_t smooth = (recentIr[0] + recentIr[1] + recentIr[2] + recentIr[3]) >> 2;
+        const uint32_t level = baseline >> kDcFraction;
+        const int32_t deviation = static_cast<int32_t>(smooth) - static_cast<int32_t>(level);
+
+        // half the mean distance from the baseline, about a third of the pulse amplitude
+        uint32_t magnitude = static_cast<uint32_t>((deviation < 0) ? -deviation : deviation);
+        amplitude = static_cast<uint32_t>(static_cast<int32_t>(amplitude) +
+                                          ((static_cast<int32_t>(magnitude) - static_cast<int32_t>(amplitude)) >> baselineShift));
+        uint32_t hysteresis = amplitude >> 1;
+        hysteresis = (hysteresis > (level >> kHysteresisShift)) ? hysteresis : (level >> kHysteresisShift);
+
+        // stops counting once the interval is too long for any heart rate
+        if (sinceCrossing != 0 && sinceCrossing <= maxInterval + 1U)
+        {
+            sinceCrossing++;
+        }
+        if (!above && deviation > static_cast<int32_t>(hysteresis))
+        {
+            above = true;
+            // noise around the baseline crosses again right away, it does not start a beat
+            uint32_t interval = sinceCrossing - 1U;
+            if (sinceCrossing == 0 || interval >= minInterval)
+            {
+                if (sinceCrossing != 0)
+                {
+                    intervals++;
+                    plausibleIntervals += (interval <= maxInterval) ? 1U : 0U;
+                    shortestInterval = (intervals == 1U || interval < shortestInterval) ? interval : shortestInterval;
+                    longestInterval = (interval > longestInterval) ? interval : longestInterval;
+                }
+                sinceCrossing = 1;
+            }
+        }
+        else if (above && deviation < -static_cast<int32_t>(hysteresis))
+        {
+            above = false;
+        }
+    }
+    count += static_cast<uint32_t>(numFrames);
+}
+
+uint32_t SignalQuality::perfusion() const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint32_t dc = irSum / count;
+    // (irMax - irMin) <= 2^18, times 10000 still fits
+    return (dc != 0) ? ((irMax - irMin) * 10000U) / dc : 0;
+}
+
+SignalQualityCode SignalQuality::evaluate() const
+{
+    if (count == 0)
+    {
+        return SignalQualityCode::GOOD;
+    }
+    if (irSum / count < kMinFingerDc)
+    {
+        return SignalQualityCode::NO_FINGER;
+    }
+    if (saturated * kMaxSaturatedShare > count)
+    {
+        return SignalQualityCode::SATURATED;
+    }
+    if (perfusion() < kMinPerfusion)
+    {
+        return SignalQualityCode::LOW_PERFUSION;
+    }
+    // most beats have to be shorter than at kMinBpm, a window too short for one beat
+    // is only irregular if it does not cross at all
+    if ((intervals == 0) ? (count > maxInterval) : (plausibleIntervals * 2U < intervals))
+    {
+        return SignalQualityCode::IRREGULAR;
+    }
+    // noise crosses at random times, beats of one window are of similar length
+    if (longestInterval > kMaxIntervalSpread * shortestInterval)
+    {
+        return SignalQualityCode::IRREGULAR;
+    }
+    return SignalQualityCode::GOOD;
+}
@@ -0,0 +1,105 @@
+#ifndef SENSOR_SIGNAL_QUALITY_H
+#define SENSOR_SIGNAL_QUALITY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sample_ring.h"
+
+/// @brief Why a window did or did not give a result, also sent over BLE
+enum class SignalQualityCode : uint8_t
+{
+    GOOD = 0,
+    // ir DC level too low, nothing on the sensor
+    NO_FINGER,
+    // too many samples at the top of the ADC range
+    SATURATED,
+    // pulse amplitude too small against the DC level
+    LOW_PERFUSION,
+    // the ir signal does not cross its baseline at a heart rate
+    IRREGULAR,
+    // the signal passed the checks, the algorithm found no valid result
+    NO_ESTIMATE,
+};
+
+/// @brief Cheap signal quality index, updated with every frame while a window is acquired so
+/// that unusable windows skip the SpO2/HR algorithm.
+///
+/// Per frame it keeps the ir sum and range, counts samples near full scale, and follows the
+/// ir baseline with a first order low pass of about one second. Rising crossings of the
+/// baseline are timed. They need a hysteresis of kHysteresisShift below the DC level, and
+/// none is taken within a beat at kMaxBpm of the last one. A pulse gives crossings at a
+/// steady heart rate, noise or motion gives them at random distances or not at all.
+///
+/// evaluate() turns this into a SignalQualityCode, restart() begins the next window.
+/// Constant work per frame and no buffers.
+class SignalQuality
+{
+public:
+    static constexpr uint32_t kMinFingerDc = 50000U;
+    static constexpr uint32_t kSaturationLevel = 0x3FF00U;
+    // AC peak to peak against DC, in 1/10000
+    static constexpr uint32_t kMinPerfusion = 20U;
+    static constexpr uint32_t kMinBpm = 30U;
+    static constexpr uint32_t kMaxBpm = 240U;
+
+    explicit SignalQuality(uint32_t sampleRateHz = 100U);
+
+    /// @brief Rate of the frames passed to push(), resets the state and the baseline
+    void setSampleRate(uint32_t sampleRateHz);
+
+    /// @brief Add frames of the window being acquired
+    void push(const SampleFrame *frames, size_t count);
+
+    /// @brief Quality of the frames since the last restart()
+    SignalQualityCode evaluate() const;
+
+    /// @brief Start the next window, the baseline carries over
+    void restart();
+
+    uint32_t frames() const
+    {
+        return count;
+    }
+
+    /// @brief AC/DC of the ir channel in 1/10000, 0 without frames
+    uint32_t perfusion() const;
+
+private:
+    static constexpr uint32_t kDcFraction = 8U;
+    static constexpr uint32_t kHysteresisShift = 11U;
+    // more than 1/kMaxSaturatedShare of the frames at full scale
+    static constexpr uint32_t kMaxSaturatedShare = 16U;
+    // longest beat of a window against the shortest
+    static constexpr uint32_t kMaxIntervalSpread = 2U;
+
+    uint32_t sampleRate;
+    // log2 of the low pass time constant in frames
+    uint32_t baselineShift;
+    uint32_t minInterval;
+    uint32_t maxInterval;
+
+    // baseline with kDcFraction fraction bits, 0 until the first frame
+    uint32_t baseline = 0;
+    // mean distance of the smoothed ir from the baseline
+    uint32_t amplitude = 0;
+    uint32_t recentIr[4] = {0, 0, 0, 0};
+    uint32_t recentIndex = 0;
+    bool above = false;
+    // frames since the last rising crossing, 0 before the first one
+    uint32_t sinceCrossing = 0;
+
+    // 18-bit samples, the sum holds windows of up to 16384 frames
+    uint32_t count = 0;
+    uint32_t irSum = 0;
+    uint32_t irMin = 0;
+    uint32_t irMax = 0;
+    uint32_t saturated = 0;
+    // crossing intervals of this window, and how many lie within kMinBpm..kMaxBpm
+    uint32_t intervals = 0;
+    uint32_t plausibleIntervals = 0;
+    uint32_t shortestInterval = 0;
+    uint32_t longestInterval = 0;
+};
+
+#endif
@@ -57,10 +57,11 @@
 *******************************************************************************
 */
 #include "sensor_spo2_algorithm.h"
+#include "sensor_spo2_kernels.h"
+#include "sorting_network.h"
+#include "sensor_profiler.h"
 
-static  int32_t an_dx[ BUFFER_SIZE-MA4_SIZE]; // delta
-static  int32_t an_x[ BUFFER_SIZE]; //ir
-static  int32_t an_y[ BUFFER_SIZE]; //red
+static maxim_spo2_context_t st_default_ctx; // scratch of the non-reentrant entry point
 
 void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer,  
                                             int32_t n_ir_buffer_length, 
@@ -72,10 +73,32 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer,
 /**
 * \brief        Calculate the heart rate and SpO2 level
 * \par          Details
+*               Same as maxim_heart_rate_and_oxygen_saturation_r() with one shared scratch context,
+*               only one calculation may run at a time.
+*
+* \retval       None
+*/
+{
+    maxim_heart_rate_and_oxygen_saturation_r(&st_default_ctx, pun_ir_buffer, n_ir_buffer_length, pun_red_buffer,
+                                             pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid);
+}
+
+void maxim_heart_rate_and_oxygen_saturation_r(maxim_spo2_context_t *pst_ctx,
+                                              uint32_t *pun_ir_buffer,  
+                                              int32_t n_ir_buffer_length, 
+                                              uint32_t *pun_red_buffer, 
+                                              int32_t *pn_spo2, 
+                                              int8_t *pch_spo2_valid, 
+                                              int32_t *pn_heart_rate, 
+                                              int8_t  *pch_hr_valid)
+/**
+* \brief        Calculate the heart rate and SpO2 level
+* \par          Details
 *               By detecting  peaks of PPG cycle and corresponding AC/DC of red/infra-red signal, the ratio for the SPO2 is computed.
 *               Since this algorithm is aiming for Arm M0/M3. formaula for SPO2 did not achieve the accuracy due to register overflow.
 *               Thus, accurate SPO2 is precalculated and save longo uch_spo2_table[] per each ratio.
 *
+* \param[in]    *pst_ctx                 - Scratch buffers owned by the caller, one per concurrent calculation
 * \param[in]    *pun_ir_buffer           - IR sensor data buffer
 * \param[in]    n_ir_buffer_length      - IR sensor data buffer length
 * \param[in]    *pun_red_buffer          - Red sensor data buffer
@@ -87,9 +110,12 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer,
 * \retval       None
 */
 {
+    int32_t *an_dx = pst_ctx->an_dx; // delta
+    int32_t *an_x = pst_ctx->an_x; //ir
+    int32_t *an_y = pst_ctx->an_y; //red
     uint32_t un_ir_mean ,un_only_once ;
     int32_t k ,n_i_ratio_count;
-    int32_t i,s ,m, n_exact_ir_valley_locs_count ,n_middle_idx;
+    int32_t i ,m, n_exact_ir_valley_locs_count ,n_middle_idx;
     int32_t n_th1, n_npks,n_c_min;      
     int32_t an_ir_valley_locs[15] ;
     int32_t an_exact_ir_valley_locs[15] ;
@@ -102,6 +128,7 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer,
     int32_t n_y_dc_max_idx = 0, n_x_dc_max_idx = 0; 
     int32_t an_ratio[5],n_ratio_average = 0; 
     int32_t n_nume = 0,  n_denom =0;
+    SENSOR_PROFILE_MARK(n_profile_mark);
     // remove DC of ir signal    
     un_ir_mean =0; 
     for (k=0 ; k<n_ir_buffer_length ; k++ ) un_ir_mean += pun_ir_buffer[k] ;
@@ -109,10 +136,7 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer,
     for (k=0 ; k<n_ir_buffer_length ; k++ )  an_x[k] =  pun_ir_buffer[k] - un_ir_mean ; 
     
     // 4 pt Moving Average
-    for(k=0; k< BUFFER_SIZE-MA4_SIZE; k++){
-        n_denom= ( an_x[k]+an_x[k+1]+ an_x[k+2]+ an_x[k+3]);
-        an_x[k]=  n_denom/(int32_t)4; 
-    }
+    spo2_kernel_ma4(an_x, reinterpret_cast<const uint32_t *>(an_x), 0, BUFFER_SIZE-MA4_SIZE);
 
     // get difference of smoothed IR signal
     
@@ -126,20 +150,12 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer,
     
     // hamming window
     // flip wave form so that we can detect valley with peak detector
-    for ( i=0 ; i<BUFFER_SIZE-HAMMING_SIZE-MA4_SIZE-2 ;i++){
-        s= 0;
-        for( k=i; k<i+ HAMMING_SIZE ;k++){
-            s -= an_dx[k] *auw_hamm[k-i] ; 
-                     }
-        an_dx[i]= s/ (int32_t)1146; // divide by sum of auw_hamm 
-    }
+    spo2_kernel_hamming(an_dx, an_dx, BUFFER_SIZE-HAMMING_SIZE-MA4_SIZE-2);
 
  
-    n_th1=0; // threshold calculation
-    for ( k=0 ; k<BUFFER_SIZE-HAMMING_SIZE ;k++){
-        n_th1 += ((an_dx[k]>0)? an_dx[k] : ((int32_t)0-an_dx[k])) ;
-    }
-    n_th1= n_th1/ ( BUFFER_SIZE-HAMMING_SIZE);
+    // threshold calculation
+    n_th1= spo2_kernel_abs_sum(an_dx, BUFFER_SIZE-HAMMING_SIZE)/ ( BUFFER_SIZE-HAMMING_SIZE);
+    SENSOR_PROFILE_LAP(ProfileStage::ALGO_FILTER, n_profile_mark);
     // peak location is acutally index for sharpest location of raw signal since we flipped the signal         
     maxim_find_peaks( an_dx_peak_locs, &n_npks, an_dx, BUFFER_SIZE-HAMMING_SIZE, n_th1, 8, 5 );//peak_height, peak_distance, max_num_peaks 
 
@@ -155,6 +171,9 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer,
         *pn_heart_rate = -999;
         *pch_hr_valid  = 0;
     }
+    SENSOR_PROFILE_LAP(ProfileStage::ALGO_PEAKS, n_profile_mark);
+    // valleys, ratios and the SpO2 lookup, up to any of the early returns
+    SENSOR_PROFILE_SCOPE(ProfileStage::ALGO_RATIO);
             
     for ( k=0 ; k<n_npks ;k++)
         an_ir_valley_locs[k]=an_dx_peak_locs[k]+HAMMING_SIZE/2; 
@@ -192,10 +211,8 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer,
        return;
     }
     // 4 pt MA
-    for(k=0; k< BUFFER_SIZE-MA4_SIZE; k++){
-        an_x[k]=( an_x[k]+an_x[k+1]+ an_x[k+2]+ an_x[k+3])/(int32_t)4;
-        an_y[k]=( an_y[k]+an_y[k+1]+ an_y[k+2]+ an_y[k+3])/(int32_t)4;
-    }
+    spo2_kernel_ma4(an_x, reinterpret_cast<const uint32_t *>(an_x), 0, BUFFER_SIZE-MA4_SIZE);
+    spo2_kernel_ma4(an_y, reinterpret_cast<const uint32_t *>(an_y), 0, BUFFER_SIZE-MA4_SIZE);
 
     //using an_exact_ir_valley_locs , find ir-red DC andir-red AC for SPO2 calibration ratio
     //finding AC/DC maximum of raw ir * red between two valley locations
@@ -217,10 +234,11 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer,
         n_y_dc_max= -16777216 ; 
         n_x_dc_max= - 16777216; 
         if (an_exact_ir_valley_locs[k+1]-an_exact_ir_valley_locs[k] >10){
-            for (i=an_exact_ir_valley_locs[k]; i< an_exact_ir_valley_locs[k+1]; i++){
-                if (an_x[i]> n_x_dc_max) {n_x_dc_max =an_x[i];n_x_dc_max_idx =i; }
-                if (an_y[i]> n_y_dc_max) {n_y_dc_max =an_y[i];n_y_dc_max_idx=i;}
-            }
+            // first maximum, the samples are never below the initial -2^24
+            n_x_dc_max_idx= an_exact_ir_valley_locs[k] + spo2_kernel_argmax(&an_x[an_exact_ir_valley_locs[k]], an_exact_ir_valley_locs[k+1]-an_exact_ir_valley_locs[k]);
+            n_y_dc_max_idx= an_exact_ir_valley_locs[k] + spo2_kernel_argmax(&an_y[an_exact_ir_valley_locs[k]], an_exact_ir_valley_locs[k+1]-an_exact_ir_valley_locs[k]);
+            n_x_dc_max= an_x[n_x_dc_max_idx];
+            n_y_dc_max= an_y[n_y_dc_max_idx];
             n_y_ac= (an_y[an_exact_ir_valley_locs[k+1]] - an_y[an_exact_ir_valley_locs[k] ] )*(n_y_dc_max_idx -an_exact_ir_valley_locs[k]); //red
             n_y_ac=  an_y[an_exact_ir_valley_locs[k]] + n_y_ac/ (an_exact_ir_valley_locs[k+1] - an_exact_ir_valley_locs[k])  ; 
         
@@ -239,7 +257,7 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer,
         }
     }
 
-    maxim_sort_ascend(an_ratio, n_i_ratio_count);
+    maxim_sort_ratios(an_ratio, n_i_ratio_count);
     n_middle_idx= n_i_ratio_count/2;
 
     if (n_middle_idx >1)
@@ -290,7 +308,7 @@ void maxim_peaks_above_min_height(int32_t *pn_locs, int32_t *pn_npks, int32_t  *
             n_width = 1;
             while (i+n_width < n_size && pn_x[i] == pn_x[i+n_width])    // find flat peaks
                 n_width++;
-            if (pn_x[i] > pn_x[i+n_width] && (*pn_npks) < 15 ){                            // find right edge of peaks
+            if (pn_x[i] > pn_x[i+n_width] && (*pn_npks) < MAX_PEAKS ){                            // find right edge of peaks
                 pn_locs[(*pn_npks)++] = i;        
                 // for flat peaks, peak location is left edge
                 i += n_width+1;
@@ -308,7 +326,71 @@ void maxim_remove_close_peaks(int32_t *pn_locs, int32_t *pn_npks, int32_t *pn_x,
 /**
 * \brief        Remove peaks
 * \par          Details
-*               Remove peaks separated by less than MIN_DISTANCE
+*               Remove peaks separated by less than MIN_DISTANCE. Same peaks as
+*               maxim_remove_close_peaks_ref: going from the highest peak down (the
+*               earlier one of equal peaks first), a peak stays unless a peak that
+*               stayed before it is too close. Peaks in ascending order as
+*               maxim_peaks_above_min_height reports them are ranked by a fixed
+*               sorting network, anything else takes the reference path.
+*
+* \retval       None
+*/
+{
+    int32_t i, n_slot, n_loc, n_dist;
+    int32_t n_npks = *pn_npks;
+    int64_t an_key[MAX_PEAKS];
+    uint32_t un_kept, un_left, un_right;
+    bool b_ascending = n_npks >= 0 && n_npks <= MAX_PEAKS;
+
+    for ( i = 1; b_ascending && i < n_npks; i++ )
+        b_ascending = pn_locs[i-1] < pn_locs[i];
+    if ( !b_ascending ){
+        maxim_remove_close_peaks_ref( pn_locs, pn_npks, pn_x, n_min_distance );
+        return;
+    }
+
+    // unique key per peak: height, then the earlier slot
+    for ( i = 0; i < n_npks; i++ )
+        an_key[i] = (int64_t)pn_x[pn_locs[i]] * 16 + ( MAX_PEAKS - i );
+    SortingNetwork<MAX_PEAKS>::sortFirst( an_key, n_npks, []( int64_t a, int64_t b ) { return a > b; } );
+
+    // only the nearest kept peak on either side can be too close
+    un_kept = 0;
+    for ( i = 0; i < n_npks; i++ ){
+        n_slot = MAX_PEAKS - (int32_t)( an_key[i] & 15 );
+        n_loc = pn_locs[n_slot];
+        n_dist = n_loc + 1; // lag-zero peak of autocorr is at index -1
+        if ( n_dist <= n_min_distance && n_dist >= -n_min_distance )
+            continue;
+        un_left = un_kept & ( ( 1U << n_slot ) - 1 );
+        if ( un_left != 0 ){
+            n_dist = n_loc - pn_locs[31 - __builtin_clz( un_left )];
+            if ( n_dist <= n_min_distance && n_dist >= -n_min_distance )
+                continue;
+        }
+        un_right = un_kept >> ( n_slot + 1 );
+        if ( un_right != 0 ){
+            n_dist = pn_locs[n_slot + 1 + __builtin_ctz( un_right )] - n_loc;
+            if ( n_dist <= n_min_distance && n_dist >= -n_min_distance )
+                continue;
+        }
+        un_kept |= 1U << n_slot;
+    }
+
+    // kept peaks are already in ascending order
+    *pn_npks = 0;
+    while ( un_kept != 0 ){
+        pn_locs[(*pn_npks)++] = pn_locs[__builtin_ctz( un_kept )];
+        un_kept &= un_kept - 1;
+    }
+}
+
+void maxim_remove_close_peaks_ref(int32_t *pn_locs, int32_t *pn_npks, int32_t *pn_x,int32_t n_min_distance)
+/**
+* \brief        Remove peaks
+* \par          Details
+*               Remove peaks separated by less than MIN_DISTANCE, the original
+*               insertion sort version. Reference for maxim_remove_close_peaks.
 *
 * \retval       None
 */
@@ -351,6 +433,23 @@ void maxim_sort_ascend(int32_t *pn_x,int32_t n_size)
     }
 }
 
+void maxim_sort_ratios(int32_t *pn_ratio, int32_t n_size)
+/**
+* \brief        Sort ratios
+* \par          Details
+*               Sort ratios in ascending order, the same order as maxim_sort_ascend.
+*               Up to MAX_RATIOS ratios go through a fixed sorting network.
+*
+* \retval       None
+*/
+{
+    if (n_size < 0 || n_size > MAX_RATIOS){
+        maxim_sort_ascend(pn_ratio, n_size);
+        return;
+    }
+    SortingNetwork<MAX_RATIOS>::sortFirst(pn_ratio, n_size, [](int32_t a, int32_t b) { return a < b; });
+}
+
 void maxim_sort_indices_descend(int32_t *pn_x, int32_t *pn_indx, int32_t n_size)
 /**
 * \brief        Sort indices
@@ -71,6 +71,8 @@
 #define HR_FIFO_SIZE 7
 #define MA4_SIZE  4 // DO NOT CHANGE
 #define HAMMING_SIZE  5// DO NOT CHANGE
+#define MAX_PEAKS  15 // most peaks maxim_peaks_above_min_height reports
+#define MAX_RATIOS  5 // most ratios that go into the SpO2 median
 #define min(x,y) ((x) < (y) ? (x) : (y))
 
 const uint16_t auw_hamm[31]={ 41,    276,    512,    276,     41 }; //Hamm=  long16(512* hamming(5)');
@@ -86,11 +88,22 @@ const uint8_t uch_spo2_table[184]={ 95, 95, 95, 96, 96, 96, 97, 97, 97, 97, 97,
                             28, 27, 26, 25, 23, 22, 21, 20, 19, 17, 16, 15, 14, 12, 11, 10, 9, 7, 6, 5, 
                             3, 2, 1 } ;
 
+// scratch of one calculation
+typedef struct
+{
+    int32_t an_dx[BUFFER_SIZE-MA4_SIZE]; // delta
+    int32_t an_x[BUFFER_SIZE]; //ir
+    int32_t an_y[BUFFER_SIZE]; //red
+} maxim_spo2_context_t;
+
+void maxim_heart_rate_and_oxygen_saturation_r(maxim_spo2_context_t *pst_ctx, uint32_t *pun_ir_buffer ,  int32_t n_ir_buffer_length, uint32_t *pun_red_buffer ,   int32_t *pn_spo2, int8_t *pch_spo2_valid ,  int32_t *pn_heart_rate , int8_t  *pch_hr_valid);
 void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer ,  int32_t n_ir_buffer_length, uint32_t *pun_red_buffer ,   int32_t *pn_spo2, int8_t *pch_spo2_valid ,  int32_t *pn_heart_rate , int8_t  *pch_hr_valid);
 void maxim_find_peaks( int32_t *pn_locs, int32_t *pn_npks,  int32_t *pn_x, int32_t n_size, int32_t n_min_height, int32_t n_min_distance, int32_t n_max_num );
 void maxim_peaks_above_min_height( int32_t *pn_locs, int32_t *pn_npks,  int32_t *pn_x, int32_t n_size, int32_t n_min_height );
 void maxim_remove_close_peaks( int32_t *pn_locs, int32_t *pn_npks,   int32_t  *pn_x, int32_t n_min_distance );
+void maxim_remove_close_peaks_ref( int32_t *pn_locs, int32_t *pn_npks,   int32_t  *pn_x, int32_t n_min_distance );
 void maxim_sort_ascend( int32_t *pn_x, int32_t n_size );
+void maxim_sort_ratios( int32_t *pn_ratio, int32_t n_size );
 void maxim_sort_indices_descend(  int32_t  *pn_x, int32_t *pn_indx, int32_t n_size);
 
 #endif /* ALGORITHM_H_ */
@@ -0,0 +1,196 @@
+#include "sensor_spo2_kernels.h"
+#include "sensor_spo2_algorithm.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SPO2_KERNELS_SSE2 1
+#endif
+
+static constexpr int32_t kHammingSum = 1146; // sum of auw_hamm
+
+static inline int32_t ma4_at(const uint32_t *pun_in, uint32_t un_dc, int32_t k)
+{
+    int32_t n_sum = static_cast<int32_t>(pun_in[k] - un_dc) + static_cast<int32_t>(pun_in[k + 1] - un_dc) +
+                    static_cast<int32_t>(pun_in[k + 2] - un_dc) + static_cast<int32_t>(pun_in[k + 3] - un_dc);
+    return n_sum / (int32_t)4;
+}
+
+static inline int32_t hamming_at(const int32_t *pn_in, int32_t i)
+{
+    int32_t s = 0;
+    for (int32_t j = 0; j < HAMMING_SIZE; j++)
+        s -= pn_in[i + j] * auw_hamm[j];
+    return s / kHammingSum;
+}
+
+static inline int32_t abs_value(int32_t n)
+{
+    return (n > 0) ? n : ((int32_t)0 - n);
+}
+
+#ifdef SPO2_KERNELS_SSE2
+/// @brief a / kHammingSum per lane, rounded toward zero like the integer division.
+/// |a| * kHammingMagic >> 42 is exact for every |a| up to 2^31.
+static inline __m128i div_hamming_sum(__m128i a)
+{
+    static constexpr uint32_t kHammingMagic = 3837736921U; // ceil(2^42 / 1146)
+    const __m128i magic = _mm_set1_epi32(static_cast<int32_t>(kHammingMagic));
+    __m128i sign = _mm_srai_epi32(a, 31);
+    __m128i abs = _mm_sub_epi32(_mm_xor_si128(a, sign), sign);
+    __m128i even = _mm_srli_epi64(_mm_mul_epu32(abs, magic), 42);
+    __m128i odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(abs, 32), magic), 42);
+    __m128i q = _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+    return _mm_sub_epi32(_mm_xor_si128(q, sign), sign);
+}
+
+static inline __m128i load(const void *p)
+{
+    return _mm_loadu_si128(static_cast<const __m128i *>(p));
+}
+#endif
+
+void spo2_kernel_ma4_ref(int32_t *pn_out, const uint32_t *pun_in, uint32_t un_dc, int32_t n_out)
+{
+    for (int32_t k = 0; k < n_out; k++)
+        pn_out[k] = ma4_at(pun_in, un_dc, k);
+}
+
+void spo2_kernel_ma4(int32_t *pn_out, const uint32_t *pun_in, uint32_t un_dc, int32_t n_out)
+{
+    int32_t k = 0;
+#ifdef SPO2_KERNELS_SSE2
+    const __m128i dc = _mm_set1_epi32(static_cast<int32_t>(un_dc));
+    for (; k + 4 <= n_out; k += 4)
+    {
+        __m128i s = _mm_add_epi32(_mm_sub_epi32(load(pun_in + k), dc), _mm_sub_epi32(load(pun_in + k + 1), dc));
+        s = _mm_add_epi32(s, _mm_add_epi32(_mm_sub_epi32(load(pun_in + k + 2), dc), _mm_sub_epi32(load(pun_in + k + 3), dc)));
+        // divide by 4 rounding toward zero like the integer division
+        s = _mm_add_epi32(s, _mm_srli_epi32(_mm_srai_epi32(s, 31), 30));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pn_out + k), _mm_srai_epi32(s, 2));
+    }
+#endif
+    for (; k < n_out; k++)
+        pn_out[k] = ma4_at(pun_in, un_dc, k);
+}
+
+void spo2_kernel_hamming_ref(int32_t *pn_out, const int32_t *pn_in, int32_t n_out)
+{
+    for (int32_t i = 0; i < n_out; i++)
+        pn_out[i] = hamming_at(pn_in, i);
+}
+
+void spo2_kernel_hamming(int32_t *pn_out, const int32_t *pn_in, int32_t n_out)
+{
+    // auw_hamm folded: 41 * (x0 + x4) + 276 * (x1 + x3) + 512 * x2, equal to the reference
+    // in 32-bit arithmetic. spo2_kernel_check catches it if the taps ever change.
+    int32_t i = 0;
+#ifdef SPO2_KERNELS_SSE2
+    for (; i + 4 <= n_out; i += 4)
+    {
+        __m128i outer = _mm_add_epi32(load(pn_in + i), load(pn_in + i + 4));
+        __m128i inner = _mm_add_epi32(load(pn_in + i + 1), load(pn_in + i + 3));
+        __m128i s = _mm_slli_epi32(load(pn_in + i + 2), 9);
+        s = _mm_add_epi32(s, _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(outer, 5), _mm_slli_epi32(outer, 3)), outer));
+        s = _mm_add_epi32(s, _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(inner, 8), _mm_slli_epi32(inner, 4)), _mm_slli_epi32(inner, 2)));
+        s = _mm_sub_epi32(_mm_setzero_si128(), s);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pn_out + i), div_hamming_sum(s));
+    }
+#endif
+    for (; i < n_out; i++)
+    {
+        // unsigned so the folded sum wraps like the reference would
+        uint32_t un_outer = static_cast<uint32_t>(pn_in[i]) + static_cast<uint32_t>(pn_in[i + 4]);
+        uint32_t un_inner = static_cast<uint32_t>(pn_in[i + 1]) + static_cast<uint32_t>(pn_in[i + 3]);
+        uint32_t un_s = un_outer * 41U + un_inner * 276U + static_cast<uint32_t>(pn_in[i + 2]) * 512U;
+        pn_out[i] = static_cast<int32_t>(0U - un_s) / kHammingSum;
+    }
+}
+
+int32_t spo2_kernel_abs_sum_ref(const int32_t *pn_in, int32_t n_size)
+{
+    int32_t n_sum = 0;
+    for (int32_t k = 0; k < n_size; k++)
+        n_sum += abs_value(pn_in[k]);
+    return n_sum;
+}
+
+int32_t spo2_kernel_abs_sum(const int32_t *pn_in, int32_t n_size)
+{
+    // unsigned lanes, the sum wraps the same way in any order
+    uint32_t un_sum = 0;
+    int32_t k = 0;
+#ifdef SPO2_KERNELS_SSE2
+    __m128i acc = _mm_setzero_si128();
+    for (; k + 4 <= n_size; k += 4)
+    {
+        __m128i x = load(pn_in + k);
+        __m128i sign = _mm_srai_epi32(x, 31);
+        acc = _mm_add_epi32(acc, _mm_sub_epi32(_mm_xor_si128(x, sign), sign));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    un_sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc));
+#else
+    uint32_t aun_sum[4] = {0, 0, 0, 0};
+    for (; k + 4 <= n_size; k += 4)
+        for (int32_t j = 0; j < 4; j++)
+            aun_sum[j] += static_cast<uint32_t>(abs_value(pn_in[k + j]));
+    un_sum = aun_sum[0] + aun_sum[1] + aun_sum[2] + aun_sum[3];
+#endif
+    for (; k < n_size; k++)
+        un_sum += static_cast<uint32_t>(abs_value(pn_in[k]));
+    return static_cast<int32_t>(un_sum);
+}
+
+int32_t spo2_kernel_argmax_ref(const int32_t *pn_in, int32_t n_size)
+{
+    int32_t n_max = pn_in[0];
+    int32_t n_max_idx = 0;
+    for (int32_t k = 1; k < n_size; k++)
+        if (pn_in[k] > n_max)
+        {
+            n_max = pn_in[k];
+            n_max_idx = k;
+        }
+    return n_max_idx;
+}
+
+int32_t spo2_kernel_argmax(const int32_t *pn_in, int32_t n_size)
+{
+    // maximum first, then its first position; both loops are free of the index dependency
+    int32_t n_max = pn_in[0];
+    int32_t k = 0;
+#ifdef SPO2_KERNELS_SSE2
+    if (n_size >= 4)
+    {
+        __m128i vmax = load(pn_in);
+        for (k = 4; k + 4 <= n_size; k += 4)
+        {
+            __m128i x = load(pn_in + k);
+            __m128i gt = _mm_cmpgt_epi32(x, vmax);
+            vmax = _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, vmax));
+        }
+        alignas(16) int32_t an_max[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(an_max), vmax);
+        for (int32_t j = 0; j < 4; j++)
+            n_max = (an_max[j] > n_max) ? an_max[j] : n_max;
+    }
+#endif
+    for (; k < n_size; k++)
+        n_max = (pn_in[k] > n_max) ? pn_in[k] : n_max;
+
+    k = 0;
+#ifdef SPO2_KERNELS_SSE2
+    const __m128i target = _mm_set1_epi32(n_max);
+    for (; k + 4 <= n_size; k += 4)
+    {
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(load(pn_in + k), target)));
+        if (mask != 0)
+            return k + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+#endif
+    for (; k < n_size; k++)
+        if (pn_in[k] == n_max)
+            return k;
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef SENSOR_SPO2_KERNELS_H
+#define SENSOR_SPO2_KERNELS_H
+
+#include <stdint.h>
+
+// Fixed point kernels of the SpO2/HR front end.
+//
+// Every kernel has a scalar reference (*_ref) that is the loop of the original algorithm,
+// and a fast version that gives bit-identical results. The fast versions use SSE2 on the
+// host and otherwise plain loops without carried state that the compiler can unroll or
+// vectorize. Kernels that write pn_out may run in place: out[k] is written after the last
+// read of in[k].
+
+/// @brief pn_out[k] = sum of (int32_t)(pun_in[k + j] - un_dc) for j < 4, divided by 4,
+/// for k < n_out. Reads n_out + 3 input samples.
+void spo2_kernel_ma4(int32_t *pn_out, const uint32_t *pun_in, uint32_t un_dc, int32_t n_out);
+void spo2_kernel_ma4_ref(int32_t *pn_out, const uint32_t *pun_in, uint32_t un_dc, int32_t n_out);
+
+/// @brief Flipped 5 tap Hamming filter: pn_out[i] = -sum of pn_in[i + j] * auw_hamm[j],
+/// divided by the sum of auw_hamm, for i < n_out. Reads n_out + 4 input samples.
+void spo2_kernel_hamming(int32_t *pn_out, const int32_t *pn_in, int32_t n_out);
+void spo2_kernel_hamming_ref(int32_t *pn_out, const int32_t *pn_in, int32_t n_out);
+
+/// @brief Sum of |pn_in[k]| for k < n_size
+int32_t spo2_kernel_abs_sum(const int32_t *pn_in, int32_t n_size);
+int32_t spo2_kernel_abs_sum_ref(const int32_t *pn_in, int32_t n_size);
+
+/// @brief Index of the first maximum of pn_in[0..n_size), n_size has to be at least 1
+int32_t spo2_kernel_argmax(const int32_t *pn_in, int32_t n_size);
+int32_t spo2_kernel_argmax_ref(const int32_t *pn_in, int32_t n_size);
+
+#endif
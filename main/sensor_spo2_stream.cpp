@@ -0,0 +1,313 @@
+#include "sensor_spo2_stream.h"
+#include "sensor_spo2_algorithm.h"
+
+#include <string.h>
+
+Spo2Stream::Spo2Stream(uint32_t sampleRateHz)
+{
+    setSampleRate(sampleRateHz);
+}
+
+void Spo2Stream::setSampleRate(uint32_t sampleRateHz)
+{
+    sampleRate = sampleRateHz;
+    // rounded as Spo2Window::scaled, so both agree at every rate
+    minPeakDistance = scaled(8U, sampleRateHz);
+    valleyHalfWidth = scaled(5U, sampleRateHz);
+    minValleyDistance = static_cast<int32_t>(scaled(10U, sampleRateHz));
+    reset();
+}
+
+void Spo2Stream::reset()
+{
+    count = 0;
+    memset(rawIr, 0, sizeof(rawIr));
+    memset(rawRed, 0, sizeof(rawRed));
+    memset(smoothIr, 0, sizeof(smoothIr));
+    memset(smoothRed, 0, sizeof(smoothRed));
+
+    dxPrev = 0;
+    memset(dx2, 0, sizeof(dx2));
+    memset(absH, 0, sizeof(absH));
+    absHSum = 0;
+
+    hPrev = 0;
+    candidateActive = false;
+    pendingActive = false;
+
+    lastPeakValid = false;
+    intervalCount = 0;
+    lastValleyValid = false;
+    ratioCount = 0;
+
+    current = Spo2StreamResult{-999, 0, -999, 0};
+}
+
+bool Spo2Stream::push(uint32_t red, uint32_t ir)
+{
+    const uint32_t n = count++;
+    rawIr[n & kHistoryMask] = static_cast<int32_t>(ir);
+    rawRed[n & 3U] = static_cast<int32_t>(red);
+
+    if (n < MA4_SIZE - 1)
+    {
+        return false;
+    }
+
+    // 4 point moving average ending at this sample, indexed by its first sample
+    const uint32_t k = n - (MA4_SIZE - 1);
+    int32_t sumIr = 0;
+    for (uint32_t j = k; j <= n; j++)
+    {
+        sumIr += rawIr[j & kHistoryMask];
+    }
+    const int32_t sumRed = rawRed[0] + rawRed[1] + rawRed[2] + rawRed[3];
+    smoothIr[k & kHistoryMask] = sumIr / 4;
+    smoothRed[k & kHistoryMask] = sumRed / 4;
+
+    if (k < 1)
+    {
+        return false;
+    }
+
+    // difference of the smoothed ir signal, then its 2 point moving average
+    const int32_t dx = smoothIr[k & kHistoryMask] - smoothIr[(k - 1) & kHistoryMask];
+    const uint32_t d = k - 1;
+    if (d >= 1)
+    {
+        memmove(&dx2[0], &dx2[1], sizeof(dx2) - sizeof(dx2[0]));
+        dx2[HAMMING_SIZE - 1] = (dxPrev + dx) / 2;
+    }
+    dxPrev = dx;
+
+    if (d < HAMMING_SIZE)
+    {
+        return false;
+    }
+
+    // hamming window, flipped so valleys become peaks
+    int32_t s = 0;
+    for (uint32_t j = 0; j < HAMMING_SIZE; j++)
+    {
+        s -= dx2[j] * auw_hamm[j];
+    }
+
+    return pushFiltered(d - HAMMING_SIZE, s / kHammingSum);
+}
+
+bool Spo2Stream::pushFiltered(uint32_t hIndex, int32_t h)
+{
+    // threshold is the mean absolute filtered level
+    const int32_t absValue = (h > 0) ? h : -h;
+    absHSum += absValue - absH[hIndex % kThresholdWindow];
+    absH[hIndex % kThresholdWindow] = absValue;
+    const uint32_t filled = (hIndex + 1U < kThresholdWindow) ? hIndex + 1U : kThresholdWindow;
+    const int32_t threshold = static_cast<int32_t>(absHSum / filled);
+
+    bool beat = false;
+
+    // flat peaks are reported at their left edge, like maxim_peaks_above_min_height
+    if (candidateActive && h == candidateValue)
+    {
+        hPrev = h;
+    }
+    else
+    {
+        if (candidateActive && h < candidateValue)
+        {
+            beat = offerPeak(candidateIndex, candidateValue);
+        }
+
+        candidateActive = (hIndex > 0) && (h > hPrev) && (h > threshold);
+        candidateIndex = hIndex;
+        candidateValue = h;
+        hPrev = h;
+    }
+
+    // no later peak can be closer than minPeakDistance to the pending one any more
+    if (pendingActive && hIndex > pendingIndex + minPeakDistance &&
+        !(candidateActive && candidateIndex <= pendingIndex + minPeakDistance))
+    {
+        pendingActive = false;
+        confirmPeak(pendingIndex);
+        beat = true;
+    }
+
+    return beat;
+}
+
+bool Spo2Stream::offerPeak(uint32_t hIndex, int32_t value)
+{
+    bool beat = false;
+
+    if (pendingActive)
+    {
+        // of two close peaks the higher one stays, the earlier one on a tie
+        if (hIndex - pendingIndex <= minPeakDistance)
+        {
+            if (value > pendingValue)
+            {
+                pendingIndex = hIndex;
+                pendingValue = value;
+            }
+            return false;
+        }
+
+        confirmPeak(pendingIndex);
+        beat = true;
+    }
+
+    pendingActive = true;
+    pendingIndex = hIndex;
+    pendingValue = value;
+    return beat;
+}
+
+void Spo2Stream::confirmPeak(uint32_t hIndex)
+{
+    const uint32_t newest = count - 1;
+
+    // heart rate from the last beat intervals
+    if (lastPeakValid)
+    {
+        const uint32_t interval = hIndex - lastPeakIndex;
+        if (interval < kHistory)
+        {
+            if (intervalCount == kMaxIntervals)
+            {
+                memmove(&intervals[0], &intervals[1], sizeof(intervals) - sizeof(intervals[0]));
+                intervalCount--;
+            }
+            intervals[intervalCount++] = interval;
+        }
+        else
+        {
+            intervalCount = 0;
+        }
+    }
+    lastPeakValid = true;
+    lastPeakIndex = hIndex;
+
+    if (intervalCount > 0)
+    {
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < intervalCount; i++)
+        {
+            sum += intervals[i];
+        }
+        current.heartRate = static_cast<int32_t>((60U * sampleRate) / (sum / intervalCount));
+        current.heartRateValid = 1;
+    }
+    else
+    {
+        current.heartRate = -999;
+        current.heartRateValid = 0;
+    }
+
+    // precise minimum of the raw ir signal near the valley
+    const uint32_t m = hIndex + HAMMING_SIZE / 2;
+    if (m <= valleyHalfWidth || newest - (m - valleyHalfWidth) >= kHistory)
+    {
+        return;
+    }
+
+    int32_t minValue = 16777216; // 2^24
+    uint32_t valley = m;
+    for (uint32_t i = m - valleyHalfWidth; i < m + valleyHalfWidth; i++)
+    {
+        if (rawIr[i & kHistoryMask] < minValue)
+        {
+            minValue = rawIr[i & kHistoryMask];
+            valley = i;
+        }
+    }
+
+    if (lastValleyValid)
+    {
+        addRatio(lastValley, valley);
+        updateSpo2();
+    }
+    lastValleyValid = true;
+    lastValley = valley;
+}
+
+void Spo2Stream::addRatio(uint32_t valley0, uint32_t valley1)
+{
+    const uint32_t newest = count - 1;
+    const int32_t width = static_cast<int32_t>(valley1 - valley0);
+
+    // the smoothed sample at valley1 ends MA4_SIZE - 1 samples later
+    if (width <= minValleyDistance || newest - valley0 >= kHistory ||
+        valley1 + (MA4_SIZE - 1) > newest)
+    {
+        return;
+    }
+
+    const int32_t *x = smoothIr;
+    const int32_t *y = smoothRed;
+    int32_t xDcMax = -16777216;
+    int32_t yDcMax = -16777216;
+    uint32_t xDcMaxIdx = valley0;
+    uint32_t yDcMaxIdx = valley0;
+    for (uint32_t i = valley0; i < valley1; i++)
+    {
+        if (x[i & kHistoryMask] > xDcMax)
+        {
+            xDcMax = x[i & kHistoryMask];
+            xDcMaxIdx = i;
+        }
+        if (y[i & kHistoryMask] > yDcMax)
+        {
+            yDcMax = y[i & kHistoryMask];
+            yDcMaxIdx = i;
+        }
+    }
+
+    const int32_t x0 = x[valley0 & kHistoryMask];
+    const int32_t x1 = x[valley1 & kHistoryMask];
+    const int32_t y0 = y[valley0 & kHistoryMask];
+    const int32_t y1 = y[valley1 & kHistoryMask];
+
+    // subtract the linear DC component between the valleys, as the batch function does
+    // (including taking the ir value at the red maximum)
+    int32_t yAc = (y1 - y0) * static_cast<int32_t>(yDcMaxIdx - valley0);
+    yAc = y0 + yAc / width;
+    yAc = y[yDcMaxIdx & kHistoryMask] - yAc;
+    int32_t xAc = (x1 - x0) * static_cast<int32_t>(xDcMaxIdx - valley0);
+    xAc = x0 + xAc / width;
+    xAc = x[yDcMaxIdx & kHistoryMask] - xAc;
+
+    const int32_t nume = (yAc * xDcMax) >> 7;
+    const int32_t denom = (xAc * yDcMax) >> 7;
+    if (denom > 0 && nume != 0)
+    {
+        if (ratioCount == kMaxRatios)
+        {
+            memmove(&ratios[0], &ratios[1], sizeof(ratios) - sizeof(ratios[0]));
+            ratioCount--;
+        }
+        ratios[ratioCount++] = (nume * 100) / denom;
+    }
+}
+
+void Spo2Stream::updateSpo2()
+{
+    int32_t sorted[kMaxRatios] = {0};
+    memcpy(sorted, ratios, ratioCount * sizeof(ratios[0]));
+    maxim_sort_ascend(sorted, static_cast<int32_t>(ratioCount));
+
+    // same median as the batch function
+    const uint32_t middle = ratioCount / 2;
+    const int32_t ratioAverage = (middle > 1) ? (sorted[middle - 1] + sorted[middle]) / 2 : sorted[middle];
+
+    if (ratioAverage > 2 && ratioAverage < 184)
+    {
+        current.spo2 = uch_spo2_table[ratioAverage];
+        current.spo2Valid = 1;
+    }
+    else
+    {
+        current.spo2 = -999;
+        current.spo2Valid = 0;
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef SENSOR_SPO2_STREAM_H
+#define SENSOR_SPO2_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// @brief Estimates after the last confirmed beat, same meaning as the outputs of
+/// maxim_heart_rate_and_oxygen_saturation
+struct Spo2StreamResult
+{
+    int32_t heartRate;
+    int8_t heartRateValid;
+    int32_t spo2;
+    int8_t spo2Valid;
+};
+
+/// @brief Sample-by-sample version of maxim_heart_rate_and_oxygen_saturation.
+///
+/// Runs the same chain (4 point moving average, first difference, 2 point moving average,
+/// inverted Hamming filter, peak search above the mean absolute level, valley refinement on
+/// the raw ir signal, AC/DC ratio between valleys) on a sliding state instead of a buffer, and
+/// updates the estimates every time a valley is confirmed, about 0.2 s after it happened.
+/// Every push costs a constant amount of work; confirming a beat additionally scans the
+/// smoothed samples of that beat once.
+///
+/// Differences to the batch function, which bound how far the results can differ:
+/// - the peak threshold is the mean over the last kThresholdWindow filtered samples
+///   instead of over the whole window
+/// - close peaks are resolved pairwise in time order instead of globally by height
+/// - heart rate averages the last kMaxIntervals beat intervals and SpO2 takes the median of
+///   the last kMaxRatios ratios, the batch function uses the beats inside its window
+/// - the mean is not removed before the moving average, the derivative does not depend on it
+///   and only the rounding of the average differs
+/// Tolerance, checked by host/spo2_stream_check.cpp on synthetic PPG: at 60..150 bpm with
+/// moderate noise every estimate is within 3 bpm and 2 % SpO2 of the batch function over the
+/// last 5 s. Where the batch function itself picks up spurious peaks (slow or very noisy
+/// pulses) single estimates can differ by more, but the mean heart rate error against the
+/// true rate is not larger than that of the batch function.
+class Spo2Stream
+{
+public:
+    explicit Spo2Stream(uint32_t sampleRateHz = 100U);
+
+    /// @brief Rate of the frames passed to push(), resets the state
+    void setSampleRate(uint32_t sampleRateHz);
+    void reset();
+
+    /// @brief Add one frame.
+    /// @return true if a beat was confirmed and result() was updated
+    bool push(uint32_t red, uint32_t ir);
+
+    const Spo2StreamResult &result() const
+    {
+        return current;
+    }
+
+private:
+    // longest beat that still gives a ratio, samples of the smoothed history
+    static constexpr uint32_t kHistory = 256U;
+    static constexpr uint32_t kHistoryMask = kHistory - 1U;
+    static constexpr uint32_t kThresholdWindow = 256U;
+    static constexpr uint32_t kMaxIntervals = 4U;
+    static constexpr uint32_t kMaxRatios = 5U;
+    static constexpr int32_t kHammingSum = 1146;
+
+    /// @brief Distance of n samples at 100 Hz expressed at sampleRateHz, at least one sample
+    static constexpr uint32_t scaled(uint32_t samplesAt100Hz, uint32_t sampleRateHz)
+    {
+        uint32_t distance = (samplesAt100Hz * sampleRateHz + 50U) / 100U;
+        return distance > 0U ? distance : 1U;
+    }
+
+    uint32_t sampleRate;
+    // distances of the batch function, 8, 5 and 10 samples at 100 Hz
+    uint32_t minPeakDistance;
+    // valley search window around the peak
+    uint32_t valleyHalfWidth;
+    // shortest beat that gives a ratio
+    int32_t minValleyDistance;
+
+    uint32_t count = 0;
+
+    // raw and 4 point averaged samples by raw index
+    int32_t rawIr[kHistory];
+    int32_t rawRed[4];
+    int32_t smoothIr[kHistory];
+    int32_t smoothRed[kHistory];
+
+    // derivative chain, the filtered sample h[i] belongs to raw sample i and
+    // depends on the raw samples up to i + 9
+    int32_t dxPrev = 0;
+    int32_t dx2[5];
+
+    // running mean of |h|
+    int32_t absH[kThresholdWindow];
+    int64_t absHSum = 0;
+
+    // peak search state, indices are h indices
+    int32_t hPrev = 0;
+    bool candidateActive = false;
+    uint32_t candidateIndex = 0;
+    int32_t candidateValue = 0;
+    bool pendingActive = false;
+    uint32_t pendingIndex = 0;
+    int32_t pendingValue = 0;
+
+    // beat history
+    bool lastPeakValid = false;
+    uint32_t lastPeakIndex = 0;
+    uint32_t intervals[kMaxIntervals];
+    uint32_t intervalCount = 0;
+    bool lastValleyValid = false;
+    uint32_t lastValley = 0;
+    int32_t ratios[kMaxRatios];
+    uint32_t ratioCount = 0;
+
+    Spo2StreamResult current;
+
+    bool pushFiltered(uint32_t hIndex, int32_t h);
+    bool offerPeak(uint32_t hIndex, int32_t value);
+    void confirmPeak(uint32_t hIndex);
+    void addRatio(uint32_t valley0, uint32_t valley1);
+    void updateSpo2();
+};
+
+#endif
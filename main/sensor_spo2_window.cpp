@@ -0,0 +1,214 @@
+#include "sensor_spo2_window.h"
+#include "sensor_spo2_algorithm.h"
+#include "sensor_spo2_kernels.h"
+#include "sensor_profiler.h"
+
+template <uint32_t SampleRate, uint32_t WindowLength>
+void Spo2Window<SampleRate, WindowLength>::filterDerivative(int32_t *an_dx, const uint32_t *pun_ir_buffer, int32_t *pn_th1)
+{
+    // Leaves an_dx exactly as the separate passes of the original do: the flipped Hamming
+    // output for [0, W-12], the 2 pt average that no Hamming window covers for [W-11, W-7]
+    // and the plain difference at W-6. The threshold sums |an_dx| over [0, W-6].
+    //
+    // The 2 pt average of the difference is (ma[k+2] - ma[k]) / 2, so it comes straight from
+    // the moving average. Every pass works in place and writes an_dx[k] after the last read.
+    constexpr int32_t kMaCount = kBufferSize - kMa4Size;                         // ma[0..W-5]
+    constexpr int32_t kHammingCount = kBufferSize - kHammingSize - kMa4Size - 2; // h[0..W-12]
+    constexpr int32_t kDx2Count = kBufferSize - kMa4Size - 2;                    // dx2[0..W-7]
+
+    uint32_t un_ir_mean = 0;
+    for (int32_t k = 0; k < kBufferSize; k++)
+        un_ir_mean += pun_ir_buffer[k];
+    un_ir_mean = un_ir_mean / kBufferSize;
+
+    // 4 pt moving average of the DC free signal
+    spo2_kernel_ma4(an_dx, pun_ir_buffer, un_ir_mean, kMaCount);
+
+    // 2 pt average of the difference, and the difference at the end
+    for (int32_t k = 0; k < kDx2Count; k++)
+        an_dx[k] = (an_dx[k + 2] - an_dx[k]) / 2;
+    an_dx[kDx2Count] = an_dx[kDx2Count + 1] - an_dx[kDx2Count];
+
+    // flipped hamming window
+    spo2_kernel_hamming(an_dx, an_dx, kHammingCount);
+
+    *pn_th1 = spo2_kernel_abs_sum(an_dx, kBufferSize - kHammingSize) / (kBufferSize - kHammingSize);
+}
+
+template <uint32_t SampleRate, uint32_t WindowLength>
+void Spo2Window<SampleRate, WindowLength>::run(int32_t *an_dx,
+                                               const uint32_t *pun_ir_buffer, const uint32_t *pun_red_buffer,
+                                               int32_t *pn_spo2, int8_t *pch_spo2_valid,
+                                               int32_t *pn_heart_rate, int8_t *pch_hr_valid)
+{
+    // same steps as maxim_heart_rate_and_oxygen_saturation, see there for the details
+    uint32_t un_only_once;
+    int32_t k, n_i_ratio_count;
+    int32_t i, m, n_exact_ir_valley_locs_count, n_middle_idx;
+    int32_t n_th1, n_npks, n_c_min;
+    int32_t an_ir_valley_locs[15];
+    int32_t an_exact_ir_valley_locs[15];
+    int32_t an_dx_peak_locs[15];
+    int32_t n_peak_interval_sum;
+
+    int32_t n_y_ac, n_x_ac;
+    int32_t n_y_dc_max = 0, n_x_dc_max = 0;
+    int32_t n_y_dc_max_idx = 0, n_x_dc_max_idx = 0;
+    int32_t an_ratio[5], n_ratio_average = 0;
+    int32_t n_nume = 0, n_denom = 0;
+
+    SENSOR_PROFILE_MARK(n_profile_mark);
+    filterDerivative(an_dx, pun_ir_buffer, &n_th1);
+    SENSOR_PROFILE_LAP(ProfileStage::ALGO_FILTER, n_profile_mark);
+
+    // peak location is acutally index for sharpest location of raw signal since we flipped the signal
+    maxim_find_peaks(an_dx_peak_locs, &n_npks, an_dx, kBufferSize - kHammingSize, n_th1, kMinPeakDistance, 5);
+
+    n_peak_interval_sum = 0;
+    if (n_npks >= 2)
+    {
+        for (k = 1; k < n_npks; k++)
+            n_peak_interval_sum += (an_dx_peak_locs[k] - an_dx_peak_locs[k - 1]);
+        n_peak_interval_sum = n_peak_interval_sum / (n_npks - 1);
+        *pn_heart_rate = (int32_t)(kHeartRateConstant / n_peak_interval_sum); // beats per minutes
+        *pch_hr_valid = 1;
+    }
+    else
+    {
+        *pn_heart_rate = -999;
+        *pch_hr_valid = 0;
+    }
+    SENSOR_PROFILE_LAP(ProfileStage::ALGO_PEAKS, n_profile_mark);
+    SENSOR_PROFILE_SCOPE(ProfileStage::ALGO_RATIO);
+
+    for (k = 0; k < n_npks; k++)
+        an_ir_valley_locs[k] = an_dx_peak_locs[k] + kHammingSize / 2;
+
+    // find precise min of the raw ir signal near an_ir_valley_locs
+    n_exact_ir_valley_locs_count = 0;
+    for (k = 0; k < n_npks; k++)
+    {
+        un_only_once = 1;
+        m = an_ir_valley_locs[k];
+        n_c_min = 16777216; // 2^24;
+        if (m + kValleyHalfWidth < kBufferSize - kHammingSize && m - kValleyHalfWidth > 0)
+        {
+            for (i = m - kValleyHalfWidth; i < m + kValleyHalfWidth; i++)
+                if (static_cast<int32_t>(pun_ir_buffer[i]) < n_c_min)
+                {
+                    if (un_only_once > 0)
+                        un_only_once = 0;
+                    n_c_min = static_cast<int32_t>(pun_ir_buffer[i]);
+                    an_exact_ir_valley_locs[k] = i;
+                }
+            if (un_only_once == 0)
+                n_exact_ir_valley_locs_count++;
+        }
+    }
+    if (n_exact_ir_valley_locs_count < 2)
+    {
+        *pn_spo2 = -999; // do not use SPO2 since signal ratio is out of range
+        *pch_spo2_valid = 0;
+        return;
+    }
+
+    // valleys stay below W-6, every index read below has a full 4 pt average
+    n_ratio_average = 0;
+    n_i_ratio_count = 0;
+
+    for (k = 0; k < 5; k++)
+        an_ratio[k] = 0;
+    for (k = 0; k < n_exact_ir_valley_locs_count; k++)
+    {
+        if (an_exact_ir_valley_locs[k] > kBufferSize)
+        {
+            *pn_spo2 = -999; // do not use SPO2 since valley loc is out of range
+            *pch_spo2_valid = 0;
+            return;
+        }
+    }
+
+    // find max between two valley locations
+    // and use ratio betwen AC compoent of Ir & Red and DC compoent of Ir & Red for SPO2
+    for (k = 0; k < n_exact_ir_valley_locs_count - 1; k++)
+    {
+        const int32_t n_v0 = an_exact_ir_valley_locs[k];
+        const int32_t n_v1 = an_exact_ir_valley_locs[k + 1];
+        n_y_dc_max = -16777216;
+        n_x_dc_max = -16777216;
+        if (n_v1 - n_v0 > kMinValleyDistance)
+        {
+            // the filtered derivative is no longer needed, an_dx holds the averages of
+            // one channel over [v0, v1] at a time
+            const int32_t n_width = n_v1 - n_v0;
+            spo2_kernel_ma4(an_dx, pun_ir_buffer + n_v0, 0, n_width + 1);
+            n_x_dc_max_idx = n_v0 + spo2_kernel_argmax(an_dx, n_width);
+            n_x_dc_max = an_dx[n_x_dc_max_idx - n_v0];
+            const int32_t n_x_v0 = an_dx[0];
+            const int32_t n_x_v1 = an_dx[n_width];
+
+            spo2_kernel_ma4(an_dx, pun_red_buffer + n_v0, 0, n_width + 1);
+            n_y_dc_max_idx = n_v0 + spo2_kernel_argmax(an_dx, n_width);
+            n_y_dc_max = an_dx[n_y_dc_max_idx - n_v0];
+            const int32_t n_y_v0 = an_dx[0];
+            const int32_t n_y_v1 = an_dx[n_width];
+
+            n_y_ac = (n_y_v1 - n_y_v0) * (n_y_dc_max_idx - n_v0); // red
+            n_y_ac = n_y_v0 + n_y_ac / n_width;
+            n_y_ac = n_y_dc_max - n_y_ac; // subracting linear DC compoenents from raw
+            n_x_ac = (n_x_v1 - n_x_v0) * (n_x_dc_max_idx - n_v0); // ir
+            n_x_ac = n_x_v0 + n_x_ac / n_width;
+            n_x_ac = ma4(pun_ir_buffer, n_y_dc_max_idx) - n_x_ac; // subracting linear DC compoenents from raw
+            n_nume = (n_y_ac * n_x_dc_max) >> 7;                   // prepare X100 to preserve floating value
+            n_denom = (n_x_ac * n_y_dc_max) >> 7;
+            if (n_denom > 0 && n_i_ratio_count < 5 && n_nume != 0)
+            {
+                an_ratio[n_i_ratio_count] = (n_nume * 100) / n_denom; // formular is ( n_y_ac *n_x_dc_max) / ( n_x_ac *n_y_dc_max) ;
+                n_i_ratio_count++;
+            }
+        }
+    }
+
+    maxim_sort_ratios(an_ratio, n_i_ratio_count);
+    n_middle_idx = n_i_ratio_count / 2;
+
+    if (n_middle_idx > 1)
+        n_ratio_average = (an_ratio[n_middle_idx - 1] + an_ratio[n_middle_idx]) / 2; // use median
+    else
+        n_ratio_average = an_ratio[n_middle_idx];
+
+    if (n_ratio_average > 2 && n_ratio_average < 184)
+    {
+        *pn_spo2 = uch_spo2_table[n_ratio_average];
+        *pch_spo2_valid = 1;
+    }
+    else
+    {
+        *pn_spo2 = -999; // do not use SPO2 since signal ratio is out of range
+        *pch_spo2_valid = 0;
+    }
+}
+
+template class Spo2Window<50, 250>;
+template class Spo2Window<100, 250>;
+// only the kernel, a shared context can not hold this window
+template void Spo2Window<100, 500>::run(int32_t *, const uint32_t *, const uint32_t *,
+                                             int32_t *, int8_t *, int32_t *, int8_t *);
+
+// windows have to fit kSpo2MaxWindowLength and the sample ring of Max30102
+static constexpr Spo2WindowVariant kSpo2Windows[] = {
+    {50U, 250U, &Spo2Window<50, 250>::calculateShared},
+    {100U, 250U, &Spo2Window<100, 250>::calculateShared},
+};
+
+const Spo2WindowVariant *findSpo2Window(uint32_t sampleRateHz)
+{
+    for (const Spo2WindowVariant &variant : kSpo2Windows)
+    {
+        if (variant.sampleRate == sampleRateHz)
+        {
+            return &variant;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,115 @@
+#ifndef SENSOR_SPO2_WINDOW_H
+#define SENSOR_SPO2_WINDOW_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// @brief Scratch of one calculation over up to Capacity samples, owned by the caller.
+/// Calculations with different contexts can run concurrently. The smoothed red/ir series
+/// are computed on the fly from the input, only the filtered derivative is stored.
+template <uint32_t Capacity>
+struct Spo2WindowContext
+{
+    int32_t an_dx[Capacity - 4]; // filtered derivative
+};
+
+/// @brief Capacity of the context that fits every window in findSpo2Window()
+static constexpr uint32_t kSpo2MaxWindowLength = 256U;
+using Spo2SharedContext = Spo2WindowContext<kSpo2MaxWindowLength>;
+
+/// @brief maxim_heart_rate_and_oxygen_saturation specialized at compile time for one
+/// sample rate and one window length.
+///
+/// Scratch arrays, loop bounds, the heart rate constant and the peak/valley distances are
+/// derived from the template parameters; distances given in samples at 100 Hz in the original
+/// are scaled to SampleRate. The window always holds exactly WindowLength samples, so no loop
+/// reads past the data. Spo2Window<100, 500> gives the same results as the original function
+/// with 500 samples.
+///
+/// The front end works in place on the one scratch array with the kernels of
+/// sensor_spo2_kernels.h. The 4 point averages of the raw red/ir samples are only computed
+/// between the valleys where the ratio search reads them.
+template <uint32_t SampleRate, uint32_t WindowLength>
+class Spo2Window
+{
+public:
+    static constexpr uint32_t kSampleRate = SampleRate;
+    static constexpr uint32_t kWindowLength = WindowLength;
+
+    /// @brief Reentrant as long as every caller passes its own context
+    template <uint32_t Capacity>
+    static void calculate(Spo2WindowContext<Capacity> &context,
+                          const uint32_t *pun_ir_buffer, const uint32_t *pun_red_buffer,
+                          int32_t *pn_spo2, int8_t *pch_spo2_valid,
+                          int32_t *pn_heart_rate, int8_t *pch_hr_valid)
+    {
+        static_assert(Capacity >= WindowLength, "context too small for the window");
+        run(context.an_dx, pun_ir_buffer, pun_red_buffer, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid);
+    }
+
+    /// @brief calculate() with the shared context type, for findSpo2Window()
+    static void calculateShared(Spo2SharedContext &context,
+                                const uint32_t *pun_ir_buffer, const uint32_t *pun_red_buffer,
+                                int32_t *pn_spo2, int8_t *pch_spo2_valid,
+                                int32_t *pn_heart_rate, int8_t *pch_hr_valid)
+    {
+        calculate(context, pun_ir_buffer, pun_red_buffer, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid);
+    }
+
+private:
+    static constexpr int32_t kMa4Size = 4;
+    static constexpr int32_t kHammingSize = 5;
+    static constexpr int32_t kBufferSize = static_cast<int32_t>(WindowLength);
+    static constexpr int32_t kHeartRateConstant = static_cast<int32_t>(60U * SampleRate);
+
+    /// @brief Distance of n samples at 100 Hz expressed at SampleRate, at least one sample
+    static constexpr int32_t scaled(int32_t samplesAt100Hz)
+    {
+        int32_t distance = (samplesAt100Hz * static_cast<int32_t>(SampleRate) + 50) / 100;
+        return distance > 0 ? distance : 1;
+    }
+
+    static constexpr int32_t kMinPeakDistance = scaled(8);
+    static constexpr int32_t kValleyHalfWidth = scaled(5);
+    static constexpr int32_t kMinValleyDistance = scaled(10);
+
+    static_assert(kBufferSize > 2 * (kMa4Size + kHammingSize + 2), "window too short for the filter chain");
+    // the sums and products below stay within int32_t for 18-bit samples
+    static_assert(WindowLength <= 4096U, "window too long for 32-bit accumulation");
+
+    /// @brief 4 point moving average starting at k, as the in-place average of the original
+    static int32_t ma4(const uint32_t *pun_buffer, int32_t k)
+    {
+        return (static_cast<int32_t>(pun_buffer[k]) + static_cast<int32_t>(pun_buffer[k + 1]) +
+                static_cast<int32_t>(pun_buffer[k + 2]) + static_cast<int32_t>(pun_buffer[k + 3])) /
+               (int32_t)4;
+    }
+
+    static void filterDerivative(int32_t *an_dx, const uint32_t *pun_ir_buffer, int32_t *pn_th1);
+    static void run(int32_t *an_dx,
+                    const uint32_t *pun_ir_buffer, const uint32_t *pun_red_buffer,
+                    int32_t *pn_spo2, int8_t *pch_spo2_valid,
+                    int32_t *pn_heart_rate, int8_t *pch_hr_valid);
+};
+
+/// @brief One shipped specialization, selected by the effective sample rate
+struct Spo2WindowVariant
+{
+    uint32_t sampleRate;
+    uint32_t windowLength;
+    void (*calculate)(Spo2SharedContext &context, const uint32_t *pun_ir_buffer, const uint32_t *pun_red_buffer,
+                      int32_t *pn_spo2, int8_t *pch_spo2_valid,
+                      int32_t *pn_heart_rate, int8_t *pch_hr_valid);
+};
+
+/// @brief Specialization for this effective sample rate, nullptr if none is shipped
+const Spo2WindowVariant *findSpo2Window(uint32_t sampleRateHz);
+
+// the effective rates the sensor task configures (100 Hz with averaging 2, and 100 Hz)
+extern template class Spo2Window<50, 250>;
+extern template class Spo2Window<100, 250>;
+// the original configuration, for comparing against maxim_heart_rate_and_oxygen_saturation
+extern template void Spo2Window<100, 500>::run(int32_t *, const uint32_t *, const uint32_t *,
+                                                    int32_t *, int8_t *, int32_t *, int8_t *);
+
+#endif
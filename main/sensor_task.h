@@ -11,6 +11,32 @@ enum class SensorCommands
     SENDOR_STOP,
 };
 
+/// @brief How the sensor task learns that new samples are available
+enum class AcquisitionMode
+{
+    FIFO_POLLING = 0,
+    FIFO_INTERRUPT,
+};
+
+/// @brief FIFO_DATA bytes of one burst read, queued to the raw stream characteristic
+struct RawFifoChunk
+{
+    static constexpr size_t kMaxSamples = 32U;
+    static constexpr size_t kBytesPerSample = 6U;
+
+    // FIFO sample index of the first sample, see RawSampleSink
+    uint32_t firstIndex;
+    uint32_t numSamples;
+    uint8_t data[kMaxSamples * kBytesPerSample];
+};
+
+/// @brief Sensor configuration used by the next SENSOR_RUN command
+void SensorTaskSetConfig(const SensorConfigStruct &config);
+
+/// @brief True from a SENSOR_RUN until the next SENDOR_STOP, or until the task gave up a
+/// run because the part did not come out of reset. Safe to call from any task.
+bool SensorTaskIsRunning();
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -1,7 +1,11 @@
 #include <string.h>
 
+#include <atomic>
+
 #include "sensor_task.h"
 #include "sensor.h"
+#include "sensor_interrupt.h"
+#include "sensor_profiler.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -9,13 +13,60 @@
 
 extern QueueHandle_t SensorCommandsQueueHandle;
 extern QueueHandle_t SensorResultsQueueHandle;
+// optional, raw samples are only queued when it exists
+extern QueueHandle_t SensorRawQueueHandle;
+
+static constexpr auto kAcquisitionMode = AcquisitionMode::FIFO_INTERRUPT;
+static constexpr auto kResultMode = ResultMode::WINDOW;
+static constexpr auto kSensorIntPin = GPIO_NUM_19;
+static constexpr auto kPollingPeriodMs = 10U;
+// fallback poll in case the interrupt line is not wired
+static constexpr auto kFifoInterruptTimeoutMs = 250U;
+// resets tried per SENSOR_RUN before the run is given up
+static constexpr auto kMaxStartAttempts = 3U;
+
+/// @brief Queues every FIFO burst for the raw stream. A full queue drops the burst,
+/// the receiver sees the gap in the sample index.
+class RawQueueSink : public RawSampleSink
+{
+public:
+    void onFifoData(uint32_t firstIndex, const uint8_t *raw, size_t numSamples) override
+    {
+        if (SensorRawQueueHandle == nullptr)
+        {
+            return;
+        }
+        RawFifoChunk chunk;
+        chunk.firstIndex = firstIndex;
+        chunk.numSamples = static_cast<uint32_t>((numSamples < RawFifoChunk::kMaxSamples) ? numSamples
+                                                                                          : RawFifoChunk::kMaxSamples);
+        memcpy(chunk.data, raw, chunk.numSamples * RawFifoChunk::kBytesPerSample);
+        xQueueSend(SensorRawQueueHandle, &chunk, pdMS_TO_TICKS(0));
+    }
+};
 
 static I2CHelper i2cHelper;
 static Max30102 max30102(i2cHelper);
+static GpioInterruptSource fifoInterrupt(kSensorIntPin);
+static SensorConfigStruct sensorConfig;
+static RawQueueSink rawQueueSink;
+// read by the BLE link policy from the main task
+static std::atomic<bool> sensorRunning{false};
+
+void SensorTaskSetConfig(const SensorConfigStruct &config)
+{
+    sensorConfig = config;
+}
+
+bool SensorTaskIsRunning()
+{
+    return sensorRunning.load(std::memory_order_relaxed);
+}
 
 extern "C" void SensorTask(void *parameters)
 {
     bool isEnabled = false;
+    unsigned startAttempts = 0;
 
     for (;;)
     {
@@ -25,14 +76,30 @@ extern "C" void SensorTask(void *parameters)
             if (command == SensorCommands::SENSOR_RUN && !isEnabled)
             {
                 max30102.init();
+                max30102.setConfig(sensorConfig);
+                max30102.setResultMode(kResultMode);
+                max30102.setRawSink(&rawQueueSink);
+                // returns right away, readData() finishes the start once the part is out of reset
                 max30102.start();
+                startAttempts = 1;
+                if (kAcquisitionMode == AcquisitionMode::FIFO_INTERRUPT && max30102.isInitDone())
+                {
+                    max30102.enableFifoInterrupt(true);
+                    fifoInterrupt.enable(xTaskGetCurrentTaskHandle());
+                }
                 isEnabled = true;
+                sensorRunning.store(true, std::memory_order_relaxed);
             }
             else if (command == SensorCommands::SENDOR_STOP && isEnabled)
             {
+                if (kAcquisitionMode == AcquisitionMode::FIFO_INTERRUPT)
+                {
+                    fifoInterrupt.disable();
+                }
                 max30102.stop();
                 max30102.deinit();
                 isEnabled = false;
+                sensorRunning.store(false, std::memory_order_relaxed);
             }
             else
             {
@@ -42,14 +109,49 @@ extern "C" void SensorTask(void *parameters)
 
         if (isEnabled && max30102.isInitDone())
         {
-            SensorResult result{0, 0};
+            SensorResult result{0, 0, SignalQualityCode::GOOD};
             size_t amount = max30102.readData((uint32_t *)&result);
             if (amount != 0)
             {
+                SENSOR_PROFILE_SCOPE(ProfileStage::QUEUE_SEND);
                 xQueueSend(SensorResultsQueueHandle, &result, pdMS_TO_TICKS(0));
             }
+
+            if (kAcquisitionMode == AcquisitionMode::FIFO_INTERRUPT)
+            {
+                fifoInterrupt.rearm();
+            }
+
+            if (max30102.startFailed() && startAttempts < kMaxStartAttempts)
+            {
+                startAttempts++;
+                ESP_LOGW("Sensor", "Start attempt %u of %u", startAttempts, kMaxStartAttempts);
+                max30102.start();
+            }
+            else if (max30102.startFailed())
+            {
+                // the part does not answer, nothing to stop on it
+                ESP_LOGE("Sensor", "Sensor did not start after %u attempts, run given up", startAttempts);
+                if (kAcquisitionMode == AcquisitionMode::FIFO_INTERRUPT)
+                {
+                    fifoInterrupt.disable();
+                }
+                max30102.deinit();
+                isEnabled = false;
+                sensorRunning.store(false, std::memory_order_relaxed);
+            }
         }
 
-        vTaskDelay(pdMS_TO_TICKS(10U));
+        // woken early by the fifo interrupt or by a new command
+        TickType_t waitTicks = pdMS_TO_TICKS(kPollingPeriodMs);
+        if (kAcquisitionMode == AcquisitionMode::FIFO_INTERRUPT)
+        {
+            waitTicks = isEnabled ? pdMS_TO_TICKS(kFifoInterruptTimeoutMs) : portMAX_DELAY;
+        }
+        if (isEnabled && max30102.isStarting())
+        {
+            waitTicks = pdMS_TO_TICKS(kPollingPeriodMs);
+        }
+        ulTaskNotifyTake(pdTRUE, waitTicks);
     }
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+#ifndef SORTING_NETWORK_H
+#define SORTING_NETWORK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// @brief Batcher's odd-even merge sort for N elements, the compare-exchange pairs are
+/// built at compile time. Every call does the same fixed sequence of compares without
+/// data dependent loops. Not stable, equal keys have to be made unique by the caller.
+template <size_t N>
+class SortingNetwork
+{
+    static_assert(N >= 1 && N <= 256, "pairs are stored as bytes");
+
+public:
+    struct Pair
+    {
+        uint8_t low;
+        uint8_t high;
+    };
+
+    /// @brief Sort so that no later element goes before an earlier one by less(a, b)
+    template <typename T, typename Less>
+    static void sort(T *pt, Less less)
+    {
+        for (size_t n = 0; n < kCount; n++)
+        {
+            // without a branch, the outcome of a compare is close to random
+            const Pair &pair = kPairs.pairs[n];
+            T low = pt[pair.low];
+            T high = pt[pair.high];
+            bool swap = less(high, low);
+            pt[pair.low] = swap ? high : low;
+            pt[pair.high] = swap ? low : high;
+        }
+    }
+
+    /// @brief sort() with the network for the first n <= N elements
+    template <typename T, typename Less>
+    static void sortFirst(T *pt, size_t n, Less less)
+    {
+        if constexpr (N > 1)
+        {
+            if (n < N)
+            {
+                SortingNetwork<N - 1>::sortFirst(pt, n, less);
+                return;
+            }
+        }
+        sort(pt, less);
+    }
+
+    static constexpr size_t size()
+    {
+        return kCount;
+    }
+
+private:
+    // visits the comparators of the network for any N, not only powers of two
+    template <typename Visit>
+    static constexpr void generate(Visit visit)
+    {
+        for (size_t p = 1; p < N; p <<= 1)
+        {
+            for (size_t k = p; k >= 1; k >>= 1)
+            {
+                for (size_t j = k % p; j + k < N; j += 2 * k)
+                {
+                    for (size_t i = 0; i < k && i + j + k < N; i++)
+                    {
+                        if ((i + j) / (2 * p) == (i + j + k) / (2 * p))
+                        {
+                            visit(i + j, i + j + k);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    static constexpr size_t count()
+    {
+        size_t n = 0;
+        generate([&n](size_t, size_t)
+                 { n++; });
+        return n;
+    }
+
+    static constexpr size_t kCount = count();
+
+    struct Pairs
+    {
+        Pair pairs[kCount > 0 ? kCount : 1];
+    };
+
+    static constexpr Pairs build()
+    {
+        Pairs result{};
+        size_t n = 0;
+        generate([&result, &n](size_t low, size_t high)
+                 { result.pairs[n++] = Pair{static_cast<uint8_t>(low), static_cast<uint8_t>(high)}; });
+        return result;
+    }
+
+    static constexpr Pairs kPairs = build();
+};
+
+#endif